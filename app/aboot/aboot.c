@@ -32,6 +32,7 @@
 
 #include <app.h>
 #include <debug.h>
+#include <err.h>
 #include <arch/arm.h>
 #include <string.h>
 #include <stdlib.h>
@@ -42,6 +43,8 @@
 #include <dev/flash.h>
 #include <dev/flash-ubi.h>
 #include <lib/ptable.h>
+#include <lib/strbuf.h>
+#include <lib/bootprof.h>
 #include <dev/keys.h>
 #include <dev/fbcon.h>
 #include <baseband.h>
@@ -52,12 +55,16 @@
 #include <crypto_hash.h>
 #include <malloc.h>
 #include <boot_stats.h>
+#include <lib/dma_memcpy.h>
 #include <sha.h>
 #include <platform/iomap.h>
 #include <platform/timer.h>
 #include <boot_device.h>
 #include <boot_verifier.h>
 #include <image_verify.h>
+#if VERIFIED_BOOT
+#include <verity.h>
+#endif
 #include <decompress.h>
 #include <platform/timer.h>
 #include <sys/types.h>
@@ -136,35 +143,35 @@ struct fastboot_cmd_desc {
 #define ADD_OF(a, b) (UINT_MAX - b > a) ? (a + b) : UINT_MAX
 
 #if USE_BOOTDEV_CMDLINE
-static const char *emmc_cmdline = " androidboot.bootdevice=";
+static const char emmc_cmdline[] = " androidboot.bootdevice=";
 #else
-static const char *emmc_cmdline = " androidboot.emmc=true";
-#endif
-static const char *usb_sn_cmdline = " androidboot.serialno=";
-static const char *androidboot_mode = " androidboot.mode=";
-static const char *alarmboot_cmdline = " androidboot.alarmboot=true";
-static const char *loglevel         = " quiet";
-static const char *battchg_pause = " androidboot.mode=charger";
-static const char *auth_kernel = " androidboot.authorized_kernel=true";
-static const char *secondary_gpt_enable = " gpt";
-static const char *mdtp_activated_flag = " mdtp";
-
-static const char *baseband_apq     = " androidboot.baseband=apq";
-static const char *baseband_msm     = " androidboot.baseband=msm";
-static const char *baseband_csfb    = " androidboot.baseband=csfb";
-static const char *baseband_svlte2a = " androidboot.baseband=svlte2a";
-static const char *baseband_mdm     = " androidboot.baseband=mdm";
-static const char *baseband_mdm2    = " androidboot.baseband=mdm2";
-static const char *baseband_sglte   = " androidboot.baseband=sglte";
-static const char *baseband_dsda    = " androidboot.baseband=dsda";
-static const char *baseband_dsda2   = " androidboot.baseband=dsda2";
-static const char *baseband_sglte2  = " androidboot.baseband=sglte2";
-static const char *warmboot_cmdline = " qpnp-power-on.warm_boot=1";
+static const char emmc_cmdline[] = " androidboot.emmc=true";
+#endif
+static const char usb_sn_cmdline[] = " androidboot.serialno=";
+static const char androidboot_mode[] = " androidboot.mode=";
+static const char alarmboot_cmdline[] = " androidboot.alarmboot=true";
+static const char loglevel[]         = " quiet";
+static const char battchg_pause[] = " androidboot.mode=charger";
+static const char auth_kernel[] = " androidboot.authorized_kernel=true";
+static const char secondary_gpt_enable[] = " gpt";
+static const char mdtp_activated_flag[] = " mdtp";
+
+static const char baseband_apq[]     = " androidboot.baseband=apq";
+static const char baseband_msm[]     = " androidboot.baseband=msm";
+static const char baseband_csfb[]    = " androidboot.baseband=csfb";
+static const char baseband_svlte2a[] = " androidboot.baseband=svlte2a";
+static const char baseband_mdm[]     = " androidboot.baseband=mdm";
+static const char baseband_mdm2[]    = " androidboot.baseband=mdm2";
+static const char baseband_sglte[]   = " androidboot.baseband=sglte";
+static const char baseband_dsda[]    = " androidboot.baseband=dsda";
+static const char baseband_dsda2[]   = " androidboot.baseband=dsda2";
+static const char baseband_sglte2[]  = " androidboot.baseband=sglte2";
+static const char warmboot_cmdline[] = " qpnp-power-on.warm_boot=1";
 
 #if VERIFIED_BOOT
 #if !VBOOT_MOTA
-static const char *verity_mode = " androidboot.veritymode=";
-static const char *verified_state= " androidboot.verifiedbootstate=";
+static const char verity_mode[] = " androidboot.veritymode=";
+static const char verified_state[]= " androidboot.verifiedbootstate=";
 //indexed based on enum values, green is 0 by default
 
 struct verified_boot_verity_mode vbvm[] =
@@ -295,20 +302,93 @@ static void ptentry_to_tag(unsigned **ptr, struct ptentry *ptn)
 	*ptr += sizeof(struct atag_ptbl_entry) / sizeof(unsigned);
 }
 
+/*
+ * Pieces of the command line that cannot change between boots of the
+ * same aboot instance. They are gathered once and replayed on every
+ * fastboot boot, so the boot device string and baseband are not looked
+ * up again each time.
+ */
+static struct {
+	bool valid;
+	strbuf_t bootdev;
+	strbuf_t serialno;
+	const char *baseband;
+	size_t baseband_len;
+} cmdline_static;
+
+static const char *target_baseband_cmdline(void)
+{
+	switch(target_baseband())
+	{
+		case BASEBAND_APQ:
+			return baseband_apq;
+		case BASEBAND_MSM:
+			return baseband_msm;
+		case BASEBAND_CSFB:
+			return baseband_csfb;
+		case BASEBAND_SVLTE2A:
+			return baseband_svlte2a;
+		case BASEBAND_MDM:
+			return baseband_mdm;
+		case BASEBAND_MDM2:
+			return baseband_mdm2;
+		case BASEBAND_SGLTE:
+			return baseband_sglte;
+		case BASEBAND_SGLTE2:
+			return baseband_sglte2;
+		case BASEBAND_DSDA:
+			return baseband_dsda;
+		case BASEBAND_DSDA2:
+			return baseband_dsda2;
+	}
+
+	return NULL;
+}
+
+static void update_cmdline_static(void)
+{
+	int ret = NO_ERROR;
+
+	if (cmdline_static.valid)
+		return;
+
+	strbuf_init(&cmdline_static.bootdev, 0);
+	strbuf_init(&cmdline_static.serialno, 0);
+
+	if (target_is_emmc_boot()) {
+		ret |= strbuf_append_lit(&cmdline_static.bootdev, emmc_cmdline);
+#if USE_BOOTDEV_CMDLINE
+		ret |= strbuf_reserve(&cmdline_static.bootdev, BOOT_DEV_MAX_LEN);
+		if (ret == NO_ERROR) {
+			char *dst = cmdline_static.bootdev.buf + cmdline_static.bootdev.len;
+
+			platform_boot_dev_cmdline(dst);
+			cmdline_static.bootdev.len += strlen(dst);
+		}
+#endif
+	}
+
+	ret |= strbuf_append_lit(&cmdline_static.serialno, usb_sn_cmdline);
+	ret |= strbuf_append(&cmdline_static.serialno, sn_buf);
+	ASSERT(ret == NO_ERROR);
+
+	cmdline_static.baseband = target_baseband_cmdline();
+	if (cmdline_static.baseband)
+		cmdline_static.baseband_len = strlen(cmdline_static.baseband);
+
+	cmdline_static.valid = true;
+}
+
 char *update_cmdline(const char * cmdline)
 {
-	int cmdline_len = 0;
-	int have_cmdline = 0;
-	char *cmdline_final = NULL;
-	int pause_at_bootup = 0;
-	bool warm_boot = false;
+	strbuf_t sb;
+	size_t cmdline_len = 0;
+	int ret = NO_ERROR;
 	bool gpt_exists = partition_gpt_exists();
-	int have_target_boot_params = 0;
-	char *boot_dev_buf = NULL;
-    bool is_mdtp_activated = 0;
+	bool is_mdtp_activated = 0;
 #if VERIFIED_BOOT
 #if !VBOOT_MOTA
-    uint32_t boot_state = boot_verify_get_state();
+	uint32_t boot_state = boot_verify_get_state();
 #endif
 #endif
 
@@ -316,300 +396,90 @@ char *update_cmdline(const char * cmdline)
 	mdtp_activated(&is_mdtp_activated);
 #endif /* MDTP_SUPPORT */
 
-	if (cmdline && cmdline[0]) {
+	update_cmdline_static();
+
+	if (cmdline && cmdline[0])
 		cmdline_len = strlen(cmdline);
-		have_cmdline = 1;
-	}
-	if (target_is_emmc_boot()) {
-		cmdline_len += strlen(emmc_cmdline);
-#if USE_BOOTDEV_CMDLINE
-		boot_dev_buf = (char *) malloc(sizeof(char) * BOOT_DEV_MAX_LEN);
-		ASSERT(boot_dev_buf);
-		platform_boot_dev_cmdline(boot_dev_buf);
-		cmdline_len += strlen(boot_dev_buf);
-#endif
-	}
 
-	cmdline_len += strlen(usb_sn_cmdline);
-	cmdline_len += strlen(sn_buf);
+	/*
+	 * Size the buffer for the image cmdline, the cached pieces and a
+	 * margin for the short flags below, so it is normally allocated once.
+	 */
+	ret |= strbuf_init(&sb, cmdline_len + cmdline_static.bootdev.len +
+			   cmdline_static.serialno.len +
+			   cmdline_static.baseband_len +
+			   sizeof(target_boot_params) + MAX_PANEL_BUF_SIZE + 256);
+
+	if (cmdline_len)
+		ret |= strbuf_append_len(&sb, cmdline, cmdline_len);
+
+	ret |= strbuf_append_buf(&sb, &cmdline_static.bootdev);
 
 #if VERIFIED_BOOT
 #if !VBOOT_MOTA
-	cmdline_len += strlen(verified_state) + strlen(vbsn[boot_state].name);
-	cmdline_len += strlen(verity_mode) + strlen(vbvm[device.verity_mode].name);
+	ret |= strbuf_append_lit(&sb, verified_state);
+	ret |= strbuf_append(&sb, vbsn[boot_state].name);
+	ret |= strbuf_append_lit(&sb, verity_mode);
+	ret |= strbuf_append(&sb, vbvm[device.verity_mode].name);
 #endif
 #endif
 
+	ret |= strbuf_append_buf(&sb, &cmdline_static.serialno);
+
+	if (target_warm_boot())
+		ret |= strbuf_append_lit(&sb, warmboot_cmdline);
+
 	if (boot_into_recovery && gpt_exists)
-		cmdline_len += strlen(secondary_gpt_enable);
+		ret |= strbuf_append_lit(&sb, secondary_gpt_enable);
 
-	if(is_mdtp_activated)
-		cmdline_len += strlen(mdtp_activated_flag);
+	if (is_mdtp_activated)
+		ret |= strbuf_append_lit(&sb, mdtp_activated_flag);
 
 	if (boot_into_ffbm) {
-		cmdline_len += strlen(androidboot_mode);
-		cmdline_len += strlen(ffbm_mode_string);
+		ret |= strbuf_append_lit(&sb, androidboot_mode);
+		ret |= strbuf_append(&sb, ffbm_mode_string);
 		/* reduce kernel console messages to speed-up boot */
-		cmdline_len += strlen(loglevel);
+		ret |= strbuf_append_lit(&sb, loglevel);
 	} else if (boot_reason_alarm) {
-		cmdline_len += strlen(alarmboot_cmdline);
+		ret |= strbuf_append_lit(&sb, alarmboot_cmdline);
 	} else if (device.charger_screen_enabled &&
 			target_pause_for_battery_charge()) {
-		pause_at_bootup = 1;
-		cmdline_len += strlen(battchg_pause);
-	}
-
-	if(target_use_signed_kernel() && auth_kernel_img) {
-		cmdline_len += strlen(auth_kernel);
-	}
-
-	if (get_target_boot_params(cmdline, boot_into_recovery ? "recoveryfs" :
-								 "system",
-				   target_boot_params,
-				   sizeof(target_boot_params)) == 0) {
-		have_target_boot_params = 1;
-		cmdline_len += strlen(target_boot_params);
+		ret |= strbuf_append_lit(&sb, battchg_pause);
 	}
 
-	/* Determine correct androidboot.baseband to use */
-	switch(target_baseband())
-	{
-		case BASEBAND_APQ:
-			cmdline_len += strlen(baseband_apq);
-			break;
-
-		case BASEBAND_MSM:
-			cmdline_len += strlen(baseband_msm);
-			break;
-
-		case BASEBAND_CSFB:
-			cmdline_len += strlen(baseband_csfb);
-			break;
-
-		case BASEBAND_SVLTE2A:
-			cmdline_len += strlen(baseband_svlte2a);
-			break;
-
-		case BASEBAND_MDM:
-			cmdline_len += strlen(baseband_mdm);
-			break;
-
-		case BASEBAND_MDM2:
-			cmdline_len += strlen(baseband_mdm2);
-			break;
-
-		case BASEBAND_SGLTE:
-			cmdline_len += strlen(baseband_sglte);
-			break;
-
-		case BASEBAND_SGLTE2:
-			cmdline_len += strlen(baseband_sglte2);
-			break;
+	if(target_use_signed_kernel() && auth_kernel_img)
+		ret |= strbuf_append_lit(&sb, auth_kernel);
 
-		case BASEBAND_DSDA:
-			cmdline_len += strlen(baseband_dsda);
-			break;
-
-		case BASEBAND_DSDA2:
-			cmdline_len += strlen(baseband_dsda2);
-			break;
-	}
+	if (cmdline_static.baseband)
+		ret |= strbuf_append_len(&sb, cmdline_static.baseband,
+					 cmdline_static.baseband_len);
 
 	if (cmdline) {
 		if ((strstr(cmdline, DISPLAY_DEFAULT_PREFIX) == NULL) &&
 			target_display_panel_node(display_panel_buf,
 			MAX_PANEL_BUF_SIZE) &&
-			strlen(display_panel_buf)) {
-			cmdline_len += strlen(display_panel_buf);
+			display_panel_buf[0]) {
+			ret |= strbuf_append(&sb, display_panel_buf);
 		}
 	}
 
-	if (target_warm_boot()) {
-		warm_boot = true;
-		cmdline_len += strlen(warmboot_cmdline);
+	if (get_target_boot_params(cmdline, boot_into_recovery ? "recoveryfs" :
+								 "system",
+				   target_boot_params,
+				   sizeof(target_boot_params)) == 0) {
+		ret |= strbuf_append(&sb, target_boot_params);
 	}
 
-	if (cmdline_len > 0) {
-		const char *src;
-		char *dst;
-
-		cmdline_final = (char*) malloc((cmdline_len + 4) & (~3));
-		ASSERT(cmdline_final != NULL);
-		memset((void *)cmdline_final, 0, sizeof(*cmdline_final));
-		dst = cmdline_final;
+	ASSERT(ret == NO_ERROR);
 
-		/* Save start ptr for debug print */
-		if (have_cmdline) {
-			src = cmdline;
-			while ((*dst++ = *src++));
-		}
-		if (target_is_emmc_boot()) {
-			src = emmc_cmdline;
-			if (have_cmdline) --dst;
-			have_cmdline = 1;
-			while ((*dst++ = *src++));
-#if USE_BOOTDEV_CMDLINE
-			src = boot_dev_buf;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-#endif
-		}
+	if (sb.len) {
+		dprintf(INFO, "cmdline: %s\n", sb.buf);
+		return strbuf_detach(&sb, NULL);
+	}
 
-#if VERIFIED_BOOT
-#if !VBOOT_MOTA
-		src = verified_state;
-		if(have_cmdline) --dst;
-		have_cmdline = 1;
-		while ((*dst++ = *src++));
-		src = vbsn[boot_state].name;
-		if(have_cmdline) --dst;
-		while ((*dst++ = *src++));
-
-		src = verity_mode;
-		if(have_cmdline) --dst;
-		while ((*dst++ = *src++));
-		src = vbvm[device.verity_mode].name;
-		if(have_cmdline) -- dst;
-		while ((*dst++ = *src++));
-#endif
-#endif
-		src = usb_sn_cmdline;
-		if (have_cmdline) --dst;
-		have_cmdline = 1;
-		while ((*dst++ = *src++));
-		src = sn_buf;
-		if (have_cmdline) --dst;
-		have_cmdline = 1;
-		while ((*dst++ = *src++));
-		if (warm_boot) {
-			if (have_cmdline) --dst;
-			src = warmboot_cmdline;
-			while ((*dst++ = *src++));
-		}
-
-		if (boot_into_recovery && gpt_exists) {
-			src = secondary_gpt_enable;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (is_mdtp_activated) {
-			src = mdtp_activated_flag;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (boot_into_ffbm) {
-			src = androidboot_mode;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-			src = ffbm_mode_string;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-			src = loglevel;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		} else if (boot_reason_alarm) {
-			src = alarmboot_cmdline;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		} else if (pause_at_bootup) {
-			src = battchg_pause;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if(target_use_signed_kernel() && auth_kernel_img) {
-			src = auth_kernel;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		switch(target_baseband())
-		{
-			case BASEBAND_APQ:
-				src = baseband_apq;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MSM:
-				src = baseband_msm;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_CSFB:
-				src = baseband_csfb;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SVLTE2A:
-				src = baseband_svlte2a;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MDM:
-				src = baseband_mdm;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MDM2:
-				src = baseband_mdm2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SGLTE:
-				src = baseband_sglte;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SGLTE2:
-				src = baseband_sglte2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_DSDA:
-				src = baseband_dsda;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_DSDA2:
-				src = baseband_dsda2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-		}
-
-		if (strlen(display_panel_buf)) {
-			src = display_panel_buf;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (have_target_boot_params) {
-			if (have_cmdline) --dst;
-			src = target_boot_params;
-			while ((*dst++ = *src++));
-		}
-	}
-
-
-	if (boot_dev_buf)
-		free(boot_dev_buf);
-
-	if (cmdline_final)
-		dprintf(INFO, "cmdline: %s\n", cmdline_final);
-	else
-		dprintf(INFO, "cmdline is NULL\n");
-	return cmdline_final;
+	strbuf_free(&sb);
+	dprintf(INFO, "cmdline is NULL\n");
+	return NULL;
 }
 
 unsigned *atag_core(unsigned *ptr)
@@ -711,6 +581,7 @@ void boot_linux(void *kernel, unsigned *tags,
 		void *ramdisk, unsigned ramdisk_size)
 {
 	char *final_cmdline;
+	int prof;
 #if DEVICE_TREE
 	int ret = 0;
 #endif
@@ -721,13 +592,17 @@ void boot_linux(void *kernel, unsigned *tags,
 
 	ramdisk = (void *)PA((addr_t)ramdisk);
 
+	prof = bootprof_begin("cmdline");
 	final_cmdline = update_cmdline((const char*)cmdline);
+	bootprof_end(prof);
 
 #if DEVICE_TREE
 	dprintf(INFO, "Updating device tree: start\n");
 
 	/* Update the Device Tree */
+	prof = bootprof_begin("dtb fixup");
 	ret = update_device_tree((void *)tags, final_cmdline, ramdisk, ramdisk_size);
+	bootprof_end(prof);
 	if(ret)
 	{
 		dprintf(CRITICAL, "ERROR: Updating Device Tree Failed \n");
@@ -829,9 +704,46 @@ BUF_DMA_ALIGN(buf, BOOT_IMG_MAX_PAGE_SIZE); //Equal to max-supported pagesize
 BUF_DMA_ALIGN(dt_buf, BOOT_IMG_MAX_PAGE_SIZE);
 #endif
 
+#if VERIFIED_BOOT && VERITY_BOOT_CHECK
+/*
+ * Spot check system against its verity tree before a verified boot, in
+ * the scratch memory past the boot image and its signature. Only about
+ * one chunk in VERITY_BOOT_CHECK is read; dm-verity in the kernel still
+ * checks every block the system reads. Returns false if the partition
+ * is found to be bad or cannot be trusted for want of a key, not when
+ * the check could not be done.
+ */
+static bool verity_boot_check(uint32_t bootimg_addr, uint32_t bootimg_size)
+{
+	uintptr_t buf = ROUNDUP(bootimg_addr + bootimg_size + mmc_page_size(), CACHE_LINE);
+	uintptr_t end = (uintptr_t)target_get_scratch_address() + target_get_max_flash_size();
+	struct verity v;
+	int prof;
+	int ret;
+
+	prof = bootprof_begin("verity");
+	ret = verity_init_partition(&v, "system", boot_verify_get_key());
+	if (ret == VERITY_OK) {
+		if (buf > end || verity_buf_size(&v) > end - buf ||
+		    check_aboot_addr_range_overlap(buf, verity_buf_size(&v)))
+			ret = VERITY_ERR_NOMEM;
+		else
+			ret = verity_verify(&v, VERITY_BOOT_CHECK, (void *)buf, end - buf);
+	}
+	bootprof_end(prof);
+
+	dprintf(ret ? CRITICAL : INFO, "verity: system: %s\n", verity_strerror(ret));
+
+	return ret != VERITY_ERR_HASH && ret != VERITY_ERR_SIGNATURE &&
+		ret != VERITY_ERR_FORMAT && ret != VERITY_ERR_DISABLED &&
+		ret != VERITY_ERR_UNSIGNED;
+}
+#endif
+
 static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 {
 	int ret;
+	int prof;
 
 #if !VERIFIED_BOOT
 #if IMAGE_VERIF_ALGO_SHA1
@@ -846,6 +758,7 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 
 	dprintf(INFO, "Authenticating boot image (%d): start\n", bootimg_size);
 
+	prof = bootprof_begin("hash");
 #if VERIFIED_BOOT
 	if(boot_into_recovery)
 	{
@@ -857,6 +770,11 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 		ret = boot_verify_image((unsigned char *)bootimg_addr,
 				bootimg_size, "/boot");
 	}
+#if VERITY_BOOT_CHECK
+	if (ret && !boot_into_recovery &&
+	    !verity_boot_check(bootimg_addr, bootimg_size))
+		boot_verify_send_event(BOOTIMG_VERIFICATION_FAIL);
+#endif
 	boot_verify_print_state();
 #else
 	ret = image_verify((unsigned char *)bootimg_addr,
@@ -864,6 +782,7 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 					   bootimg_size,
 					   auth_algo);
 #endif
+	bootprof_end(prof);
 	dprintf(INFO, "Authenticating boot image: done return value = %d\n", ret);
 
 	if (ret)
@@ -994,6 +913,79 @@ void boot_verifier_init(void)
 	}
 }
 
+#if DEVICE_TREE
+/*
+ * Compose the device tree at fdt with the matching overlay from the
+ * "dtbo" partition, if the device has one. The scratch buffer holds the
+ * dtbo image and the composed tree; fdt is only updated on success.
+ * The dtbo is not verified, so a locked device does not read it at all.
+ */
+static void load_and_apply_dtbo(void *fdt, unsigned char *scratch, uint32_t scratch_size)
+{
+	int index;
+	unsigned long long ptn;
+	unsigned long long ptn_size;
+	uint32_t dtbo_size;
+	uint32_t dtbo_actual;
+
+	if (!device.is_unlocked)
+	{
+		dprintf(INFO, "Device is locked, ignoring unverified dtbo\n");
+		return;
+	}
+
+	index = partition_get_index("dtbo");
+	if (index == INVALID_PTN)
+		return;
+
+	ptn = partition_get_offset(index);
+	ptn_size = partition_get_size(index);
+	if (!ptn || ptn_size < page_size || scratch_size < page_size)
+		return;
+
+	if (check_aboot_addr_range_overlap((uintptr_t)scratch, scratch_size))
+	{
+		dprintf(CRITICAL, "dtbo buffer address overlaps with aboot addresses.\n");
+		return;
+	}
+
+	mmc_set_lun(partition_get_lun(index));
+
+	if (mmc_read(ptn, (uint32_t *)scratch, page_size))
+	{
+		dprintf(CRITICAL, "ERROR: Cannot read dtbo header\n");
+		return;
+	}
+
+	dtbo_size = dev_tree_dtbo_size(scratch);
+	if (!dtbo_size)
+	{
+		dprintf(INFO, "No dtbo image found\n");
+		return;
+	}
+
+	dtbo_actual = ROUND_TO_PAGE(dtbo_size, page_mask);
+	if (dtbo_actual < dtbo_size || dtbo_actual > ptn_size ||
+		dtbo_actual >= scratch_size)
+	{
+		dprintf(CRITICAL, "ERROR: Invalid dtbo image size\n");
+		return;
+	}
+
+	if (dtbo_actual > page_size &&
+		mmc_read(ptn + page_size, (uint32_t *)(scratch + page_size), dtbo_actual - page_size))
+	{
+		dprintf(CRITICAL, "ERROR: Cannot read dtbo image\n");
+		return;
+	}
+
+	if (dev_tree_apply_dtbo(fdt, scratch, dtbo_size,
+				scratch + dtbo_actual, scratch_size - dtbo_actual,
+				device.is_unlocked))
+		dprintf(CRITICAL, "ERROR: Device tree overlay not applied, using base DTB\n");
+}
+#endif
+
 int boot_linux_from_mmc(void)
 {
 	struct boot_img_hdr *hdr = (void*) buf;
@@ -1025,6 +1017,7 @@ int boot_linux_from_mmc(void)
 	uint32_t dt_hdr_size;
 #endif
 	struct kernel64_hdr *kptr = NULL;
+	int prof;
 
 	if (check_format_bit())
 		boot_into_recovery = 1;
@@ -1065,10 +1058,13 @@ int boot_linux_from_mmc(void)
 	/* Set Lun for boot & recovery partitions */
 	mmc_set_lun(partition_get_lun(index));
 
+	prof = bootprof_begin("header read");
 	if (mmc_read(ptn + offset, (uint32_t *) buf, page_size)) {
 		dprintf(CRITICAL, "ERROR: Cannot read boot image header\n");
+		bootprof_end(prof);
                 return -1;
 	}
+	bootprof_end(prof);
 
 	if (memcmp(hdr->magic, BOOT_MAGIC, BOOT_MAGIC_SIZE)) {
 		dprintf(CRITICAL, "ERROR: Invalid boot image header\n");
@@ -1133,14 +1129,17 @@ int boot_linux_from_mmc(void)
 
 	dprintf(INFO, "Loading boot image (%d): start\n", imagesize_actual);
 	bs_set_timestamp(BS_KERNEL_LOAD_START);
+	prof = bootprof_begin("image read");
 
 	/* Read image without signature */
 	if (mmc_read(ptn + offset, (void *)image_addr, imagesize_actual))
 	{
 		dprintf(CRITICAL, "ERROR: Cannot read boot image\n");
+		bootprof_end(prof);
 		return -1;
 	}
 
+	bootprof_end(prof);
 	dprintf(INFO, "Loading boot image (%d): done\n", imagesize_actual);
 	bs_set_timestamp(BS_KERNEL_LOAD_DONE);
 
@@ -1221,9 +1220,11 @@ int boot_linux_from_mmc(void)
 			return -1;
 		}
 		dprintf(INFO, "decompress image start\n");
+		prof = bootprof_begin("inflate");
 		rc = decompress((unsigned char *)(image_addr + page_size),
 				hdr->kernel_size, out_addr, out_avai_len,
 				&dtb_offset, &out_len);
+		bootprof_end(prof);
 		if (rc)
 		{
 			dprintf(INFO, "decompress image failed!!!\n");
@@ -1270,8 +1271,8 @@ int boot_linux_from_mmc(void)
 #endif
 
 	/* Move kernel, ramdisk and device tree to correct address */
-	memmove((void*) hdr->kernel_addr, kernel_start_addr, kernel_size);
-	memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+	dma_memmove((void*) hdr->kernel_addr, kernel_start_addr, kernel_size);
+	dma_memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
 
 	#if DEVICE_TREE
 	if(dt_size) {
@@ -1291,10 +1292,13 @@ int boot_linux_from_mmc(void)
 		}
 
 		/* Find index of device tree within device tree table */
+		prof = bootprof_begin("dtb match");
 		if(dev_tree_get_entry_info(table, &dt_entry) != 0){
 			dprintf(CRITICAL, "ERROR: Getting device tree address failed\n");
+			bootprof_end(prof);
 			return -1;
 		}
+		bootprof_end(prof);
 
 		/* Validate and Read device device tree in the tags_addr */
 		if (check_aboot_addr_range_overlap(hdr->tags_addr, dt_entry.size))
@@ -1303,7 +1307,7 @@ int boot_linux_from_mmc(void)
 			return -1;
 		}
 
-		memmove((void *)hdr->tags_addr, (char *)dt_table_offset + dt_entry.offset, dt_entry.size);
+		dma_memmove((void *)hdr->tags_addr, (char *)dt_table_offset + dt_entry.offset, dt_entry.size);
 	} else {
 		/* Validate the tags_addr */
 		if (check_aboot_addr_range_overlap(hdr->tags_addr, kernel_actual))
@@ -1317,14 +1321,25 @@ int boot_linux_from_mmc(void)
 		 * Else update with the atags address in the kernel header
 		 */
 		void *dtb;
+		prof = bootprof_begin("dtb match");
 		dtb = dev_tree_appended((void*)(image_addr + page_size),
 					hdr->kernel_size, dtb_offset,
 					(void *)hdr->tags_addr);
+		bootprof_end(prof);
 		if (!dtb) {
 			dprintf(CRITICAL, "ERROR: Appended Device Tree Blob not found\n");
 			return -1;
 		}
 	}
+
+	/* The kernel has been moved out, so reuse the space past the image */
+	if ((imagesize_actual + page_size) < target_get_max_flash_size()) {
+		prof = bootprof_begin("dtbo");
+		load_and_apply_dtbo((void *)hdr->tags_addr,
+				    image_addr + imagesize_actual + page_size,
+				    target_get_max_flash_size() - imagesize_actual - page_size);
+		bootprof_end(prof);
+	}
 	#endif
 
 	if (boot_into_recovery && !device.is_unlocked && !device.is_tampered)
@@ -1351,6 +1366,7 @@ int boot_linux_from_flash(void)
 	unsigned ramdisk_actual;
 	unsigned imagesize_actual;
 	unsigned second_actual = 0;
+	int prof;
 
 #if DEVICE_TREE
 	struct dt_table *table;
@@ -1478,15 +1494,18 @@ int boot_linux_from_flash(void)
 
 		dprintf(INFO, "Loading boot image (%d): start\n", imagesize_actual);
 		bs_set_timestamp(BS_KERNEL_LOAD_START);
+		prof = bootprof_begin("image read");
 
 		/* Read image without signature */
 		if (flash_read(ptn, offset, (void *)image_addr, imagesize_actual))
 		{
 			dprintf(CRITICAL, "ERROR: Cannot read boot image\n");
+				bootprof_end(prof);
 				return -1;
 		}
 
 		dprintf(INFO, "Loading boot image (%d): done\n", imagesize_actual);
+		bootprof_end(prof);
 		bs_set_timestamp(BS_KERNEL_LOAD_DONE);
 
 		offset = imagesize_actual;
@@ -1500,8 +1519,8 @@ int boot_linux_from_flash(void)
 		verify_signed_bootimg((uint32_t)image_addr, imagesize_actual);
 
 		/* Move kernel and ramdisk to correct address */
-		memmove((void*) hdr->kernel_addr, (char*) (image_addr + page_size), hdr->kernel_size);
-		memmove((void*) hdr->ramdisk_addr, (char*) (image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+		dma_memmove((void*) hdr->kernel_addr, (char*) (image_addr + page_size), hdr->kernel_size);
+		dma_memmove((void*) hdr->ramdisk_addr, (char*) (image_addr + page_size + kernel_actual), hdr->ramdisk_size);
 #if DEVICE_TREE
 		if(dt_size != 0) {
 
@@ -1525,7 +1544,7 @@ int boot_linux_from_flash(void)
 
 			best_match_dt_addr = (unsigned char *)table + dt_entry.offset;
 			dtb_size = dt_entry.size;
-			memmove((void *)hdr->tags_addr, (char *)best_match_dt_addr, dtb_size);
+			dma_memmove((void *)hdr->tags_addr, (char *)best_match_dt_addr, dtb_size);
 		}
 #endif
 
@@ -1549,24 +1568,29 @@ int boot_linux_from_flash(void)
 		dprintf(INFO, "Loading boot image (%d): start\n",
 				kernel_actual + ramdisk_actual);
 		bs_set_timestamp(BS_KERNEL_LOAD_START);
+		prof = bootprof_begin("image read");
 
 		if (UINT_MAX - offset < kernel_actual)
 		{
 			dprintf(CRITICAL, "ERROR: Integer overflow in boot image header %s\t%d\n",__func__,__LINE__);
+			bootprof_end(prof);
 			return -1;
 		}
 		if (flash_read(ptn, offset, (void *)hdr->kernel_addr, kernel_actual)) {
 			dprintf(CRITICAL, "ERROR: Cannot read kernel image\n");
+			bootprof_end(prof);
 			return -1;
 		}
 		offset += kernel_actual;
 		if (UINT_MAX - offset < ramdisk_actual)
 		{
 			dprintf(CRITICAL, "ERROR: Integer overflow in boot image header %s\t%d\n",__func__,__LINE__);
+			bootprof_end(prof);
 			return -1;
 		}
 		if (flash_read(ptn, offset, (void *)hdr->ramdisk_addr, ramdisk_actual)) {
 			dprintf(CRITICAL, "ERROR: Cannot read ramdisk image\n");
+			bootprof_end(prof);
 			return -1;
 		}
 
@@ -1574,6 +1598,7 @@ int boot_linux_from_flash(void)
 
 		dprintf(INFO, "Loading boot image (%d): done\n",
 				kernel_actual + ramdisk_actual);
+		bootprof_end(prof);
 		bs_set_timestamp(BS_KERNEL_LOAD_DONE);
 
 		if(hdr->second_size != 0) {
@@ -2128,7 +2153,7 @@ dt_size = hdr->dt_size;
 		}
 
 		/* Read device device tree in the "tags_add */
-		memmove((void*) hdr->tags_addr,
+		dma_memmove((void*) hdr->tags_addr,
 				boot_image_start + dt_image_offset +  dt_entry.offset,
 				dt_entry.size);
 	} else
@@ -2157,6 +2182,9 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 	uint32_t dtb_offset = 0;
 	unsigned char *kernel_start_addr = NULL;
 	unsigned int kernel_size = 0;
+	int prof;
+	struct hash_ctx dl_hash;
+	uint32_t dl_hashed;
 
 
 #ifdef MDTP_SUPPORT
@@ -2180,8 +2208,16 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 
 	hdr = (struct boot_img_hdr *)data;
 
+#ifdef MDTP_SUPPORT
+	/* firmware lock verification above works in the scratch buffer */
+	fastboot_download_modified();
+#endif
+
 	/* ensure commandline is terminated */
-	hdr->cmdline[BOOT_ARGS_SIZE-1] = 0;
+	if (hdr->cmdline[BOOT_ARGS_SIZE-1]) {
+		fastboot_download_modified();
+		hdr->cmdline[BOOT_ARGS_SIZE-1] = 0;
+	}
 
 	if(target_is_emmc_boot() && hdr->page_size) {
 		page_size = hdr->page_size;
@@ -2232,10 +2268,15 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 	 * device & page_size are initialized in aboot_init
 	 */
 	if (target_use_signed_kernel() && (!device.is_unlocked)) {
+		/* Most of the image was hashed while it was downloaded */
+		if (fastboot_download_hash(&dl_hash, &dl_hashed))
+			image_set_prefix_hash((unsigned char *)data, dl_hashed, &dl_hash);
+
 		/* Pass size excluding signature size, otherwise we would try to
 		 * access signature beyond its length
 		 */
 		verify_signed_bootimg((uint32_t)data, (image_actual - sig_actual));
+		image_set_prefix_hash(NULL, 0, NULL);
 	}
 
 #if VERIFIED_BOOT
@@ -2256,9 +2297,11 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 		out_addr = (unsigned char *)(out_addr + image_actual + page_size);
 		out_avai_len = target_get_max_flash_size() - image_actual - page_size;
 		dprintf(INFO, "decompress image start\n");
+		prof = bootprof_begin("inflate");
 		ret = decompress((unsigned char *)(ptr + page_size),
 				hdr->kernel_size, out_addr, out_avai_len,
 				&dtb_offset, &out_len);
+		bootprof_end(prof);
 		if (ret)
 		{
 			dprintf(INFO, "decompress image failed!!!\n");
@@ -2310,8 +2353,8 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 #endif
 
 	/* Load ramdisk & kernel */
-	memmove((void*) hdr->ramdisk_addr, ptr + page_size + kernel_actual, hdr->ramdisk_size);
-	memmove((void*) hdr->kernel_addr, (char*) (kernel_start_addr), kernel_size);
+	dma_memmove((void*) hdr->ramdisk_addr, ptr + page_size + kernel_actual, hdr->ramdisk_size);
+	dma_memmove((void*) hdr->kernel_addr, (char*) (kernel_start_addr), kernel_size);
 
 #if DEVICE_TREE
 	if (check_aboot_addr_range_overlap(hdr->tags_addr, kernel_actual))
@@ -3207,6 +3250,95 @@ void cmd_oem_devinfo(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+void cmd_oem_bootprof(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	const struct bootprof_span *span;
+	unsigned int i;
+
+	for (i = 0; i < bootprof_count(); i++) {
+		span = bootprof_get(i);
+		if (span->end)
+			snprintf(response, sizeof(response), "\t%s: start %llu us, %llu us",
+				 span->name, span->start, span->end - span->start);
+		else
+			snprintf(response, sizeof(response), "\t%s: start %llu us, open",
+				 span->name, span->start);
+		fastboot_info(response);
+	}
+	fastboot_okay("");
+}
+
+#if THREAD_STATS
+void cmd_oem_threads(const char *arg, void *data, unsigned sz)
+{
+	static struct thread_usage usage[32];
+	char response[MAX_RSP_SIZE];
+	uint n, i;
+
+	n = thread_get_usage(usage, ARRAY_SIZE(usage));
+	for (i = 0; i < n; i++) {
+		snprintf(response, sizeof(response),
+			 "\t%s: run %llu ms, wait %llu ms, max lat %llu us, %u sw, %u preempt, stack %zd/%zd",
+			 usage[i].name, usage[i].acct.run_time / 1000,
+			 usage[i].acct.wait_time / 1000, usage[i].acct.max_latency,
+			 usage[i].acct.switches, usage[i].acct.preemptions,
+			 usage[i].stack_used, usage[i].stack_size);
+		fastboot_info(response);
+	}
+	fastboot_okay("");
+}
+#endif
+
+#if VERIFIED_BOOT
+/* oem verify <partition> [sample]: check a partition against its verity tree */
+void cmd_oem_verify(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	char name[MAX_GPT_NAME_SIZE];
+	uintptr_t buf = (uintptr_t)target_get_scratch_address();
+	uint32_t size = target_get_max_flash_size();
+	uint32_t sample = 1;
+	struct verity v;
+	const char *p;
+	time_t start;
+	int ret;
+
+	while (*arg == ' ')
+		arg++;
+	for (p = arg; *p && *p != ' '; p++)
+		;
+	if (p == arg || (size_t)(p - arg) >= sizeof(name)) {
+		fastboot_fail("usage: oem verify <partition> [sample]");
+		return;
+	}
+	memcpy(name, arg, p - arg);
+	name[p - arg] = 0;
+	if (*p)
+		sample = atoi(p + 1);
+
+	start = current_time();
+	ret = verity_init_partition(&v, name, boot_verify_get_key());
+	if (ret == VERITY_OK) {
+		if (verity_buf_size(&v) > size ||
+		    check_aboot_addr_range_overlap(buf, verity_buf_size(&v)))
+			ret = VERITY_ERR_NOMEM;
+		else
+			ret = verity_verify(&v, sample, (void *)buf, size);
+	}
+
+	snprintf(response, sizeof(response), "\t%s: %s in %lu ms", name,
+		 verity_strerror(ret), current_time() - start);
+	fastboot_info(response);
+
+	/* matching an unsigned table only means something to an unlocked device */
+	if (ret && (ret != VERITY_ERR_UNSIGNED || !device.is_unlocked))
+		fastboot_fail(verity_strerror(ret));
+	else
+		fastboot_okay("");
+}
+#endif
+
 void cmd_flashing_get_unlock_ability(const char *arg, void *data, unsigned sz)
 {
 	char response[MAX_RSP_SIZE];
@@ -3489,6 +3621,13 @@ void aboot_fastboot_register_commands(void)
 						{"flashing unlock_critical", cmd_flashing_unlock_critical},
 						{"flashing get_unlock_ability", cmd_flashing_get_unlock_ability},
 						{"oem device-info", cmd_oem_devinfo},
+						{"oem bootprof", cmd_oem_bootprof},
+#if THREAD_STATS
+						{"oem threads", cmd_oem_threads},
+#endif
+#if VERIFIED_BOOT
+						{"oem verify", cmd_oem_verify},
+#endif
 						{"preflash", cmd_preflash},
 						{"oem enable-charger-screen", cmd_oem_enable_charger_screen},
 						{"oem disable-charger-screen", cmd_oem_disable_charger_screen},
@@ -3542,6 +3681,9 @@ void aboot_init(const struct app_descriptor *app)
 {
 	unsigned reboot_mode = 0;
 	bool boot_into_fastboot = false;
+#if DISPLAY_SPLASH_SCREEN
+	int prof;
+#endif
 
 	/* Setup page size information for nv storage */
 	if (target_is_emmc_boot())
@@ -3568,7 +3710,9 @@ void aboot_init(const struct app_descriptor *app)
 	if (!check_alarm_boot()) {
 #endif
 		dprintf(SPEW, "Display Init: Start\n");
+		prof = bootprof_begin("display init");
 		target_display_init(device.display_panel);
+		bootprof_end(prof);
 		dprintf(SPEW, "Display Init: Done\n");
 #if NO_ALARM_DISPLAY
 	}
@@ -3712,6 +3856,18 @@ normal_boot:
 	/* dump partition table for debug info */
 	partition_dump();
 
+#if !VERIFIED_BOOT
+	/* let cmd_boot check signed images against the hash taken while they
+	 * were downloaded, see verify_signed_bootimg()
+	 */
+	if (target_use_signed_kernel())
+#if IMAGE_VERIF_ALGO_SHA1
+		fastboot_hash_downloads(CRYPTO_AUTH_ALG_SHA1);
+#else
+		fastboot_hash_downloads(CRYPTO_AUTH_ALG_SHA256);
+#endif
+#endif
+
 	/* initialize and start fastboot */
 	fastboot_init(target_get_scratch_address(), target_get_max_flash_size());
 #if FBCON_DISPLAY_MSG
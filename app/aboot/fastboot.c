@@ -36,6 +36,7 @@
 #include <kernel/thread.h>
 #include <kernel/event.h>
 #include <dev/udc.h>
+#include <crypto_hash.h>
 #include "fastboot.h"
 
 #ifdef USB30_SUPPORT
@@ -173,6 +174,23 @@ static void *download_base;
 static unsigned download_max;
 static unsigned download_size;
 
+/*
+ * Optional hash of the data received by cmd_download, see
+ * fastboot_hash_downloads(). Each USB request is hashed while the next one
+ * is in flight, so by the time the host sees OKAY only the last request is
+ * left to do. The last DOWNLOAD_HASH_TAIL bytes are not hashed: they are
+ * where a signature appended to the image lives, and the verifier needs to
+ * stop at the end of the signed data, which is only known once the image
+ * is parsed.
+ */
+#define DOWNLOAD_HASH_TAIL	(64 * 1024)
+
+static unsigned char download_hash_alg;
+static struct hash_ctx download_hash;
+static unsigned char *download_hash_end;	/* hash up to here, NULL if idle */
+static unsigned download_hashed;
+static bool download_hash_valid;
+
 #define STATE_OFFLINE	0
 #define STATE_COMMAND	1
 #define STATE_COMPLETE	2
@@ -188,6 +206,25 @@ static void req_complete(struct udc_request *req, unsigned actual, int status)
 	event_signal(&txn_done, 0);
 }
 
+/* Feed a completed read request to the download hash, if one is running */
+static void download_hash_update(const unsigned char *buf, unsigned len)
+{
+	if (download_hash_end == NULL || buf >= download_hash_end)
+		return;
+
+	len = MIN(len, (unsigned)(download_hash_end - buf));
+
+	/* the controller wrote memory behind the cache's back */
+	arch_invalidate_cache_range((addr_t)buf, len);
+
+	if (hash_update(&download_hash, buf, len) == CRYPTO_SHA_ERR_NONE) {
+		download_hashed += len;
+	} else {
+		dprintf(CRITICAL, "fastboot: download hash failed\n");
+		download_hash_end = NULL;
+	}
+}
+
 #ifdef USB30_SUPPORT
 static int usb30_usb_read(void *_buf, unsigned len)
 {
@@ -197,6 +234,8 @@ static int usb30_usb_read(void *_buf, unsigned len)
 	int count = 0;
 	uint32_t trans_len = len;
 	const char *buf = _buf;
+	const char *prev = NULL;
+	uint32_t prev_len = 0;
 
 	ASSERT(buf);
 	ASSERT(len);
@@ -222,6 +261,10 @@ static int usb30_usb_read(void *_buf, unsigned len)
 			dprintf(CRITICAL, "usb_read() queue failed. r = %d\n", r);
 			goto oops;
 		}
+
+		/* hash the previous request while this one is on the wire */
+		download_hash_update((const unsigned char *)prev, prev_len);
+
 		event_wait(&txn_done);
 
 		if (txn_status < 0)
@@ -231,6 +274,8 @@ static int usb30_usb_read(void *_buf, unsigned len)
 			goto oops;
 		}
 
+		prev = buf;
+		prev_len = req.length;
 		count += req.length;
 		buf += req.length;
 		len -= req.length;
@@ -253,6 +298,8 @@ static int usb30_usb_read(void *_buf, unsigned len)
 		if (req.length != xfer && trans_len == MAX_RSP_SIZE) break;
 	}
 
+	download_hash_update((const unsigned char *)prev, prev_len);
+
 	/* invalidate any cached buf data (controller updates main memory) */
 	arch_invalidate_cache_range((addr_t) _buf, count);
 
@@ -318,6 +365,8 @@ static int hsusb_usb_read(void *_buf, unsigned len)
 	int r;
 	unsigned xfer;
 	unsigned char *buf = _buf;
+	unsigned char *prev = NULL;
+	unsigned prev_len = 0;
 	int count = 0;
 
 	if (fastboot_state == STATE_ERROR)
@@ -333,6 +382,10 @@ static int hsusb_usb_read(void *_buf, unsigned len)
 			dprintf(INFO, "usb_read() queue failed\n");
 			goto oops;
 		}
+
+		/* hash the previous request while this one is on the wire */
+		download_hash_update(prev, prev_len);
+
 		event_wait(&txn_done);
 
 		if (txn_status < 0) {
@@ -340,6 +393,8 @@ static int hsusb_usb_read(void *_buf, unsigned len)
 			goto oops;
 		}
 
+		prev = buf;
+		prev_len = req->length;
 		count += req->length;
 		buf += req->length;
 		len -= req->length;
@@ -347,6 +402,7 @@ static int hsusb_usb_read(void *_buf, unsigned len)
 		/* short transfer? */
 		if (req->length != xfer) break;
 	}
+	download_hash_update(prev, prev_len);
 	/*
 	 * Force reload of buffer from memory
 	 * since transaction is complete now.
@@ -568,6 +624,7 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	int r;
 
 	download_size = 0;
+	download_hash_valid = false;
 	if (len > download_max) {
 		fastboot_fail("data too large");
 		return;
@@ -581,8 +638,16 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	 */
 	arch_invalidate_cache_range((addr_t) download_base, sz);
 
+	download_hashed = 0;
+	if (download_hash_alg && len > DOWNLOAD_HASH_TAIL &&
+	    hash_init(&download_hash, download_hash_alg) == CRYPTO_SHA_ERR_NONE)
+		download_hash_end = (unsigned char *)download_base + len - DOWNLOAD_HASH_TAIL;
+
 	r = usb_if.usb_read(download_base, len);
+	download_hash_valid = (download_hash_end != NULL);
+	download_hash_end = NULL;
 	if ((r < 0) || ((unsigned) r != len)) {
+		download_hash_valid = false;
 		fastboot_state = STATE_ERROR;
 		return;
 	}
@@ -590,6 +655,39 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+void fastboot_hash_downloads(unsigned char auth_alg)
+{
+	download_hash_alg = auth_alg;
+}
+
+/*
+ * The download hash only holds while the buffer is exactly as received.
+ * Anything that writes to it calls this first; the command loop does so
+ * for every command but boot.
+ */
+void fastboot_download_modified(void)
+{
+	download_hash_valid = false;
+}
+
+/*
+ * Copy out the hash state of the last download, covering its first *len
+ * bytes. The state is not finalized: the caller continues it over the rest
+ * of the data it verifies. It can be taken once, as the caller may go on
+ * to modify the buffer. Returns false when there is nothing to copy, and
+ * callers must hash the buffer themselves.
+ */
+bool fastboot_download_hash(struct hash_ctx *ctx, uint32_t *len)
+{
+	if (!download_hash_valid || download_hashed == 0)
+		return false;
+
+	memcpy(ctx, &download_hash, sizeof(*ctx));
+	*len = download_hashed;
+	download_hash_valid = false;
+	return true;
+}
+
 static void fastboot_command_loop(void)
 {
 	struct fastboot_cmd *cmd;
@@ -632,6 +730,10 @@ again:
 			if(arg[0]==' ')
 				arg++;
 
+			/* flash, erase, oem ... may all use the download buffer */
+			if (strcmp(cmd->prefix, "boot"))
+				fastboot_download_modified();
+
 			cmd->handle(arg,
 				    (void*) download_base, download_size);
 			if (fastboot_state == STATE_COMMAND)
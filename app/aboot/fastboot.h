@@ -54,6 +54,19 @@ void fastboot_fail(const char *reason);
 void fastboot_info(const char *reason);
 void fastboot_send_string(const void* data, size_t size);
 void fastboot_send_string_human(const void* data, size_t size);
+
+struct hash_ctx;
+
+/* hash downloads with auth_alg (CRYPTO_AUTH_ALG_*) while they are received,
+ * 0 turns it off
+ */
+void fastboot_hash_downloads(unsigned char auth_alg);
+
+/* hash state covering the first *len bytes of the last download, once */
+bool fastboot_download_hash(struct hash_ctx *ctx, uint32_t *len);
+
+/* the download buffer is about to be written, drop its hash */
+void fastboot_download_modified(void);
 #ifdef WITH_LIB_BASE64
 void fastboot_send_buf(const void* data, size_t size);
 #endif
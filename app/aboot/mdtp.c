@@ -38,6 +38,7 @@
 #include <string.h>
 #include <rand.h>
 #include <stdlib.h>
+#include <arch/defines.h>
 #include "scm.h"
 #include "mdtp.h"
 
@@ -177,7 +178,9 @@ static int verify_partition_single_hash(char *name, uint64_t size, DIP_hash_tabl
 	int index = INVALID_PTN;
 	unsigned char *buf = (unsigned char *)target_get_scratch_address();
 	uint32_t block_size = mmc_get_device_blocksize();
-	uint64_t actual_partition_size = ROUNDUP(size, block_size);
+	uint32_t bytes_to_read;
+	uint64_t offset = 0;
+	struct hash_ctx ctx;
 
 	dprintf(SPEW, "mdtp: verify_partition_single_hash: %s, %llu\n", name, size);
 
@@ -193,15 +196,41 @@ static int verify_partition_single_hash(char *name, uint64_t size, DIP_hash_tabl
 		return -1;
 	}
 
-	if (mmc_read(ptn, (void *)buf, actual_partition_size))
+	if (check_aboot_addr_range_overlap((uintptr_t)buf, ROUNDUP(MDTP_FWLOCK_BLOCK_SIZE, block_size)))
 	{
-		dprintf(CRITICAL, "mdtp: verify_partition_single_hash: %s: mmc_read() fail.\n", name);
+		dprintf(CRITICAL, "mdtp: verify_partition_single_hash: %s: image buffer address overlaps with aboot addresses.\n", name);
 		return -1;
 	}
 
-	/* calculating the hash value using HW crypto */
+	/* Hash the partition as it is read, MDTP_FWLOCK_BLOCK_SIZE at a time,
+	 * rather than reading all of it into the scratch area first. */
 	target_crypto_init_params();
-	hash_find(buf, size, digest, CRYPTO_AUTH_ALG_SHA256);
+	hash_init(&ctx, CRYPTO_AUTH_ALG_SHA256);
+
+	while (offset < size)
+	{
+		bytes_to_read = MIN(size - offset, MDTP_FWLOCK_BLOCK_SIZE);
+
+		if (mmc_read(ptn + offset, (void *)buf, ROUNDUP(bytes_to_read, block_size)))
+		{
+			dprintf(CRITICAL, "mdtp: verify_partition_single_hash: %s: mmc_read() fail.\n", name);
+			return -1;
+		}
+
+		if (hash_update(&ctx, buf, bytes_to_read) != CRYPTO_SHA_ERR_NONE)
+		{
+			dprintf(CRITICAL, "mdtp: verify_partition_single_hash: %s: hash_update() fail.\n", name);
+			return -1;
+		}
+
+		offset += bytes_to_read;
+	}
+
+	if (hash_final(&ctx, digest) != CRYPTO_SHA_ERR_NONE)
+	{
+		dprintf(CRITICAL, "mdtp: verify_partition_single_hash: %s: hash_final() fail.\n", name);
+		return -1;
+	}
 
 	if (memcmp(digest, hash_table->hash, HASH_LEN))
 	{
@@ -215,6 +244,118 @@ static int verify_partition_single_hash(char *name, uint64_t size, DIP_hash_tabl
 	return 0;
 }
 
+/*
+ * Block mode verification reads one MDTP_FWLOCK_BLOCK_SIZE block at a time
+ * into two alternating slots of the scratch area: the crypto engine hashes
+ * one block while the next is read, and the engine's FIFO is topped up
+ * between the MDTP_READ_CHUNK sized reads.
+ */
+#define MDTP_HASH_SLOTS		2
+#define MDTP_READ_CHUNK		(1024 * 1024)
+
+/* scm_random() is asked for at most this many bytes at a time */
+#define MDTP_RANDOM_MAX		512
+
+struct mdtp_hash_slot {
+	unsigned char *buf;
+	uint32_t block_num;
+	struct bam_sg sg;
+	unsigned char digest[HASH_LEN];
+	bool busy;
+};
+
+/* Pick the blocks to verify, each with probability verify_num_blocks / total_num_blocks */
+static int select_partition_blocks(char *name,
+								uint32_t total_num_blocks,
+								uint32_t verify_num_blocks,
+								uint8_t *force_verify_block,
+								uint8_t *selected)
+{
+	uint32_t rand_len = ROUNDUP(total_num_blocks * sizeof(uint32_t), CACHE_LINE);
+	uint32_t *rand_int;
+	uint32_t i, len;
+	int ret = 0;
+
+	/* scm_random() maintains the cache on the buffer, keep it to whole lines */
+	rand_int = memalign(CACHE_LINE, rand_len);
+	if (rand_int == NULL)
+	{
+		dprintf(CRITICAL, "mdtp: select_partition_blocks: %s: memalign failed\n", name);
+		return -1;
+	}
+
+	for (i = 0; i < rand_len; i += len)
+	{
+		len = MIN(rand_len - i, MDTP_RANDOM_MAX);
+		if (scm_random((uint32_t *)((uint8_t *)rand_int + i), len))
+		{
+			dprintf(CRITICAL,"mdtp: scm_call for random failed\n");
+			ret = -1;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < total_num_blocks; i++)
+	{
+		selected[i] = force_verify_block[i] ||
+			(rand_int[i] % total_num_blocks) < verify_num_blocks;
+		if (!selected[i])
+			dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: skipped verification of block %d\n", name, i + 1);
+	}
+
+out:
+	free(rand_int);
+	return ret;
+}
+
+/* Wait for a slot's block to be hashed, if it is in flight, and compare it */
+static int check_hash_slot(char *name, struct mdtp_hash_slot *slot,
+								DIP_hash_table_entry_t *hash_table)
+{
+	unsigned int hash_ret;
+
+	if (!slot->busy)
+		return 0;
+
+	hash_ret = hash_find_sg_wait();
+	slot->busy = false;
+
+	if (hash_ret != CRYPTO_ERR_NONE)
+	{
+		dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: hashing block %d failed\n", name, slot->block_num);
+		return -1;
+	}
+
+	if (memcmp(slot->digest, hash_table[slot->block_num].hash, HASH_LEN))
+	{
+		dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: Failed partition hash[%d] verification\n", name, slot->block_num);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Read a block in chunks, keeping the engine fed with the previous one meanwhile */
+static int read_hash_slot(unsigned long long offset, unsigned char *buf, uint32_t len)
+{
+	uint32_t chunk;
+
+	while (len)
+	{
+		chunk = MIN(len, MDTP_READ_CHUNK);
+		if (mmc_read(offset, (void *)buf, chunk))
+			return -1;
+
+		hash_find_sg_poll();
+
+		offset += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
 /* Validate a hash table calculated per block of a given partition */
 static int verify_partition_block_hash(char *name,
 								uint64_t size,
@@ -222,15 +363,20 @@ static int verify_partition_block_hash(char *name,
 								DIP_hash_table_entry_t *hash_table,
 								uint8_t *force_verify_block)
 {
-	unsigned char digest[HASH_LEN]={0};
+	struct mdtp_hash_slot slots[MDTP_HASH_SLOTS];
+	uint8_t selected[MAX_BLOCKS];
 	unsigned long long ptn = 0;
 	int index = INVALID_PTN;
 	unsigned char *buf = (unsigned char *)target_get_scratch_address();
 	uint32_t bytes_to_read;
-	uint32_t block_num = 0;
+	uint32_t block_num;
 	uint32_t total_num_blocks = ((size - 1) / MDTP_FWLOCK_BLOCK_SIZE) + 1;
-	uint32_t rand_int;
 	uint32_t block_size = mmc_get_device_blocksize();
+	uint32_t slot_size = ROUNDUP(MDTP_FWLOCK_BLOCK_SIZE, block_size);
+	uint32_t num_slots, next_slot = 0;
+	struct mdtp_hash_slot *slot, *prev = NULL;
+	uint32_t i;
+	int ret = 0;
 
 	dprintf(SPEW, "mdtp: verify_partition_block_hash: %s, %llu\n", name, size);
 
@@ -247,63 +393,83 @@ static int verify_partition_block_hash(char *name,
 		return -1;
 	}
 
+	/* a pair of slots if they fit in the scratch area */
+	num_slots = MIN(MDTP_HASH_SLOTS, target_get_max_flash_size() / slot_size);
+	if (num_slots == 0)
+		num_slots = 1;
+
 	/* initiating parameters for hash calculation using HW crypto */
 	target_crypto_init_params();
-	if (check_aboot_addr_range_overlap((uintptr_t)buf, ROUNDUP(MDTP_FWLOCK_BLOCK_SIZE, block_size)))
+	if (check_aboot_addr_range_overlap((uintptr_t)buf, num_slots * slot_size))
 	{
 		dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: image buffer address overlaps with aboot addresses.\n", name);
 		return -1;
 	}
 
-	while (MDTP_FWLOCK_BLOCK_SIZE * block_num < size)
+	if (select_partition_blocks(name, total_num_blocks, verify_num_blocks,
+				force_verify_block, selected))
+		return -1;
+
+	for (i = 0; i < num_slots; i++)
 	{
-		if (*force_verify_block == 0)
-		{
-			if(scm_random((uint32_t *)&rand_int, sizeof(rand_int)))
-			{
-				dprintf(CRITICAL,"mdtp: scm_call for random failed\n");
-				return -1;
-			}
+		slots[i].buf = buf + i * slot_size;
+		slots[i].busy = false;
+	}
 
-			/* Skip validation of this block with probability of verify_num_blocks / total_num_blocks */
-			if ((rand_int % total_num_blocks) >= verify_num_blocks)
-			{
-				block_num++;
-				hash_table += 1;
-				force_verify_block += 1;
-				dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: skipped verification of block %d\n", name, block_num);
-				continue;
-			}
-		}
+	for (block_num = 0; block_num < total_num_blocks; block_num++)
+	{
+		if (!selected[block_num])
+			continue;
 
-		if ((size - (MDTP_FWLOCK_BLOCK_SIZE * block_num) <  MDTP_FWLOCK_BLOCK_SIZE))
-		{
-			bytes_to_read = size - (MDTP_FWLOCK_BLOCK_SIZE * block_num);
-		} else
+		bytes_to_read = MIN(size - (uint64_t)MDTP_FWLOCK_BLOCK_SIZE * block_num,
+				MDTP_FWLOCK_BLOCK_SIZE);
+
+		/* reuse the oldest slot once its block is checked */
+		slot = &slots[next_slot];
+		next_slot = (next_slot + 1) % num_slots;
+		if (check_hash_slot(name, slot, hash_table))
 		{
-			bytes_to_read = MDTP_FWLOCK_BLOCK_SIZE;
+			ret = -1;
+			break;
 		}
 
-		if (mmc_read(ptn + (MDTP_FWLOCK_BLOCK_SIZE * block_num), (void *)buf, ROUNDUP(bytes_to_read, block_size)))
+		if (read_hash_slot(ptn + ((uint64_t)MDTP_FWLOCK_BLOCK_SIZE * block_num), slot->buf, ROUNDUP(bytes_to_read, block_size)))
 		{
 			dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: mmc_read() fail.\n", name);
-			return -1;
+			ret = -1;
+			break;
 		}
 
-		/* calculating the hash value using HW */
-		hash_find(buf, bytes_to_read, digest, CRYPTO_AUTH_ALG_SHA256);
+		/* the engine takes one hash at a time, finish the one read overlapped */
+		if (prev != NULL && prev != slot && check_hash_slot(name, prev, hash_table))
+		{
+			ret = -1;
+			break;
+		}
 
-		if (memcmp(digest, hash_table->hash, HASH_LEN))
+		/* calculating the hash value using HW, while the next block is read */
+		slot->block_num = block_num;
+		slot->sg.addr = slot->buf;
+		slot->sg.len = bytes_to_read;
+		prev = slot;
+		if (hash_find_sg_start(&slot->sg, 1, slot->digest, CRYPTO_AUTH_ALG_SHA256) != CRYPTO_ERR_NONE)
 		{
-			dprintf(CRITICAL, "mdtp: verify_partition_block_hash: %s: Failed partition hash[%d] verification\n", name, block_num);
-			return -1;
+			ret = -1;
+			break;
 		}
+		slot->busy = true;
+	}
 
-		block_num++;
-		hash_table += 1;
-		force_verify_block += 1;
+	/* the engine may still be writing a digest on this stack, wait for it */
+	for (i = 0; i < num_slots; i++)
+	{
+		if (check_hash_slot(name, &slots[i], hash_table))
+			ret = -1;
 	}
 
+	if (ret)
+		return ret;
+
 	dprintf(SPEW, "verify_partition_block_hash: %s: VERIFIED!\n", name);
 
 	return 0;
@@ -333,16 +499,25 @@ static int verify_partition(char *name,
 						DIP_hash_table_entry_t *hash_table,
 						uint8_t *force_verify_block)
 {
+	time_t start = current_time();
+	int ret;
+
 	if (hash_mode == MDTP_FWLOCK_MODE_SINGLE)
 	{
-		return verify_partition_single_hash(name, size, hash_table);
+		ret = verify_partition_single_hash(name, size, hash_table);
 	} else if (hash_mode == MDTP_FWLOCK_MODE_BLOCK || hash_mode == MDTP_FWLOCK_MODE_FILES)
 	{
-		return verify_partition_block_hash(name, size, verify_num_blocks, hash_table, force_verify_block);
+		ret = verify_partition_block_hash(name, size, verify_num_blocks, hash_table, force_verify_block);
+	} else
+	{
+		/* Illegal value of hash_mode */
+		return -1;
 	}
 
-	/* Illegal value of hash_mode */
-	return -1;
+	dprintf(INFO, "mdtp: verify_partition: %s: %s in %lu ms\n", name,
+		ret ? "failed" : "verified", (unsigned long)(current_time() - start));
+
+	return ret;
 }
 
 static int validate_dip(DIP_t *dip)
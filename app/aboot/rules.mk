@@ -4,7 +4,8 @@ INCLUDES += -I$(LK_TOP_DIR)/lib/zlib_inflate
 
 DEFINES += ASSERT_ON_TAMPER=1
 
-MODULES += lib/zlib_inflate
+MODULES += lib/zlib_inflate \
+	lib/strbuf
 
 OBJS += \
 	$(LOCAL_DIR)/aboot.o \
@@ -39,6 +39,17 @@ static uint8_t *dst2;
 extern void *mymemcpy(void *dst, const void *src, size_t len);
 extern void *mymemset(void *dst, int c, size_t len);
 
+/* the scalar routines the NEON ones are measured against */
+#if ARM_WITH_NEON
+extern void *memcpy_arm(void *dst, const void *src, size_t len);
+extern void *memset_arm(void *dst, int c, size_t len);
+#define scalar_memcpy memcpy_arm
+#define scalar_memset memset_arm
+#else
+#define scalar_memcpy mymemcpy
+#define scalar_memset mymemset
+#endif
+
 static void *null_memcpy(void *dst, const void *src, size_t len)
 {
 	return dst;
@@ -167,6 +178,107 @@ static void validate_memcpy_overlap(void)
 	}
 }
 
+static int ref_memcmp(const void *a, const void *b, size_t len)
+{
+	const uint8_t *p = a, *q = b;
+
+	for (; len > 0; len--, p++, q++) {
+		if (*p != *q)
+			return *p - *q;
+	}
+	return 0;
+}
+
+static void ref_memmove(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	if (dst < src) {
+		while (len--)
+			*dst++ = *src++;
+	} else {
+		while (len--)
+			dst[len] = src[len];
+	}
+}
+
+static void validate_memmove(void)
+{
+	static const size_t bigsizes[] = { 4096, 16383, 16384 + 37, 65536 + 5 };
+	size_t srcalign, dstalign, size;
+	unsigned i;
+	const size_t maxsize = 256;
+
+	printf("testing memmove for correctness\n");
+
+	/* overlapping in both directions, by up to 64 bytes */
+	for (srcalign = 0; srcalign < 64; srcalign++) {
+		for (dstalign = 0; dstalign < 64; dstalign++) {
+			for (size = 0; size < maxsize; size++) {
+				fillbuf(src, maxsize * 2, 567);
+				fillbuf(src2, maxsize * 2, 567);
+
+				memmove(src + dstalign, src + srcalign, size);
+				ref_memmove(src2 + dstalign, src2 + srcalign, size);
+
+				if (memcmp(src, src2, maxsize * 2) != 0) {
+					printf("error! srcalign %zu, dstalign %zu, size %zu\n", srcalign, dstalign, size);
+				}
+			}
+		}
+	}
+
+	/* sizes that take the large loop and its interrupt windows */
+	for (i = 0; i < countof(bigsizes); i++) {
+		size = bigsizes[i];
+		for (dstalign = 0; dstalign < 64; dstalign += 7) {
+			fillbuf(src, size + 128, 8588485);
+			fillbuf(src2, size + 128, 8588485);
+
+			memmove(src + dstalign, src + 64, size);
+			ref_memmove(src2 + dstalign, src2 + 64, size);
+
+			if (memcmp(src, src2, size + 128) != 0) {
+				printf("error! dstalign %zu, size %zu\n", dstalign, size);
+			}
+		}
+	}
+}
+
+static void validate_memcmp(void)
+{
+	size_t srcalign, dstalign, size, pos;
+	int ret, ref;
+	const size_t maxsize = 256;
+
+	printf("testing memcmp for correctness\n");
+
+	for (srcalign = 0; srcalign < 64; srcalign++) {
+		for (dstalign = 0; dstalign < 64; dstalign++) {
+			for (size = 0; size < maxsize; size++) {
+				fillbuf(src + srcalign, size, 567);
+				fillbuf(dst + dstalign, size, 567);
+
+				ret = memcmp(src + srcalign, dst + dstalign, size);
+				if (ret != 0) {
+					printf("error! srcalign %zu, dstalign %zu, size %zu, equal buffers ret %d\n",
+						srcalign, dstalign, size, ret);
+				}
+
+				/* one differing byte, both ways round */
+				for (pos = 0; pos < size; pos += 1 + pos / 4) {
+					dst[dstalign + pos] ^= 0x80;
+					ret = memcmp(src + srcalign, dst + dstalign, size);
+					ref = ref_memcmp(src + srcalign, dst + dstalign, size);
+					if ((ret < 0) != (ref < 0) || (ret > 0) != (ref > 0)) {
+						printf("error! srcalign %zu, dstalign %zu, size %zu, pos %zu, ret %d\n",
+							srcalign, dstalign, size, pos, ret);
+					}
+					dst[dstalign + pos] ^= 0x80;
+				}
+			}
+		}
+	}
+}
+
 static time_t bench_memset_routine(void *memset_routine(void *, int, size_t), size_t dstalign)
 {
 	int i;
@@ -226,6 +338,112 @@ static void validate_memset(void)
 	}
 }
 
+/*
+ * Throughput for each of the NEON size classes, and per call latency for
+ * the short copies that dominate outside of image loading.
+ */
+static const size_t bench_sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, 65536, BUFFER_SIZE
+};
+
+#define BENCH_BYTES	(16 * 1024 * 1024)
+#define LATENCY_ITERATIONS	100000
+
+enum bench_op {
+	BENCH_MEMCPY,
+	BENCH_MEMCPY_SCALAR,
+	BENCH_MEMMOVE,
+	BENCH_MEMSET,
+	BENCH_MEMSET_SCALAR,
+	BENCH_MEMCMP,
+};
+
+static const char *bench_op_names[] = {
+	"memcpy", "scalar memcpy", "memmove", "memset", "scalar memset", "memcmp",
+};
+
+/* keeps the compiler from dropping memcmp calls whose result is unused */
+static volatile int bench_sink;
+
+static bigtime_t bench_op_run(enum bench_op op, size_t size, unsigned iterations)
+{
+	bigtime_t t0;
+	unsigned i;
+
+	t0 = current_time_hires();
+	for (i = 0; i < iterations; i++) {
+		switch (op) {
+			case BENCH_MEMCPY:
+				memcpy(dst, src + 1, size);
+				break;
+			case BENCH_MEMCPY_SCALAR:
+				scalar_memcpy(dst, src + 1, size);
+				break;
+			case BENCH_MEMMOVE:
+				/* overlapping, so it has to go backwards */
+				memmove(dst + 8, dst, size);
+				break;
+			case BENCH_MEMSET:
+				memset(dst, i, size);
+				break;
+			case BENCH_MEMSET_SCALAR:
+				scalar_memset(dst, i, size);
+				break;
+			case BENCH_MEMCMP:
+				bench_sink += memcmp(src, src2, size);
+				break;
+		}
+	}
+	return current_time_hires() - t0;
+}
+
+static void bench_sizes_run(void)
+{
+	bigtime_t us;
+	unsigned i, op, iterations;
+
+	printf("throughput by size\n");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	/* equal buffers so memcmp has to look at every byte */
+	fillbuf(src, BUFFER_SIZE, 567);
+	memcpy(src2, src, BUFFER_SIZE);
+
+	for (i = 0; i < countof(bench_sizes); i++) {
+		iterations = BENCH_BYTES / bench_sizes[i];
+
+		printf("size %zu\n", bench_sizes[i]);
+		for (op = BENCH_MEMCPY; op <= BENCH_MEMCMP; op++) {
+			us = bench_op_run(op, bench_sizes[i], iterations);
+			/* bytes per microsecond is MB/s */
+			printf("   %-14s %5llu MB/s\n", bench_op_names[op],
+				us ? (unsigned long long)BENCH_BYTES / us : 0);
+		}
+	}
+}
+
+static void bench_latency(void)
+{
+	bigtime_t us;
+	size_t size;
+	unsigned op;
+
+	printf("latency per call\n");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	fillbuf(src, 256, 567);
+	memcpy(src2, src, 256);
+
+	for (size = 0; size <= 128; size = size < 16 ? size + 4 : size * 2) {
+		printf("size %zu\n", size);
+		for (op = BENCH_MEMCPY; op <= BENCH_MEMCMP; op++) {
+			us = bench_op_run(op, size, LATENCY_ITERATIONS);
+			printf("   %-14s %5llu ns\n", bench_op_names[op],
+				us * 1000ULL / LATENCY_ITERATIONS);
+		}
+	}
+}
+
 #if defined(WITH_LIB_CONSOLE)
 #include <lib/console.h>
 
@@ -242,8 +460,8 @@ static int string_tests(int argc, cmd_args *argv)
 	if (argc < 3) {
 		printf("not enough arguments:\n");
 usage:
-		printf("%s validate <routine>\n", argv[0].str);
-		printf("%s bench <routine>\n", argv[0].str);
+		printf("%s validate <memcpy|memcpy_overlap|memmove|memset|memcmp>\n", argv[0].str);
+		printf("%s bench <memcpy|memset|sizes|latency>\n", argv[0].str);
 		goto out;
 	}
 
@@ -254,12 +472,20 @@ usage:
 			validate_memset();
 		} else if (!strcmp(argv[2].str, "memcpy_overlap")) {
 			validate_memcpy_overlap();
+		} else if (!strcmp(argv[2].str, "memmove")) {
+			validate_memmove();
+		} else if (!strcmp(argv[2].str, "memcmp")) {
+			validate_memcmp();
 		}
 	} else if (!strcmp(argv[1].str, "bench")) {
 		if (!strcmp(argv[2].str, "memcpy")) {
 			bench_memcpy();
 		} else if (!strcmp(argv[2].str, "memset")) {
 			bench_memset();
+		} else if (!strcmp(argv[2].str, "sizes")) {
+			bench_sizes_run();
+		} else if (!strcmp(argv[2].str, "latency")) {
+			bench_latency();
 		}
 	} else {
 		goto usage;
@@ -0,0 +1,233 @@
+/*
+ * BAM scatter-gather descriptor chains against a software BAM model
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <platform.h>
+#include <sha.h>
+#include <bam.h>
+#include <app/tests.h>
+
+#if CRYPTO_BAM
+
+/*
+ * The model stands in for the BAM consumer: it walks the descriptor FIFO
+ * from its own software offset, hashes what each descriptor points to and
+ * checks the flags, so bam_add_sg() can be exercised without touching any
+ * BAM registers.
+ */
+
+#define MODEL_FIFO_SIZE	16
+/* real FIFOs need not be a power of two descriptors long */
+#define MODEL_FIFO_ODD	12
+#define MODEL_PIPE	0
+#define MODEL_FLAGS	(BAM_DESC_NWD_FLAG | BAM_DESC_INT_FLAG | BAM_DESC_EOT_FLAG)
+
+struct bam_model {
+	struct bam_instance bam;
+	uint32_t ring;
+	uint16_t sw_offset;
+	SHA256_CTX sha;
+	unsigned int descs;
+	int eot_seen;
+	int errors;
+};
+
+static void bam_model_init(struct bam_model *m, struct bam_desc *fifo,
+		uint16_t fifo_size, uint16_t max_desc_len)
+{
+	memset(m, 0, sizeof(*m));
+
+	m->ring = fifo_size * BAM_DESC_SIZE;
+	m->bam.max_desc_len = max_desc_len;
+	m->bam.pipe[MODEL_PIPE].fifo.head = fifo;
+	m->bam.pipe[MODEL_PIPE].fifo.current = fifo;
+	m->bam.pipe[MODEL_PIPE].fifo.size = fifo_size;
+	m->bam.pipe[MODEL_PIPE].initialized = 1;
+
+	SHA256_Init(&m->sha);
+}
+
+static uint16_t bam_model_prod(struct bam_model *m)
+{
+	struct bam_desc_fifo *fifo = &m->bam.pipe[MODEL_PIPE].fifo;
+
+	return (fifo->current - fifo->head) * BAM_DESC_SIZE;
+}
+
+/* process up to max descriptors, as the hardware would between two polls */
+static void bam_model_consume(struct bam_model *m, unsigned int max)
+{
+	struct bam_desc_fifo *fifo = &m->bam.pipe[MODEL_PIPE].fifo;
+	struct bam_desc *desc;
+
+	while (max-- && m->sw_offset != bam_model_prod(m)) {
+		desc = fifo->head + m->sw_offset / BAM_DESC_SIZE;
+
+		if (m->eot_seen) {
+			printf("bam_sg: descriptor after EOT\n");
+			m->errors++;
+		}
+		if (desc->size == 0 || desc->size > m->bam.max_desc_len) {
+			printf("bam_sg: bad descriptor size %u\n", desc->size);
+			m->errors++;
+		}
+
+		SHA256_Update(&m->sha, (void *)VA((addr_t)desc->addr), desc->size);
+		m->descs++;
+
+		if (desc->flags == MODEL_FLAGS) {
+			m->eot_seen = 1;
+		} else if (desc->flags) {
+			printf("bam_sg: flags 0x%x on descriptor %u\n",
+				desc->flags, m->descs);
+			m->errors++;
+		}
+
+		m->sw_offset = (m->sw_offset + BAM_DESC_SIZE) % m->ring;
+	}
+}
+
+static int bam_sg_run(const char *name, struct bam_desc *fifo,
+		uint16_t fifo_size, uint16_t max_desc_len,
+		const struct bam_sg *sg, unsigned int nents)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned char ref[SHA256_DIGEST_LENGTH];
+	struct bam_model m;
+	struct bam_sg_iter iter;
+	unsigned int busy, expect = 0;
+	unsigned int i;
+	int n;
+
+	bam_model_init(&m, fifo, fifo_size, max_desc_len);
+
+	iter.sg = sg;
+	iter.nents = nents;
+	iter.ent = 0;
+	iter.offset = 0;
+
+	while (iter.ent < iter.nents) {
+		n = bam_add_sg(&m.bam, MODEL_PIPE, &iter, m.sw_offset, MODEL_FLAGS);
+		if (n < 0) {
+			printf("bam_sg: %s: bam_add_sg failed\n", name);
+			return 1;
+		}
+
+		busy = ((bam_model_prod(&m) + m.ring - m.sw_offset) % m.ring) /
+			BAM_DESC_SIZE;
+		if (busy > fifo_size - 2u) {
+			printf("bam_sg: %s: fifo overrun, %u in flight\n", name, busy);
+			m.errors++;
+		}
+
+		bam_model_consume(&m, 1 + rand() % 4);
+	}
+	bam_model_consume(&m, fifo_size);
+	SHA256_Final(md, &m.sha);
+
+	for (i = 0; i < nents; i++)
+		expect += (sg[i].len + max_desc_len - 1) / max_desc_len;
+
+	SHA256_Init(&m.sha);
+	for (i = 0; i < nents; i++)
+		SHA256_Update(&m.sha, sg[i].addr, sg[i].len);
+	SHA256_Final(ref, &m.sha);
+
+	if (!m.eot_seen) {
+		printf("bam_sg: %s: no EOT descriptor\n", name);
+		m.errors++;
+	}
+	if (m.descs != expect) {
+		printf("bam_sg: %s: %u descriptors, expected %u\n", name, m.descs, expect);
+		m.errors++;
+	}
+	if (memcmp(md, ref, sizeof(md))) {
+		printf("bam_sg: %s: data mismatch\n", name);
+		m.errors++;
+	}
+
+	printf("bam_sg: %-10s %u descriptors, %s\n", name, m.descs,
+		m.errors ? "FAILED" : "ok");
+
+	return m.errors;
+}
+
+int bam_sg_tests(void)
+{
+	uint16_t max_len = ROUNDDOWN(BAM_NDP_MAX_DESC_DATA_LEN, 64);
+	struct bam_desc *fifo;
+	unsigned char *buf;
+	struct bam_sg sg[8];
+	unsigned int i, j, n;
+	int errors = 0;
+
+	fifo = memalign(BAM_DESC_SIZE, MODEL_FIFO_SIZE * BAM_DESC_SIZE);
+	buf = malloc(1024 * 1024);
+	if (!fifo || !buf) {
+		printf("bam_sg: no memory\n");
+		free(fifo);
+		free(buf);
+		return -1;
+	}
+
+	for (i = 0; i < 1024 * 1024; i++)
+		buf[i] = (unsigned char)(i * 7 + (i >> 8));
+
+	/* one contiguous image, wrapping the FIFO a few times */
+	sg[0].addr = buf;
+	sg[0].len = 1024 * 1024;
+	errors += bam_sg_run("image", fifo, MODEL_FIFO_SIZE, max_len, sg, 1);
+	errors += bam_sg_run("odd fifo", fifo, MODEL_FIFO_ODD, max_len, sg, 1);
+
+	/* kernel, ramdisk and DTB style sections */
+	sg[0].addr = buf;
+	sg[0].len = 100000;
+	sg[1].addr = buf + 200000;
+	sg[1].len = 7;
+	sg[2].addr = buf + 300001;
+	sg[2].len = 65536 * 3 + 5;
+	sg[3].addr = buf + 600000;
+	sg[3].len = max_len;
+	errors += bam_sg_run("sections", fifo, MODEL_FIFO_SIZE, max_len, sg, 4);
+
+	/* random lists with short descriptors */
+	for (i = 0; i < 16; i++) {
+		n = 1 + rand() % countof(sg);
+		for (j = 0; j < n; j++) {
+			sg[j].len = 1 + rand() % 4096;
+			sg[j].addr = buf + rand() % (1024 * 1024 - sg[j].len);
+		}
+		errors += bam_sg_run("random", fifo, MODEL_FIFO_SIZE, 256, sg, n);
+	}
+
+	free(buf);
+	free(fifo);
+
+	printf("bam_sg: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
+
+#endif
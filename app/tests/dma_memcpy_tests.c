@@ -0,0 +1,262 @@
+/*
+ * dma_memcpy splitting, fallback and throughput against the software engine
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <platform.h>
+#include <lib/dma_memcpy.h>
+#include <app/tests.h>
+
+#define DMA_TEST_SIZE	(4 * 1024 * 1024)
+#define DMA_TEST_GUARD	64
+#define DMA_TEST_FILL	0xa5
+
+static int dma_test_fail_copy(addr_t dst, addr_t src, size_t len)
+{
+	/* leave part of a copy behind, as an engine stopping early would */
+	memset((void *)VA(dst), 0, len / 2);
+	return -1;
+}
+
+static const struct dma_memcpy_engine dma_test_fail_engine = {
+	.name = "fail",
+	.align = 8,
+	.max_len = 0,
+	.copy = dma_test_fail_copy,
+};
+
+static void dma_test_pattern(unsigned char *buf, size_t len, unsigned seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)(i * 167 + (i >> 9) + seed);
+}
+
+/* copy src + soff to dst + doff, check the result and the guard bytes */
+static int dma_test_copy(const char *what, unsigned char *dst,
+		const unsigned char *src, size_t doff, size_t soff, size_t len)
+{
+	size_t i;
+
+	memset(dst, DMA_TEST_FILL, DMA_TEST_SIZE + 2 * DMA_TEST_GUARD);
+	dma_memcpy(dst + DMA_TEST_GUARD + doff, src + soff, len);
+
+	if (memcmp(dst + DMA_TEST_GUARD + doff, src + soff, len)) {
+		printf("dma_memcpy: %s copy mismatch, dst +%u src +%u length %u\n",
+			what, doff, soff, len);
+		return 1;
+	}
+
+	for (i = 0; i < DMA_TEST_GUARD + doff; i++) {
+		if (dst[i] != DMA_TEST_FILL)
+			goto guard;
+	}
+	for (i = DMA_TEST_GUARD + doff + len;
+	     i < DMA_TEST_SIZE + 2 * DMA_TEST_GUARD; i++) {
+		if (dst[i] != DMA_TEST_FILL)
+			goto guard;
+	}
+	return 0;
+
+guard:
+	printf("dma_memcpy: %s wrote outside, dst +%u src +%u length %u\n",
+		what, doff, soff, len);
+	return 1;
+}
+
+static int dma_test_split(unsigned char *dst, const unsigned char *src)
+{
+	struct dma_memcpy_stats st;
+	size_t off, len;
+	unsigned i;
+	int errors = 0;
+
+	dma_memcpy_set_engine(&dma_memcpy_sw_engine);
+
+	/* aligned and large: all of it to the engine */
+	dma_memcpy_reset_stats();
+	errors += dma_test_copy("aligned", dst, src, 0, 0, DMA_TEST_SIZE);
+	dma_memcpy_get_stats(&st);
+	if (st.dma_copies != 1 || st.dma_bytes != DMA_TEST_SIZE) {
+		printf("dma_memcpy: aligned copy not offloaded\n");
+		errors++;
+	}
+
+	/* small: cpu */
+	dma_memcpy_reset_stats();
+	errors += dma_test_copy("small", dst, src, 0, 0, DMA_MEMCPY_MIN_LEN - 1);
+	dma_memcpy_get_stats(&st);
+	if (st.dma_copies || st.cpu_copies != 1) {
+		printf("dma_memcpy: small copy offloaded\n");
+		errors++;
+	}
+
+	/* source misaligned for the engine relative to the destination: cpu */
+	dma_memcpy_reset_stats();
+	errors += dma_test_copy("misaligned", dst, src, 0, 3, DMA_TEST_SIZE / 2);
+	dma_memcpy_get_stats(&st);
+	if (st.dma_copies) {
+		printf("dma_memcpy: misaligned copy offloaded\n");
+		errors++;
+	}
+
+	/* same misalignment on both sides: cpu ends, engine middle */
+	for (i = 0; i < 64; i++) {
+		off = rand() % CACHE_LINE;
+		len = DMA_MEMCPY_MIN_LEN + rand() % (DMA_TEST_SIZE / 2);
+
+		dma_memcpy_reset_stats();
+		errors += dma_test_copy("split", dst, src, off, off, len);
+		dma_memcpy_get_stats(&st);
+		if (st.dma_copies != 1 || st.dma_bytes + st.cpu_bytes != len ||
+		    st.cpu_bytes >= 2 * CACHE_LINE) {
+			printf("dma_memcpy: bad split, offset %u length %u\n", off, len);
+			errors++;
+		}
+	}
+
+	/* anything at all */
+	for (i = 0; i < 64; i++) {
+		errors += dma_test_copy("random", dst, src, rand() % 4096,
+			rand() % 4096, rand() % (DMA_TEST_SIZE - 4096));
+	}
+
+	return errors;
+}
+
+static int dma_test_overlap(unsigned char *buf)
+{
+	unsigned char *ref;
+	size_t len = DMA_TEST_SIZE / 2;
+	size_t shift;
+	unsigned i;
+	int errors = 0;
+
+	ref = malloc(DMA_TEST_SIZE);
+	if (!ref)
+		return 1;
+
+	dma_memcpy_set_engine(&dma_memcpy_sw_engine);
+
+	for (i = 0; i < 8; i++) {
+		shift = (i & 1) ? CACHE_LINE * (i + 1) : (size_t)(rand() % 8192);
+
+		dma_test_pattern(buf, DMA_TEST_SIZE, i);
+		memcpy(ref, buf, DMA_TEST_SIZE);
+		memmove(ref + shift, ref, len);
+		dma_memmove(buf + shift, buf, len);
+		if (memcmp(buf, ref, DMA_TEST_SIZE)) {
+			printf("dma_memmove: forward overlap by %u failed\n", shift);
+			errors++;
+		}
+
+		dma_test_pattern(buf, DMA_TEST_SIZE, i);
+		memcpy(ref, buf, DMA_TEST_SIZE);
+		memmove(ref, ref + shift, len);
+		dma_memmove(buf, buf + shift, len);
+		if (memcmp(buf, ref, DMA_TEST_SIZE)) {
+			printf("dma_memmove: backward overlap by %u failed\n", shift);
+			errors++;
+		}
+	}
+
+	free(ref);
+	return errors;
+}
+
+static int dma_test_fallback(unsigned char *dst, const unsigned char *src)
+{
+	struct dma_memcpy_stats st;
+	int errors = 0;
+
+	dma_memcpy_set_engine(&dma_test_fail_engine);
+	dma_memcpy_reset_stats();
+
+	errors += dma_test_copy("fallback", dst, src, 0, 0, DMA_TEST_SIZE);
+	dma_memcpy_get_stats(&st);
+	if (st.errors != 1 || st.cpu_bytes != DMA_TEST_SIZE) {
+		printf("dma_memcpy: engine failure not recovered\n");
+		errors++;
+	}
+
+	return errors;
+}
+
+static void dma_test_bench(const struct dma_memcpy_engine *e,
+		unsigned char *dst, const unsigned char *src)
+{
+	bigtime_t t0, cpu_us, dma_us;
+
+	t0 = current_time_hires();
+	memcpy(dst, src, DMA_TEST_SIZE);
+	cpu_us = current_time_hires() - t0;
+
+	dma_memcpy_set_engine(e);
+	t0 = current_time_hires();
+	dma_memcpy(dst, src, DMA_TEST_SIZE);
+	dma_us = current_time_hires() - t0;
+
+	/* bytes per microsecond is MB/s */
+	printf("dma_memcpy: %-4s %4llu MB/s, cpu %4llu MB/s\n", e->name,
+		dma_us ? (unsigned long long)DMA_TEST_SIZE / dma_us : 0,
+		cpu_us ? (unsigned long long)DMA_TEST_SIZE / cpu_us : 0);
+}
+
+int dma_memcpy_tests(void)
+{
+	const struct dma_memcpy_engine *saved = dma_memcpy_get_engine();
+	unsigned char *src, *dst;
+	int errors = 0;
+
+	/* cache line aligned, so the test offsets decide the split */
+	src = memalign(CACHE_LINE, DMA_TEST_SIZE);
+	dst = memalign(CACHE_LINE, DMA_TEST_SIZE + 2 * DMA_TEST_GUARD);
+	if (!src || !dst) {
+		printf("dma_memcpy: no memory\n");
+		free(src);
+		free(dst);
+		return -1;
+	}
+	dma_test_pattern(src, DMA_TEST_SIZE, 0);
+
+	printf("dma_memcpy: engine %s\n", saved ? saved->name : "none");
+
+	errors += dma_test_split(dst, src);
+	errors += dma_test_overlap(dst);
+	errors += dma_test_fallback(dst, src);
+
+	dma_test_bench(&dma_memcpy_sw_engine, dst, src);
+	if (saved && saved != &dma_memcpy_sw_engine)
+		dma_test_bench(saved, dst, src);
+
+	dma_memcpy_set_engine(saved);
+	dma_memcpy_reset_stats();
+	free(src);
+	free(dst);
+
+	printf("dma_memcpy: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
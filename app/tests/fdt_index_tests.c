@@ -0,0 +1,222 @@
+/*
+ * libfdt offset index: lookup results against the linear walk, and timing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <platform.h>
+#include <libfdt.h>
+#include <app/tests.h>
+
+#if DEVICE_TREE
+
+/*
+ * A board sized tree: FDT_TEST_BUSES buses of FDT_TEST_DEVS devices, each
+ * device with a phandle and a few properties, so a linear lookup has about
+ * as much to walk as it does in a real DTB.
+ */
+#define FDT_TEST_SIZE		(256 * 1024)
+#define FDT_TEST_BUSES		16
+#define FDT_TEST_DEVS		32
+#define FDT_TEST_LOOKUPS	2000
+#define FDT_TEST_PATH_MAX	64
+
+static int fdt_test_phandle(int bus, int dev)
+{
+	return 1 + bus * FDT_TEST_DEVS + dev;
+}
+
+static int fdt_test_build(void *buf)
+{
+	char name[FDT_TEST_PATH_MAX];
+	int bus, dev;
+	int err = 0;
+
+	err |= fdt_create(buf, FDT_TEST_SIZE);
+	err |= fdt_finish_reservemap(buf);
+	err |= fdt_begin_node(buf, "");
+	err |= fdt_property_u32(buf, "#address-cells", 1);
+	err |= fdt_property_u32(buf, "#size-cells", 1);
+
+	for (bus = 0; bus < FDT_TEST_BUSES; bus++) {
+		snprintf(name, sizeof(name), "bus@%x", 0x1000000 * bus);
+		err |= fdt_begin_node(buf, name);
+		err |= fdt_property_string(buf, "compatible", "simple-bus");
+
+		for (dev = 0; dev < FDT_TEST_DEVS; dev++) {
+			snprintf(name, sizeof(name), "dev@%x", 0x1000 * dev);
+			err |= fdt_begin_node(buf, name);
+			err |= fdt_property_string(buf, "compatible", "qcom,test-dev");
+			err |= fdt_property_u32(buf, "reg", 0x1000 * dev);
+			err |= fdt_property_string(buf, "status", "okay");
+			err |= fdt_property_u32(buf, "phandle", fdt_test_phandle(bus, dev));
+			err |= fdt_end_node(buf);
+		}
+
+		err |= fdt_end_node(buf);
+	}
+
+	err |= fdt_end_node(buf);
+	err |= fdt_finish(buf);
+
+	if (err)
+		return err;
+
+	/* room for the property edits below */
+	return fdt_open_into(buf, buf, FDT_TEST_SIZE);
+}
+
+static void fdt_test_path(char *path, int bus, int dev)
+{
+	snprintf(path, FDT_TEST_PATH_MAX, "/bus@%x/dev@%x", 0x1000000 * bus,
+		0x1000 * dev);
+}
+
+/* every node must be found at the offset the structure walk reports */
+static int fdt_test_check(const char *what, const void *fdt)
+{
+	char path[FDT_TEST_PATH_MAX];
+	uint32_t phandle;
+	int node, depth = 0;
+	int errors = 0;
+
+	for (node = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(fdt, node, &depth)) {
+		if (fdt_get_path(fdt, node, path, sizeof(path))) {
+			errors++;
+			continue;
+		}
+
+		if (fdt_path_offset(fdt, path) != node) {
+			printf("fdt_index: %s: %s not at %d\n", what, path, node);
+			errors++;
+		}
+
+		phandle = fdt_get_phandle(fdt, node);
+		if (phandle && fdt_node_offset_by_phandle(fdt, phandle) != node) {
+			printf("fdt_index: %s: phandle %u not at %d\n", what,
+				phandle, node);
+			errors++;
+		}
+	}
+
+	printf("fdt_index: %-24s %s\n", what, errors ? "FAILED" : "ok");
+
+	return errors;
+}
+
+/* the same pseudo random lookups, with or without an index */
+static bigtime_t fdt_test_lookups(const void *fdt, int *sum)
+{
+	char path[FDT_TEST_PATH_MAX];
+	bigtime_t t0 = current_time_hires();
+	uint32_t x = 1;
+	int bus, dev, i;
+
+	*sum = 0;
+	for (i = 0; i < FDT_TEST_LOOKUPS; i++) {
+		x = x * 1103515245 + 12345;
+		bus = (x >> 16) % FDT_TEST_BUSES;
+		dev = (x >> 24) % FDT_TEST_DEVS;
+
+		fdt_test_path(path, bus, dev);
+		*sum += fdt_path_offset(fdt, path);
+		*sum += fdt_node_offset_by_phandle(fdt, fdt_test_phandle(bus, dev));
+	}
+
+	return current_time_hires() - t0;
+}
+
+int fdt_index_tests(void)
+{
+	bigtime_t linear_us, indexed_us;
+	int linear_sum, indexed_sum;
+	char path[FDT_TEST_PATH_MAX];
+	void *fdt;
+	int node, ret;
+	int errors = 0;
+
+	fdt = malloc(FDT_TEST_SIZE);
+	if (!fdt) {
+		printf("fdt_index: no memory\n");
+		return -1;
+	}
+
+	ret = fdt_test_build(fdt);
+	if (ret) {
+		printf("fdt_index: cannot build test tree: %s\n", fdt_strerror(ret));
+		free(fdt);
+		return -1;
+	}
+
+	errors += fdt_test_check("linear", fdt);
+
+	ret = fdt_index_build(fdt);
+	if (ret) {
+		printf("fdt_index: cannot build index: %s\n", fdt_strerror(ret));
+		free(fdt);
+		return -1;
+	}
+	errors += fdt_test_check("indexed", fdt);
+
+	/* a longer property moves every node after it, the index follows */
+	fdt_test_path(path, 0, 0);
+	node = fdt_path_offset(fdt, path);
+	ret = fdt_setprop_string(fdt, node, "status", "disabled-for-this-test");
+	if (ret) {
+		printf("fdt_index: setprop failed: %s\n", fdt_strerror(ret));
+		errors++;
+	}
+	errors += fdt_test_check("indexed, prop grown", fdt);
+
+	/* a new node invalidates it, lookups fall back to the walk */
+	fdt_test_path(path, 1, 1);
+	node = fdt_path_offset(fdt, path);
+	if (fdt_add_subnode(fdt, node, "child") < 0)
+		errors++;
+	errors += fdt_test_check("index invalidated", fdt);
+
+	fdt_index_release(fdt);
+	linear_us = fdt_test_lookups(fdt, &linear_sum);
+
+	fdt_index_build(fdt);
+	indexed_us = fdt_test_lookups(fdt, &indexed_sum);
+	fdt_index_release(fdt);
+
+	if (linear_sum != indexed_sum) {
+		printf("fdt_index: lookup results differ with the index\n");
+		errors++;
+	}
+
+	/* root, buses, devices and the added child */
+	printf("fdt_index: %d path + phandle lookups in %d nodes: "
+		"linear %llu us, indexed %llu us\n", FDT_TEST_LOOKUPS,
+		2 + FDT_TEST_BUSES * (FDT_TEST_DEVS + 1), linear_us, indexed_us);
+
+	free(fdt);
+
+	printf("fdt_index: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
+
+#endif
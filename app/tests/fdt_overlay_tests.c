@@ -0,0 +1,381 @@
+/*
+ * libfdt overlays: fixups, local fixups, phandle renumbering and symbols
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <libfdt.h>
+#include <board.h>
+#include <dev_tree.h>
+#include <app/tests.h>
+
+#if DEVICE_TREE
+
+/*
+ * The trees are built with the sequential-write API, as dtc would emit
+ * them for these sources:
+ *
+ * base:
+ *	/ {
+ *		soc {
+ *			uart: uart@1000 { phandle = <1>; status = "disabled"; };
+ *			gpio: gpio@2000 { phandle = <2>; };
+ *		};
+ *		__symbols__ { uart = "/soc/uart@1000"; gpio = "/soc/gpio@2000"; };
+ *	};
+ *
+ * overlay, compiled with -@:
+ *	&uart {
+ *		status = "okay";
+ *		gpios = <&gpio 3 0>;
+ *		dmas = <&chan 7>;
+ *		chan: child { };
+ *	};
+ *	&{/soc} {
+ *		new@3000 { link = <&chan>; };
+ *	};
+ *
+ * The overlay's own phandles, 1 for chan and 2 for new@3000, must move
+ * past the base's, to 3 and 4, with the references to them following;
+ * the references to uart and gpio must resolve through the base's
+ * __symbols__.
+ */
+#define FDT_OVL_BASE_SIZE	(16 * 1024)
+#define FDT_OVL_SIZE		(4 * 1024)
+#define FDT_OVL_UNRESOLVED	0xffffffff
+#define FDT_OVL_DTBO_SIZE	(sizeof(struct dtbo_table_header) + \
+				 sizeof(struct dtbo_table_entry) + FDT_OVL_SIZE)
+#define FDT_OVL_WORK_SIZE	(2 * FDT_OVL_BASE_SIZE)
+
+static int fdt_ovl_cells(void *fdt, const char *name, const uint32_t *cells,
+		int n)
+{
+	uint32_t val[4];
+	int i;
+
+	for (i = 0; i < n; i++)
+		val[i] = cpu_to_fdt32(cells[i]);
+
+	return fdt_property(fdt, name, val, n * sizeof(val[0]));
+}
+
+static int fdt_ovl_build_base(void *buf)
+{
+	int err = 0;
+
+	err |= fdt_create(buf, FDT_OVL_BASE_SIZE);
+	err |= fdt_finish_reservemap(buf);
+	err |= fdt_begin_node(buf, "");
+
+	err |= fdt_begin_node(buf, "soc");
+	err |= fdt_begin_node(buf, "uart@1000");
+	err |= fdt_property_u32(buf, "phandle", 1);
+	err |= fdt_property_string(buf, "status", "disabled");
+	err |= fdt_end_node(buf);
+	err |= fdt_begin_node(buf, "gpio@2000");
+	err |= fdt_property_u32(buf, "phandle", 2);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "__symbols__");
+	err |= fdt_property_string(buf, "uart", "/soc/uart@1000");
+	err |= fdt_property_string(buf, "gpio", "/soc/gpio@2000");
+	err |= fdt_end_node(buf);
+
+	err |= fdt_end_node(buf);
+	err |= fdt_finish(buf);
+
+	if (err)
+		return err;
+
+	/* room for the merged nodes */
+	return fdt_open_into(buf, buf, FDT_OVL_BASE_SIZE);
+}
+
+/* gpio_label is the label the gpios reference is fixed up against */
+static int fdt_ovl_build_overlay(void *buf, const char *gpio_label)
+{
+	const uint32_t gpios[] = { FDT_OVL_UNRESOLVED, 3, 0 };
+	const uint32_t dmas[] = { 1, 7 };
+	const uint32_t zero[] = { 0 };
+	int err = 0;
+
+	err |= fdt_create(buf, FDT_OVL_SIZE);
+	err |= fdt_finish_reservemap(buf);
+	err |= fdt_begin_node(buf, "");
+
+	err |= fdt_begin_node(buf, "fragment@0");
+	err |= fdt_property_u32(buf, "target", FDT_OVL_UNRESOLVED);
+	err |= fdt_begin_node(buf, "__overlay__");
+	err |= fdt_property_string(buf, "status", "okay");
+	err |= fdt_ovl_cells(buf, "gpios", gpios, countof(gpios));
+	err |= fdt_ovl_cells(buf, "dmas", dmas, countof(dmas));
+	err |= fdt_begin_node(buf, "child");
+	err |= fdt_property_u32(buf, "phandle", 1);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "fragment@1");
+	err |= fdt_property_string(buf, "target-path", "/soc");
+	err |= fdt_begin_node(buf, "__overlay__");
+	err |= fdt_begin_node(buf, "new@3000");
+	err |= fdt_property_u32(buf, "link", 1);
+	err |= fdt_property_u32(buf, "phandle", 2);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "__fixups__");
+	err |= fdt_property_string(buf, "uart", "/fragment@0:target:0");
+	err |= fdt_property_string(buf, gpio_label, "/fragment@0/__overlay__:gpios:0");
+	err |= fdt_end_node(buf);
+
+	/* offsets, in bytes, of the cells holding the overlay's own phandles */
+	err |= fdt_begin_node(buf, "__local_fixups__");
+	err |= fdt_begin_node(buf, "fragment@0");
+	err |= fdt_begin_node(buf, "__overlay__");
+	err |= fdt_ovl_cells(buf, "dmas", zero, 1);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+	err |= fdt_begin_node(buf, "fragment@1");
+	err |= fdt_begin_node(buf, "__overlay__");
+	err |= fdt_begin_node(buf, "new@3000");
+	err |= fdt_ovl_cells(buf, "link", zero, 1);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_end_node(buf);
+	err |= fdt_finish(buf);
+
+	return err;
+}
+
+/* wrap the overlay in a dtbo image with one entry matching this board */
+static uint32_t fdt_ovl_build_dtbo(void *buf, const void *overlay)
+{
+	struct dtbo_table_header *hdr = buf;
+	struct dtbo_table_entry *entry = (void *)(hdr + 1);
+	uint32_t dt_offset = sizeof(*hdr) + sizeof(*entry);
+	uint32_t total = dt_offset + fdt_totalsize(overlay);
+
+	memset(buf, 0, dt_offset);
+	hdr->magic = cpu_to_fdt32(DTBO_TABLE_MAGIC);
+	hdr->total_size = cpu_to_fdt32(total);
+	hdr->header_size = cpu_to_fdt32(sizeof(*hdr));
+	hdr->dt_entry_size = cpu_to_fdt32(sizeof(*entry));
+	hdr->dt_entry_count = cpu_to_fdt32(1);
+	hdr->dt_entries_offset = cpu_to_fdt32(sizeof(*hdr));
+
+	entry->dt_size = cpu_to_fdt32(fdt_totalsize(overlay));
+	entry->dt_offset = cpu_to_fdt32(dt_offset);
+	entry->id = cpu_to_fdt32(board_hardware_id());
+
+	memcpy((char *)buf + dt_offset, overlay, fdt_totalsize(overlay));
+
+	return total;
+}
+
+/* compare a property of the node at path with the expected cells */
+static int fdt_ovl_expect(const void *fdt, const char *path, const char *name,
+		const uint32_t *cells, int n)
+{
+	const uint32_t *val;
+	int node, len, i;
+
+	node = fdt_path_offset(fdt, path);
+	if (node < 0) {
+		printf("fdt_overlay: %s missing\n", path);
+		return 1;
+	}
+
+	val = fdt_getprop(fdt, node, name, &len);
+	if (!val || len != n * (int)sizeof(*val)) {
+		printf("fdt_overlay: %s:%s missing or wrong size\n", path, name);
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (fdt32_to_cpu(val[i]) != cells[i]) {
+			printf("fdt_overlay: %s:%s cell %d is 0x%x, expected 0x%x\n",
+				path, name, i, fdt32_to_cpu(val[i]), cells[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int fdt_ovl_check(const void *fdt)
+{
+	const uint32_t gpios[] = { 2, 3, 0 };
+	const uint32_t dmas[] = { 3, 7 };
+	const uint32_t chan[] = { 3 };
+	const uint32_t new[] = { 4 };
+	const char *status;
+	int node, child;
+	int errors = 0;
+
+	/* fixups: target and gpios resolved through __symbols__ */
+	node = fdt_path_offset(fdt, "/soc/uart@1000");
+	status = node < 0 ? NULL : fdt_getprop(fdt, node, "status", NULL);
+	if (!status || strcmp(status, "okay")) {
+		printf("fdt_overlay: fragment@0 not merged into &uart\n");
+		errors++;
+	}
+	errors += fdt_ovl_expect(fdt, "/soc/uart@1000", "gpios", gpios, countof(gpios));
+
+	/* phandle renumbering past the base, and local fixups following it */
+	errors += fdt_ovl_expect(fdt, "/soc/uart@1000/child", "phandle", chan, 1);
+	errors += fdt_ovl_expect(fdt, "/soc/uart@1000", "dmas", dmas, countof(dmas));
+	errors += fdt_ovl_expect(fdt, "/soc/new@3000", "phandle", new, 1);
+	errors += fdt_ovl_expect(fdt, "/soc/new@3000", "link", chan, 1);
+
+	child = fdt_path_offset(fdt, "/soc/uart@1000/child");
+	if (child < 0 || fdt_node_offset_by_phandle(fdt, 3) != child) {
+		printf("fdt_overlay: phandle 3 does not lead to the overlay node\n");
+		errors++;
+	}
+	if (fdt_get_max_phandle(fdt) != 4) {
+		printf("fdt_overlay: max phandle %u, expected 4\n",
+			fdt_get_max_phandle(fdt));
+		errors++;
+	}
+
+	/* the base's own phandles and symbols are left alone */
+	node = fdt_path_offset(fdt, "/soc/gpio@2000");
+	if (node < 0 || fdt_get_phandle(fdt, node) != 2) {
+		printf("fdt_overlay: base phandle of &gpio changed\n");
+		errors++;
+	}
+	node = fdt_path_offset(fdt, "/__symbols__");
+	status = node < 0 ? NULL : fdt_getprop(fdt, node, "uart", NULL);
+	if (!status || strcmp(status, "/soc/uart@1000")) {
+		printf("fdt_overlay: __symbols__ changed\n");
+		errors++;
+	}
+
+	return errors;
+}
+
+int fdt_overlay_tests(void)
+{
+	void *fdt, *fdto;
+	void *dtbo = NULL, *work = NULL, *copy = NULL;
+	uint32_t dtbo_size;
+	int ret, before;
+	int errors = 0;
+
+	fdt = malloc(FDT_OVL_BASE_SIZE);
+	fdto = malloc(FDT_OVL_SIZE);
+	if (!fdt || !fdto) {
+		printf("fdt_overlay: no memory\n");
+		free(fdt);
+		free(fdto);
+		return -1;
+	}
+
+	if (fdt_ovl_build_base(fdt) || fdt_ovl_build_overlay(fdto, "gpio")) {
+		printf("fdt_overlay: cannot build test trees\n");
+		errors++;
+		goto out;
+	}
+
+	ret = fdt_overlay_apply(fdt, fdto);
+	if (ret) {
+		printf("fdt_overlay: apply failed: %s\n", fdt_strerror(ret));
+		errors++;
+	} else {
+		errors += fdt_ovl_check(fdt);
+	}
+	printf("fdt_overlay: %-20s %s\n", "apply", errors ? "FAILED" : "ok");
+
+	/* a label the base has no symbol for fails, and poisons the base */
+	before = errors;
+	if (fdt_ovl_build_base(fdt) || fdt_ovl_build_overlay(fdto, "nolabel")) {
+		printf("fdt_overlay: cannot build test trees\n");
+		errors++;
+		goto out;
+	}
+
+	ret = fdt_overlay_apply(fdt, fdto);
+	if (ret != -FDT_ERR_NOTFOUND || fdt_check_header(fdt) == 0) {
+		printf("fdt_overlay: unresolved label returned %d, base %s\n", ret,
+			fdt_check_header(fdt) ? "invalidated" : "still valid");
+		errors++;
+	}
+	printf("fdt_overlay: %-20s %s\n", "unresolved label",
+		errors > before ? "FAILED" : "ok");
+
+	/*
+	 * The dtbo partition is unsigned: a locked device must boot the base
+	 * tree as is. Unlocked, the same image is merged, or refused because
+	 * these heap buffers sit inside aboot's own range; either way it is
+	 * not ignored.
+	 */
+	before = errors;
+	dtbo = malloc(FDT_OVL_DTBO_SIZE);
+	work = malloc(FDT_OVL_WORK_SIZE);
+	copy = malloc(FDT_OVL_BASE_SIZE);
+	if (!dtbo || !work || !copy) {
+		printf("fdt_overlay: no memory\n");
+		errors++;
+		goto out;
+	}
+
+	if (fdt_ovl_build_base(fdt) || fdt_ovl_build_overlay(fdto, "gpio")) {
+		printf("fdt_overlay: cannot build test trees\n");
+		errors++;
+		goto out;
+	}
+	dtbo_size = fdt_ovl_build_dtbo(dtbo, fdto);
+	memcpy(copy, fdt, FDT_OVL_BASE_SIZE);
+
+	ret = dev_tree_apply_dtbo(fdt, dtbo, dtbo_size, work, FDT_OVL_WORK_SIZE, false);
+	if (ret || memcmp(copy, fdt, FDT_OVL_BASE_SIZE)) {
+		printf("fdt_overlay: locked device applied the dtbo (%d)\n", ret);
+		errors++;
+	}
+
+	ret = dev_tree_apply_dtbo(fdt, dtbo, dtbo_size, work, FDT_OVL_WORK_SIZE, true);
+	if (!ret && !memcmp(copy, fdt, FDT_OVL_BASE_SIZE)) {
+		printf("fdt_overlay: unlocked device ignored the dtbo\n");
+		errors++;
+	}
+	printf("fdt_overlay: %-20s %s\n", "locked dtbo",
+		errors > before ? "FAILED" : "ok");
+
+out:
+	free(copy);
+	free(work);
+	free(dtbo);
+	free(fdto);
+	free(fdt);
+
+	printf("fdt_overlay: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
+
+#endif
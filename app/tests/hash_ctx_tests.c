@@ -0,0 +1,105 @@
+/*
+ * Streaming hash_ctx against one-shot hashing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <crypto_hash.h>
+#include <app/tests.h>
+
+#define HASH_CTX_TEST_SIZE	(256 * 1024)
+
+/* hash buf in random sized chunks, some of them empty */
+static int hash_ctx_run(unsigned char auth_alg, const unsigned char *buf,
+		unsigned int len, unsigned int max_chunk, unsigned char *digest)
+{
+	struct hash_ctx ctx;
+	unsigned int off = 0, n;
+
+	if (hash_init(&ctx, auth_alg) != CRYPTO_SHA_ERR_NONE)
+		return -1;
+
+	while (off < len) {
+		n = rand() % (max_chunk + 1);
+		if (n > len - off)
+			n = len - off;
+		if (hash_update(&ctx, buf + off, n) != CRYPTO_SHA_ERR_NONE)
+			return -1;
+		off += n;
+	}
+
+	return hash_final(&ctx, digest) == CRYPTO_SHA_ERR_NONE ? 0 : -1;
+}
+
+int hash_ctx_tests(void)
+{
+	static const unsigned int max_chunks[] = { 1, 63, 64, 65, 4096, HASH_CTX_TEST_SIZE };
+	unsigned char ref[SHA256_DIGEST_LENGTH];
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned char auth_alg;
+	unsigned char *buf;
+	unsigned int i, j, len, digest_len;
+	int errors = 0;
+
+	buf = malloc(HASH_CTX_TEST_SIZE);
+	if (!buf) {
+		printf("hash_ctx: no memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < HASH_CTX_TEST_SIZE; i++)
+		buf[i] = (unsigned char)(i * 17 + (i >> 9));
+
+	printf("hash_ctx: engine %s\n",
+		board_ce_type() == CRYPTO_ENGINE_TYPE_HW ? "hw" : "sw");
+
+	for (auth_alg = CRYPTO_AUTH_ALG_SHA1; auth_alg <= CRYPTO_AUTH_ALG_SHA256; auth_alg++) {
+		digest_len = auth_alg == CRYPTO_AUTH_ALG_SHA1 ?
+			SHA_DIGEST_LENGTH : SHA256_DIGEST_LENGTH;
+
+		for (i = 0; i < countof(max_chunks); i++) {
+			for (j = 0; j < 8; j++) {
+				/* small lengths for the block edge cases, then large ones */
+				len = j < 4 ? rand() % 200 : rand() % HASH_CTX_TEST_SIZE;
+
+				if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+					SHA1(buf, len, ref);
+				else
+					SHA256(buf, len, ref);
+
+				if (hash_ctx_run(auth_alg, buf, len, max_chunks[i], md) ||
+					memcmp(md, ref, digest_len)) {
+					printf("hash_ctx: alg %u length %u chunks <= %u failed\n",
+						auth_alg, len, max_chunks[i]);
+					errors++;
+				}
+			}
+		}
+	}
+
+	free(buf);
+
+	printf("hash_ctx: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
@@ -25,6 +25,15 @@
 
 int thread_tests(void);
 void printf_tests(void);
+int parallel_tests(void);
+int sha_tests(void);
+int hash_ctx_tests(void);
+int rsa_tests(void);
+int dma_memcpy_tests(void);
+int verity_tests(void);
+int bam_sg_tests(void);
+int fdt_index_tests(void);
+int fdt_overlay_tests(void);
 
 #endif
 
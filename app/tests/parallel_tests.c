@@ -0,0 +1,193 @@
+/*
+ * Parallel loop tests and hashing benchmark
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <platform.h>
+#include <sha.h>
+#include <app/tests.h>
+#include <kernel/thread.h>
+#include <kernel/parallel.h>
+
+/* benchmark buffer, halved until an allocation succeeds */
+#define HASH_BUF_SIZE	(64 * 1024 * 1024)
+#define HASH_BLOCK_SIZE	(1024 * 1024)
+
+struct hash_job {
+	const unsigned char *buf;
+	unsigned char (*leaf)[SHA256_DIGEST_LENGTH];
+};
+
+static void hash_blocks(void *arg, size_t start, size_t end)
+{
+	struct hash_job *job = arg;
+	size_t i;
+
+	for (i = start; i < end; i++)
+		SHA256(job->buf + i * HASH_BLOCK_SIZE, HASH_BLOCK_SIZE, job->leaf[i]);
+}
+
+static void mark_range(void *arg, size_t start, size_t end)
+{
+	unsigned char *seen = arg;
+	size_t i;
+
+	for (i = start; i < end; i++)
+		seen[i]++;
+}
+
+/* every index must be visited exactly once, whatever the chunking */
+static int parallel_for_test(void)
+{
+	static const size_t chunks[] = { 1, 3, 64, 1000, 0 };
+	unsigned char seen[1000];
+	uint c;
+	size_t i;
+
+	for (c = 0; c < countof(chunks); c++) {
+		memset(seen, 0, sizeof(seen));
+		parallel_for(0, sizeof(seen), chunks[c], mark_range, seen);
+
+		for (i = 0; i < sizeof(seen); i++) {
+			if (seen[i] != 1) {
+				printf("parallel_for: chunk %u index %u visited %u times\n",
+					chunks[c], i, seen[i]);
+				return -1;
+			}
+		}
+	}
+
+	printf("parallel_for: ok\n");
+	return 0;
+}
+
+#define SLEEP_TASKS	8
+#define SLEEP_MS	20
+
+static void sleep_task(void *arg)
+{
+	thread_sleep(SLEEP_MS);
+}
+
+/*
+ * Tasks that block overlap on the pool even on one CPU: with the workers
+ * and the waiting caller all sleeping at once, the group must finish in
+ * well under the time the tasks take back to back.
+ */
+static int task_group_test(void)
+{
+	struct task_group group;
+	struct parallel_stats stats;
+	time_t t0, elapsed;
+	uint i;
+
+	t0 = current_time();
+	task_group_init(&group);
+	for (i = 0; i < SLEEP_TASKS; i++)
+		task_group_run(&group, sleep_task, NULL);
+	task_group_wait(&group);
+	elapsed = current_time() - t0;
+
+	parallel_get_stats(&stats);
+	printf("task group: %u x %u ms sleeps in %u ms, %u workers, %u tasks, "
+		"%u steals, %u inline\n", SLEEP_TASKS, SLEEP_MS, elapsed,
+		PARALLEL_WORKERS, stats.tasks, stats.steals, stats.inline_runs);
+
+	if (PARALLEL_WORKERS && elapsed >= SLEEP_TASKS * SLEEP_MS * 3 / 4) {
+		printf("task group: tasks did not overlap\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Hash a large buffer as 1 MB leaves plus a root over the leaf digests,
+ * the layout used for tree-style image verification, once straight
+ * through and once spread over the pool. The pool shares the one CPU, so
+ * this shows its overhead on pure computation rather than a speedup.
+ */
+static int parallel_hash_bench(void)
+{
+	unsigned char serial_root[SHA256_DIGEST_LENGTH];
+	unsigned char par_root[SHA256_DIGEST_LENGTH];
+	struct hash_job job;
+	unsigned char *buf;
+	size_t size = HASH_BUF_SIZE;
+	size_t blocks, i;
+	time_t t0, serial_ms, par_ms;
+
+	while (!(buf = malloc(size)) && size > HASH_BLOCK_SIZE)
+		size /= 2;
+	if (!buf) {
+		printf("parallel hash: no memory\n");
+		return -1;
+	}
+
+	blocks = size / HASH_BLOCK_SIZE;
+	job.buf = buf;
+	job.leaf = malloc(blocks * SHA256_DIGEST_LENGTH);
+	if (!job.leaf) {
+		free(buf);
+		return -1;
+	}
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)(i * 31 + (i >> 12));
+
+	t0 = current_time();
+	hash_blocks(&job, 0, blocks);
+	SHA256((unsigned char *)job.leaf, blocks * SHA256_DIGEST_LENGTH, serial_root);
+	serial_ms = current_time() - t0;
+
+	memset(job.leaf, 0, blocks * SHA256_DIGEST_LENGTH);
+
+	t0 = current_time();
+	parallel_for(0, blocks, 1, hash_blocks, &job);
+	SHA256((unsigned char *)job.leaf, blocks * SHA256_DIGEST_LENGTH, par_root);
+	par_ms = current_time() - t0;
+
+	printf("parallel hash: %u MB, %u workers, serial %u ms, parallel %u ms\n",
+		size / (1024 * 1024), PARALLEL_WORKERS, serial_ms, par_ms);
+
+	free(job.leaf);
+	free(buf);
+
+	if (memcmp(serial_root, par_root, sizeof(serial_root))) {
+		printf("parallel hash: root digest mismatch\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int parallel_tests(void)
+{
+	if (parallel_for_test())
+		return -1;
+
+	if (task_group_test())
+		return -1;
+
+	return parallel_hash_bench();
+}
@@ -0,0 +1,259 @@
+/*
+ * RSA public key operation known answer tests and throughput
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <platform.h>
+#include <sha.h>
+#include <openssl/rsa.h>
+#include <openssl/bn.h>
+#include <arm_arch.h>
+#include <app/tests.h>
+
+#define RSA_TEST_E		65537
+#define RSA_CROSS_CHECKS	16
+#define RSA_BENCH_OPS		32
+
+struct rsa_path {
+	const char *name;
+	unsigned int caps;
+};
+
+/* each entry is run with OPENSSL_armcap_P forced to exactly its caps */
+static const struct rsa_path rsa_paths[] = {
+	{ "neon", ARMV7_NEON },
+	{ "armv4", 0 },
+};
+
+/*
+ * Modulus and input come from an xorshift stream, see rsa_gen(); the
+ * vectors hold the SHA-256 of input^65537 mod modulus.
+ */
+struct rsa_kat {
+	unsigned bits;
+	uint32_t seed;
+	const char *sha256;
+};
+
+static const struct rsa_kat rsa_kats[] = {
+	{ 2048, 0x12345678,
+	  "56c007b126c743486c21331ace1ade67849bee2d2b80f3e136ac85fc32fdd200" },
+	{ 4096, 0x9abcdef1,
+	  "3a05e9e6c660e04693927fc98521239158c7e81580a5b73441352b2d717d0018" },
+};
+
+static void rsa_hex(const unsigned char *md, unsigned len, char *out)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned i;
+
+	for (i = 0; i < len; i++) {
+		out[2 * i] = hex[md[i] >> 4];
+		out[2 * i + 1] = hex[md[i] & 0xf];
+	}
+	out[2 * len] = 0;
+}
+
+/* odd modulus with the top bit set and an input below it */
+static void rsa_gen(uint32_t seed, unsigned char *n, unsigned char *in,
+		unsigned len)
+{
+	uint32_t x = seed;
+	unsigned i;
+
+	for (i = 0; i < 2 * len; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		if (i < len)
+			n[i] = x & 0xff;
+		else
+			in[i - len] = x & 0xff;
+	}
+
+	n[0] |= 0x80;
+	n[len - 1] |= 1;
+	in[0] &= 0x7f;
+}
+
+static RSA *rsa_key(const unsigned char *n, unsigned len)
+{
+	RSA *rsa = RSA_new();
+
+	if (rsa == NULL)
+		return NULL;
+
+	rsa->n = BN_bin2bn(n, len, NULL);
+	rsa->e = BN_new();
+	if (rsa->n == NULL || rsa->e == NULL ||
+	    !BN_set_word(rsa->e, RSA_TEST_E)) {
+		RSA_free(rsa);
+		return NULL;
+	}
+
+	return rsa;
+}
+
+/* the public key operation of a signature check, without the padding */
+static int rsa_public(RSA *rsa, const unsigned char *in, unsigned char *out,
+		unsigned len)
+{
+	return RSA_public_decrypt(len, in, out, rsa, RSA_NO_PADDING) == (int)len;
+}
+
+static int rsa_kat_run(const char *path, unsigned char *buf)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	char hex[2 * SHA256_DIGEST_LENGTH + 1];
+	unsigned i, len;
+	RSA *rsa;
+	int errors = 0;
+
+	for (i = 0; i < countof(rsa_kats); i++) {
+		len = rsa_kats[i].bits / 8;
+		rsa_gen(rsa_kats[i].seed, buf, buf + len, len);
+
+		rsa = rsa_key(buf, len);
+		if (rsa == NULL || !rsa_public(rsa, buf + len, buf + 2 * len, len)) {
+			printf("rsa: %s %u bit vector failed to run\n", path, rsa_kats[i].bits);
+			errors++;
+		} else {
+			SHA256(buf + 2 * len, len, md);
+			rsa_hex(md, SHA256_DIGEST_LENGTH, hex);
+			if (strcmp(hex, rsa_kats[i].sha256)) {
+				printf("rsa: %s %u bit vector failed: %s\n", path, rsa_kats[i].bits, hex);
+				errors++;
+			}
+		}
+		if (rsa)
+			RSA_free(rsa);
+	}
+
+	return errors;
+}
+
+/* random moduli and inputs, compared against the scalar code */
+static int rsa_cross_check(const char *path, unsigned int caps,
+		unsigned char *buf)
+{
+	unsigned i, len;
+	unsigned char *n, *in, *out, *ref;
+	RSA *rsa;
+	int errors = 0;
+
+	for (i = 0; i < RSA_CROSS_CHECKS; i++) {
+		len = (i & 1) ? 512 : 256;
+		n = buf;
+		in = n + len;
+		out = in + len;
+		ref = out + len;
+		rsa_gen(rand(), n, in, len);
+
+		rsa = rsa_key(n, len);
+		if (rsa == NULL) {
+			errors++;
+			continue;
+		}
+
+		OPENSSL_armcap_P = 0;
+		rsa_public(rsa, in, ref, len);
+		OPENSSL_armcap_P = caps;
+		rsa_public(rsa, in, out, len);
+		if (memcmp(out, ref, len)) {
+			printf("rsa: %s mismatch, %u bits, run %u\n", path, len * 8, i);
+			errors++;
+		}
+
+		RSA_free(rsa);
+	}
+
+	return errors;
+}
+
+static void rsa_bench(const char *path, unsigned char *buf)
+{
+	unsigned i, j, len;
+	bigtime_t t0, us;
+	RSA *rsa;
+
+	for (i = 0; i < countof(rsa_kats); i++) {
+		len = rsa_kats[i].bits / 8;
+		rsa_gen(rsa_kats[i].seed, buf, buf + len, len);
+		rsa = rsa_key(buf, len);
+		if (rsa == NULL)
+			continue;
+
+		/* the first call sets up the cached Montgomery context */
+		rsa_public(rsa, buf + len, buf + 2 * len, len);
+
+		t0 = current_time_hires();
+		for (j = 0; j < RSA_BENCH_OPS; j++)
+			rsa_public(rsa, buf + len, buf + 2 * len, len);
+		us = current_time_hires() - t0;
+
+		printf("rsa: %-8s %u bit verify %5llu ops/s\n", path, rsa_kats[i].bits,
+			us ? RSA_BENCH_OPS * 1000000ULL / us : 0);
+
+		RSA_free(rsa);
+	}
+}
+
+int rsa_tests(void)
+{
+	unsigned int saved = OPENSSL_armcap();
+	unsigned char *buf;
+	unsigned i;
+	int errors = 0;
+
+	/* modulus, input, output and reference for 4096 bit keys */
+	buf = malloc(4 * 512);
+	if (!buf) {
+		printf("rsa: no memory\n");
+		return -1;
+	}
+
+	printf("rsa: cpu caps 0x%x\n", saved);
+
+	for (i = 0; i < countof(rsa_paths); i++) {
+		const struct rsa_path *p = &rsa_paths[i];
+
+		if ((saved & p->caps) != p->caps) {
+			printf("rsa: %-8s not supported\n", p->name);
+			continue;
+		}
+
+		OPENSSL_armcap_P = p->caps;
+		errors += rsa_kat_run(p->name, buf);
+		errors += rsa_cross_check(p->name, p->caps, buf);
+		OPENSSL_armcap_P = p->caps;
+		rsa_bench(p->name, buf);
+	}
+
+	OPENSSL_armcap_P = saved;
+	free(buf);
+
+	printf("rsa: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
@@ -2,10 +2,22 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 
 INCLUDES += -I$(LOCAL_DIR)/include
 
+# dma_memcpy_tests runs against the software engine on any target
+MODULES += lib/dma_memcpy
+
 OBJS += \
 	$(LOCAL_DIR)/tests.o \
 	$(LOCAL_DIR)/thread_tests.o \
 	$(LOCAL_DIR)/printf_tests.o \
+	$(LOCAL_DIR)/parallel_tests.o \
+	$(LOCAL_DIR)/sha_tests.o \
+	$(LOCAL_DIR)/hash_ctx_tests.o \
+	$(LOCAL_DIR)/rsa_tests.o \
+	$(LOCAL_DIR)/verity_tests.o \
+	$(LOCAL_DIR)/dma_memcpy_tests.o \
+	$(LOCAL_DIR)/bam_sg_tests.o \
+	$(LOCAL_DIR)/fdt_index_tests.o \
+	$(LOCAL_DIR)/fdt_overlay_tests.o \
 	$(LOCAL_DIR)/i2c_tests.o \
 	$(LOCAL_DIR)/adc_tests.o \
 	$(LOCAL_DIR)/kauth_test.o
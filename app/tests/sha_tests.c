@@ -0,0 +1,207 @@
+/*
+ * SHA-1/SHA-256 known answer tests and throughput
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <platform.h>
+#include <sha.h>
+#include <arm_arch.h>
+#include <app/tests.h>
+
+#define SHA_BENCH_SIZE	(4 * 1024 * 1024)
+
+struct sha_path {
+	const char *name;
+	unsigned int caps;
+};
+
+/* each entry is run with OPENSSL_armcap_P forced to exactly its caps */
+static const struct sha_path sha_paths[] = {
+	{ "armv8-ce", ARMV7_NEON | ARMV8_SHA1 | ARMV8_SHA256 },
+	{ "neon", ARMV7_NEON },
+	{ "armv4", 0 },
+};
+
+struct sha_kat {
+	const char *msg;
+	unsigned repeat;
+	const char *sha1;
+	const char *sha256;
+};
+
+static const struct sha_kat sha_kats[] = {
+	{ "abc", 1,
+	  "a9993e364706816aba3e25717850c26c9cd0d89d",
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+	  "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 10000,
+	  "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+	  "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+static void sha_hex(const unsigned char *md, unsigned len, char *out)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned i;
+
+	for (i = 0; i < len; i++) {
+		out[2 * i] = hex[md[i] >> 4];
+		out[2 * i + 1] = hex[md[i] & 0xf];
+	}
+	out[2 * len] = 0;
+}
+
+static int sha_kat_run(const char *path)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	char hex[2 * SHA256_DIGEST_LENGTH + 1];
+	SHA_CTX c1;
+	SHA256_CTX c256;
+	unsigned i, j;
+	size_t len;
+	int errors = 0;
+
+	for (i = 0; i < countof(sha_kats); i++) {
+		len = strlen(sha_kats[i].msg);
+
+		SHA1_Init(&c1);
+		SHA256_Init(&c256);
+		for (j = 0; j < sha_kats[i].repeat; j++) {
+			SHA1_Update(&c1, sha_kats[i].msg, len);
+			SHA256_Update(&c256, sha_kats[i].msg, len);
+		}
+
+		SHA1_Final(md, &c1);
+		sha_hex(md, SHA_DIGEST_LENGTH, hex);
+		if (strcmp(hex, sha_kats[i].sha1)) {
+			printf("sha: %s sha1 vector %u failed: %s\n", path, i, hex);
+			errors++;
+		}
+
+		SHA256_Final(md, &c256);
+		sha_hex(md, SHA256_DIGEST_LENGTH, hex);
+		if (strcmp(hex, sha_kats[i].sha256)) {
+			printf("sha: %s sha256 vector %u failed: %s\n", path, i, hex);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/* odd lengths at odd offsets, compared against the scalar code */
+static int sha_cross_check(const char *path, unsigned int caps,
+		const unsigned char *buf)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned char ref[SHA256_DIGEST_LENGTH];
+	unsigned i, off, len;
+	int errors = 0;
+
+	for (i = 0; i < 64; i++) {
+		off = rand() % 64;
+		len = rand() % 8192;
+
+		OPENSSL_armcap_P = 0;
+		SHA256(buf + off, len, ref);
+		OPENSSL_armcap_P = caps;
+		SHA256(buf + off, len, md);
+		if (memcmp(md, ref, SHA256_DIGEST_LENGTH)) {
+			printf("sha: %s sha256 mismatch, offset %u length %u\n", path, off, len);
+			errors++;
+		}
+
+		OPENSSL_armcap_P = 0;
+		SHA1(buf + off, len, ref);
+		OPENSSL_armcap_P = caps;
+		SHA1(buf + off, len, md);
+		if (memcmp(md, ref, SHA_DIGEST_LENGTH)) {
+			printf("sha: %s sha1 mismatch, offset %u length %u\n", path, off, len);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static void sha_bench(const char *path, const unsigned char *buf, size_t size)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	bigtime_t t0, sha1_us, sha256_us;
+
+	t0 = current_time_hires();
+	SHA1(buf, size, md);
+	sha1_us = current_time_hires() - t0;
+
+	t0 = current_time_hires();
+	SHA256(buf, size, md);
+	sha256_us = current_time_hires() - t0;
+
+	/* bytes per microsecond is MB/s */
+	printf("sha: %-8s sha1 %4llu MB/s, sha256 %4llu MB/s\n", path,
+		sha1_us ? (unsigned long long)size / sha1_us : 0,
+		sha256_us ? (unsigned long long)size / sha256_us : 0);
+}
+
+int sha_tests(void)
+{
+	unsigned int saved = OPENSSL_armcap();
+	unsigned char *buf;
+	unsigned i;
+	int errors = 0;
+
+	buf = malloc(SHA_BENCH_SIZE);
+	if (!buf) {
+		printf("sha: no memory\n");
+		return -1;
+	}
+	for (i = 0; i < SHA_BENCH_SIZE; i++)
+		buf[i] = (unsigned char)(i * 131 + (i >> 10));
+
+	printf("sha: cpu caps 0x%x\n", saved);
+
+	for (i = 0; i < countof(sha_paths); i++) {
+		const struct sha_path *p = &sha_paths[i];
+
+		if ((saved & p->caps) != p->caps) {
+			printf("sha: %-8s not supported\n", p->name);
+			continue;
+		}
+
+		OPENSSL_armcap_P = p->caps;
+		errors += sha_kat_run(p->name);
+		errors += sha_cross_check(p->name, p->caps, buf);
+		OPENSSL_armcap_P = p->caps;
+		sha_bench(p->name, buf, SHA_BENCH_SIZE);
+	}
+
+	OPENSSL_armcap_P = saved;
+	free(buf);
+
+	printf("sha: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
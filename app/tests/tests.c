@@ -31,6 +31,21 @@
 STATIC_COMMAND_START
 STATIC_COMMAND("printf_tests", NULL, (console_cmd)&printf_tests)
 STATIC_COMMAND("thread_tests", NULL, (console_cmd)&thread_tests)
+STATIC_COMMAND("parallel_tests", NULL, (console_cmd)&parallel_tests)
+STATIC_COMMAND("sha_tests", NULL, (console_cmd)&sha_tests)
+STATIC_COMMAND("hash_ctx_tests", NULL, (console_cmd)&hash_ctx_tests)
+STATIC_COMMAND("rsa_tests", NULL, (console_cmd)&rsa_tests)
+STATIC_COMMAND("dma_memcpy_tests", NULL, (console_cmd)&dma_memcpy_tests)
+#if VERIFIED_BOOT
+STATIC_COMMAND("verity_tests", NULL, (console_cmd)&verity_tests)
+#endif
+#if CRYPTO_BAM
+STATIC_COMMAND("bam_sg_tests", NULL, (console_cmd)&bam_sg_tests)
+#endif
+#if DEVICE_TREE
+STATIC_COMMAND("fdt_index_tests", NULL, (console_cmd)&fdt_index_tests)
+STATIC_COMMAND("fdt_overlay_tests", NULL, (console_cmd)&fdt_overlay_tests)
+#endif
 STATIC_COMMAND_END(tests);
 
 #endif
@@ -25,7 +25,13 @@
 #include <app/tests.h>
 #include <kernel/thread.h>
 #include <kernel/mutex.h>
+#include <kernel/rwlock.h>
+#include <kernel/once.h>
 #include <kernel/event.h>
+#include <kernel/timer.h>
+#include <stdlib.h>
+#include <string.h>
+#include <platform.h>
 
 static int sleep_thread(void *arg)
 {
@@ -308,8 +314,278 @@ static void atomic_test(void)
 	printf("atomic count == %d (should be zero)\n", atomic);
 }
 
+#define TIMER_STRESS_COUNT 10000
+
+static volatile int timer_stress_fired;
+static volatile bigtime_t timer_stress_last;
+static volatile int timer_stress_last_idx;
+static volatile int timer_stress_order_errors;
+
+/* arg is the arming index, timers due at the same time must fire in it */
+static enum handler_return timer_stress_cb(struct timer *t, time_t now, void *arg)
+{
+	int idx = (int)(uintptr_t)arg;
+
+	if (t->scheduled_time < timer_stress_last ||
+	    (t->scheduled_time == timer_stress_last && idx < timer_stress_last_idx))
+		timer_stress_order_errors++;
+	timer_stress_last = t->scheduled_time;
+	timer_stress_last_idx = idx;
+	timer_stress_fired++;
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* arm and cancel a large number of timers, then let a batch of them expire */
+static void timer_stress_test(void)
+{
+	timer_t *timers;
+	int i, expected;
+	bigtime_t t0, arm_us, cancel_us;
+
+	timers = malloc(TIMER_STRESS_COUNT * sizeof(timer_t));
+	if (!timers) {
+		printf("timer stress: no memory\n");
+		return;
+	}
+
+	for (i = 0; i < TIMER_STRESS_COUNT; i++)
+		timer_initialize(&timers[i]);
+
+	/* far enough out that none fire while arming and cancelling */
+	t0 = current_time_hires();
+	for (i = 0; i < TIMER_STRESS_COUNT; i++)
+		timer_set_oneshot(&timers[i], 10000 + rand() % 10000, timer_stress_cb, NULL);
+	arm_us = current_time_hires() - t0;
+
+	t0 = current_time_hires();
+	for (i = 0; i < TIMER_STRESS_COUNT; i++)
+		timer_cancel(&timers[i]);
+	cancel_us = current_time_hires() - t0;
+
+	printf("timer stress: armed %d in %llu us, cancelled in %llu us\n",
+		TIMER_STRESS_COUNT, arm_us, cancel_us);
+
+	/* short deadlines, cancel every third one, the rest must fire in order */
+	timer_stress_fired = 0;
+	timer_stress_last = 0;
+	timer_stress_last_idx = 0;
+	timer_stress_order_errors = 0;
+	for (i = 0; i < TIMER_STRESS_COUNT; i++)
+		timer_set_oneshot_us(&timers[i], rand() % 200000, timer_stress_cb,
+			(void *)(uintptr_t)i);
+	for (i = 0; i < TIMER_STRESS_COUNT; i++) {
+		if (i % 3 == 0)
+			timer_cancel(&timers[i]);
+	}
+
+	thread_sleep(500);
+
+	/* a cancelled timer may already have fired */
+	expected = TIMER_STRESS_COUNT - (TIMER_STRESS_COUNT + 2) / 3;
+	printf("timer stress: %d fired, expected %d to %d, %d out of order\n",
+		timer_stress_fired, expected, TIMER_STRESS_COUNT,
+		timer_stress_order_errors);
+
+	for (i = 0; i < TIMER_STRESS_COUNT; i++)
+		timer_cancel(&timers[i]);
+	free(timers);
+}
+
+#define RWLOCK_READERS 4
+#define RWLOCK_WRITERS 2
+#define RWLOCK_ITERATIONS 2000
+
+static rwlock_t rw;
+static volatile int rw_a, rw_b;
+static volatile int rw_active_readers, rw_active_writers;
+static volatile int rw_errors;
+static volatile int rw_thread_count;
+
+static int rwlock_reader(void *arg)
+{
+	int i;
+
+	for (i = 0; i < RWLOCK_ITERATIONS; i++) {
+		rwlock_acquire_read(&rw);
+		atomic_add(&rw_active_readers, 1);
+
+		if (rw_active_writers != 0 || rw_a != rw_b)
+			rw_errors++;
+		if ((i & 7) == 0)
+			thread_yield();
+
+		atomic_add(&rw_active_readers, -1);
+		rwlock_release_read(&rw);
+	}
+	atomic_add(&rw_thread_count, -1);
+
+	return 0;
+}
+
+static int rwlock_writer(void *arg)
+{
+	int i;
+
+	for (i = 0; i < RWLOCK_ITERATIONS / 4; i++) {
+		rwlock_acquire_write(&rw);
+		atomic_add(&rw_active_writers, 1);
+
+		if (rw_active_writers != 1 || rw_active_readers != 0)
+			rw_errors++;
+		rw_a++;
+		thread_yield();
+		rw_b++;
+
+		atomic_add(&rw_active_writers, -1);
+		rwlock_release_write(&rw);
+		thread_yield();
+	}
+	atomic_add(&rw_thread_count, -1);
+
+	return 0;
+}
+
+static volatile int once_runs;
+static volatile int once_thread_count;
+static volatile int once_errors;
+static once_t once_control;
+
+static void once_routine_test(void)
+{
+	/* give the other callers a chance to pile up behind us */
+	thread_yield();
+	thread_sleep(10);
+	once_runs++;
+}
+
+static int once_thread(void *arg)
+{
+	once(&once_control, once_routine_test);
+	if (once_runs != 1)
+		once_errors++;
+	atomic_add(&once_thread_count, -1);
+
+	return 0;
+}
+
+/* hammer an rwlock with mixed readers and writers, then race callers of once() */
+static int rwlock_stress_test(void)
+{
+	int i;
+	int errors = 0;
+	bigtime_t t0;
+
+	rwlock_init(&rw);
+	rw_a = rw_b = 0;
+	rw_errors = 0;
+	rw_thread_count = RWLOCK_READERS + RWLOCK_WRITERS;
+
+	t0 = current_time_hires();
+	for (i = 0; i < RWLOCK_READERS; i++)
+		thread_resume(thread_create("rwlock reader", &rwlock_reader, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	for (i = 0; i < RWLOCK_WRITERS; i++)
+		thread_resume(thread_create("rwlock writer", &rwlock_writer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (rw_thread_count > 0)
+		thread_sleep(10);
+
+	printf("rwlock stress: %d writes in %llu us, %u contended, %d errors (should be zero)\n",
+		rw_a, current_time_hires() - t0, rw.contended, rw_errors);
+	rwlock_destroy(&rw);
+	errors += rw_errors;
+
+	/* a fresh control each run, or a second run never calls the routine */
+	once_control = (once_t)ONCE_INIT;
+	once_runs = 0;
+	once_errors = 0;
+	once_thread_count = 5;
+	for (i = 0; i < 5; i++)
+		thread_resume(thread_create("once tester", &once_thread, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (once_thread_count > 0)
+		thread_sleep(10);
+
+	printf("once: routine ran %d times (should be one), %d errors\n", once_runs, once_errors);
+	errors += once_errors;
+	if (once_runs != 1)
+		errors++;
+
+	lock_dump_stats();
+
+	return errors;
+}
+
+#if THREAD_STATS
+#define ACCT_SPINNERS 2
+#define ACCT_SPIN_US 100000
+
+static volatile int acct_thread_count;
+static volatile bigtime_t acct_run_time[ACCT_SPINNERS];
+
+/* cpu bound, but every slice ends in a yield to the other spinner */
+static int acct_spinner(void *arg)
+{
+	int idx = (int)(uintptr_t)arg;
+	bigtime_t t0 = current_time_hires();
+	bigtime_t slice;
+
+	while (current_time_hires() - t0 < ACCT_SPIN_US) {
+		slice = current_time_hires();
+		while (current_time_hires() - slice < 1000)
+			;
+		thread_yield();
+	}
+
+	acct_run_time[idx] = current_thread->acct.run_time;
+	atomic_add(&acct_thread_count, -1);
+
+	return 0;
+}
+
+/* slices ended by a yield must be charged to the thread that ran them */
+static int thread_acct_test(void)
+{
+	struct thread_usage usage[32];
+	uint i, n;
+	int errors = 0;
+
+	acct_thread_count = ACCT_SPINNERS;
+	for (i = 0; i < ACCT_SPINNERS; i++) {
+		acct_run_time[i] = 0;
+		thread_resume(thread_create("acct spinner", &acct_spinner,
+			(void *)(uintptr_t)i, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	}
+
+	while (acct_thread_count > 0)
+		thread_sleep(10);
+
+	/* each spinner had about half the cpu for the whole window */
+	for (i = 0; i < ACCT_SPINNERS; i++) {
+		printf("thread acct: spinner %u ran %llu us\n", i, acct_run_time[i]);
+		if (acct_run_time[i] < ACCT_SPIN_US / ACCT_SPINNERS / 2)
+			errors++;
+	}
+
+	n = thread_get_usage(usage, countof(usage));
+	for (i = 0; i < n; i++) {
+		if (!strcmp(usage[i].name, "idle") && usage[i].acct.preemptions) {
+			printf("thread acct: idle thread counted %u preemptions\n",
+				usage[i].acct.preemptions);
+			errors++;
+		}
+	}
+
+	printf("thread acct: %d errors\n", errors);
+
+	return errors;
+}
+#endif
+
 int thread_tests(void) 
 {
+	int errors = 0;
+
 	mutex_test();
 	event_test();
 
@@ -317,6 +593,14 @@ int thread_tests(void)
 	context_switch_test();
 
 	atomic_test();
-	
-	return 0;
+
+	timer_stress_test();
+
+	errors += rwlock_stress_test();
+
+#if THREAD_STATS
+	errors += thread_acct_test();
+#endif
+
+	return errors ? -1 : 0;
 }
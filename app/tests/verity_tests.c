@@ -0,0 +1,422 @@
+/*
+ * dm-verity hash tree and multi-buffer SHA-256 tests
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <rand.h>
+#include <platform.h>
+#include <arch/defines.h>
+#include <sha.h>
+#include <arm_arch.h>
+#include <verity.h>
+#include <app/tests.h>
+
+#if VERIFIED_BOOT
+
+struct verity_path {
+	const char *name;
+	unsigned int caps;
+};
+
+/* each entry is run with OPENSSL_armcap_P forced to exactly its caps */
+static const struct verity_path verity_paths[] = {
+	{ "neon", ARMV7_NEON },
+	{ "armv4", 0 },
+};
+
+/*
+ * Filesystem data comes from an xorshift stream with an ext4 superblock
+ * patched in, see verity_gen(). The root digests were computed offline
+ * by an independent tree builder over the same data.
+ */
+struct verity_kat {
+	uint32_t block_size;
+	uint32_t data_blocks;
+	uint32_t seed;
+	const char *salt;
+	const char *root;
+};
+
+static const struct verity_kat verity_kats[] = {
+	{ 4096, 300, 0x1f2e3d4c,
+	  "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+	  "0bc47fb15276175c4a2c1476e32bc886a2e6d4f67701e9f6717422986a129842" },
+	{ 512, 5000, 0x5a5a1234, "-",
+	  "9bcb72989eb798b0810b351d3cbf472f19fb2f777f6362a5c516b6d3fd6977e3" },
+};
+
+struct verity_image {
+	unsigned char *buf;
+	uint64_t size;
+	uint64_t meta;		/* offset of the metadata */
+	uint64_t tree;		/* offset of the hash tree */
+	uint64_t leaves;	/* offset of the leaf level */
+};
+
+static void verity_put_le32(unsigned char *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static void verity_gen(const struct verity_kat *kat, unsigned char *data)
+{
+	uint64_t fs_size = (uint64_t)kat->block_size * kat->data_blocks;
+	unsigned char *sb = data + 1024;
+	uint32_t log_bs = fs_size % 4096 ? 0 : 2;
+	uint32_t x = kat->seed;
+	uint64_t i;
+
+	for (i = 0; i < fs_size; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		data[i] = x & 0xff;
+	}
+
+	verity_put_le32(sb + 0x04, fs_size >> (10 + log_bs));
+	verity_put_le32(sb + 0x18, log_bs);
+	sb[0x38] = 0x53;
+	sb[0x39] = 0xef;
+	verity_put_le32(sb + 0x60, 0);
+}
+
+static void verity_hash(const unsigned char *salt, size_t salt_len,
+		const unsigned char *block, size_t len, unsigned char *md)
+{
+	SHA256_CTX c;
+
+	SHA256_Init(&c);
+	SHA256_Update(&c, salt, salt_len);
+	SHA256_Update(&c, block, len);
+	SHA256_Final(md, &c);
+}
+
+static unsigned verity_unhex(const char *s, unsigned char *out)
+{
+	unsigned n = 0;
+
+	for (; s[0] && s[1]; s += 2) {
+		out[n] = (s[0] <= '9' ? s[0] - '0' : s[0] - 'a' + 10) << 4;
+		out[n++] |= s[1] <= '9' ? s[1] - '0' : s[1] - 'a' + 10;
+	}
+	return n;
+}
+
+/*
+ * Lay out data, metadata and tree the way Android's build tools do. The
+ * tree is built here with plain SHA256() a block at a time; the root it
+ * ends up with is checked against the vector.
+ */
+static int verity_build(const struct verity_kat *kat, struct verity_image *img)
+{
+	uint32_t bs = kat->block_size;
+	uint32_t per_block = bs / SHA256_DIGEST_LENGTH;
+	uint64_t level_blocks[VERITY_LEVELS_MAX], n, start, src, dst, i;
+	unsigned char salt[VERITY_SALT_MAX], root[SHA256_DIGEST_LENGTH];
+	unsigned char expect[SHA256_DIGEST_LENGTH];
+	unsigned salt_len, levels = 0, l;
+	char *table;
+	uint64_t tree_blocks = 0;
+
+	salt_len = verity_unhex(kat->salt, salt);
+
+	n = kat->data_blocks;
+	do {
+		n = (n + per_block - 1) / per_block;
+		level_blocks[levels++] = n;
+		tree_blocks += n;
+	} while (n > 1);
+
+	img->meta = (uint64_t)bs * kat->data_blocks;
+	img->tree = img->meta + VERITY_METADATA_SIZE;
+	img->size = img->tree + tree_blocks * bs;
+	img->buf = memalign(CACHE_LINE, img->size);
+	if (img->buf == NULL)
+		return -1;
+	memset(img->buf + img->meta, 0, img->size - img->meta);
+	verity_gen(kat, img->buf);
+
+	/* levels bottom up; level l sits after all the levels above it */
+	src = 0;
+	n = kat->data_blocks;
+	for (l = 0; l < levels; l++) {
+		start = 0;
+		for (i = l + 1; i < levels; i++)
+			start += level_blocks[i];
+		dst = img->tree + start * bs;
+		if (l == 0)
+			img->leaves = dst;
+		for (i = 0; i < n; i++)
+			verity_hash(salt, salt_len, img->buf + src + i * bs, bs,
+				img->buf + dst + i * SHA256_DIGEST_LENGTH);
+		src = dst;
+		n = level_blocks[l];
+	}
+	verity_hash(salt, salt_len, img->buf + img->tree, bs, root);
+
+	verity_put_le32(img->buf + img->meta, VERITY_METADATA_MAGIC);
+	table = (char *)img->buf + img->meta + 8 + VERITY_SIGNATURE_SIZE + 4;
+	snprintf(table, VERITY_TABLE_MAX,
+		"1 /dev/block/test /dev/block/test %u %u %u %llu sha256 %s %s",
+		bs, bs, kat->data_blocks,
+		(unsigned long long)(img->tree / bs), kat->root, kat->salt);
+	verity_put_le32(img->buf + img->meta + 8 + VERITY_SIGNATURE_SIZE,
+		strlen(table));
+
+	verity_unhex(kat->root, expect);
+	return memcmp(expect, root, SHA256_DIGEST_LENGTH) ? 1 : 0;
+}
+
+/* bit n is set when data at n MB was read, see verity_sample_check() */
+static uint32_t verity_read_map;
+static uint64_t verity_data_size;
+
+static int verity_mem_read(struct verity *v, uint64_t offset, void *buf,
+		uint32_t len)
+{
+	if (offset > v->size || len > v->size - offset)
+		return VERITY_ERR_IO;
+	if (offset < verity_data_size)
+		verity_read_map |= 1 << (offset >> 20);
+	memcpy(buf, (unsigned char *)v->arg + v->base + offset, len);
+	return VERITY_OK;
+}
+
+static int verity_run(struct verity_image *img, uint32_t sample, int expect,
+		const char *what, const char *path)
+{
+	struct verity v;
+	void *buf;
+	int ret;
+
+	ret = verity_init(&v, verity_mem_read, img->buf, 0, img->size, NULL);
+	if (ret == VERITY_OK) {
+		buf = memalign(CACHE_LINE, verity_buf_size(&v));
+		if (buf == NULL)
+			return 1;
+		ret = verity_verify(&v, sample, buf, verity_buf_size(&v));
+		free(buf);
+	}
+
+	if (ret != expect) {
+		printf("verity: %s %s: got \"%s\", expected \"%s\"\n", path, what,
+			verity_strerror(ret), verity_strerror(expect));
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Sampled checks must not skip the same data every time. Over a few runs
+ * at least two have to have read different chunks; with three chunks and
+ * sample 2 that fails by chance about once in two million.
+ */
+static int verity_sample_check(struct verity_image *img, const char *path)
+{
+	uint32_t first = 0;
+	unsigned i;
+	int errors = 0;
+	bool differ = false;
+
+	verity_data_size = img->meta;
+	for (i = 0; i < 8; i++) {
+		verity_read_map = 0;
+		errors += verity_run(img, 2, VERITY_ERR_UNSIGNED, "sample", path);
+		if (i == 0)
+			first = verity_read_map;
+		else if (verity_read_map != first)
+			differ = true;
+	}
+	verity_data_size = 0;
+
+	if (!differ) {
+		printf("verity: %s sampled runs all read chunks 0x%x\n", path, first);
+		errors++;
+	}
+	return errors;
+}
+
+static int verity_kat_run(const char *path)
+{
+	struct verity_image img;
+	unsigned char *p;
+	unsigned i;
+	int errors = 0;
+
+	for (i = 0; i < countof(verity_kats); i++) {
+		const struct verity_kat *kat = &verity_kats[i];
+
+		if (verity_build(kat, &img)) {
+			printf("verity: %s vector %u: root mismatch\n", path, i);
+			errors++;
+			if (img.buf == NULL)
+				continue;
+		}
+
+		/* no key here, so a clean image is never more than unsigned */
+		errors += verity_run(&img, 1, VERITY_ERR_UNSIGNED, "clean", path);
+		errors += verity_run(&img, 4, VERITY_ERR_UNSIGNED, "sampled", path);
+		if (img.meta > 2 * 1024 * 1024)
+			errors += verity_sample_check(&img, path);
+
+		/* a flipped bit in the last data block */
+		p = img.buf + img.meta - 1;
+		*p ^= 0x10;
+		errors += verity_run(&img, 1, VERITY_ERR_HASH, "data", path);
+		*p ^= 0x10;
+
+		/* in the leaf level, caught by the level above */
+		p = img.buf + img.leaves + 5;
+		*p ^= 0x01;
+		errors += verity_run(&img, 1, VERITY_ERR_HASH, "leaves", path);
+		*p ^= 0x01;
+
+		/* in the top level, caught by the root digest */
+		p = img.buf + img.tree;
+		*p ^= 0x80;
+		errors += verity_run(&img, 1, VERITY_ERR_HASH, "top", path);
+		*p ^= 0x80;
+
+		/* the superblock moves the metadata out of reach */
+		p = img.buf + 1024 + 0x38;
+		*p ^= 0xff;
+		errors += verity_run(&img, 1, VERITY_ERR_FORMAT, "superblock", path);
+		*p ^= 0xff;
+
+		verity_put_le32(img.buf + img.meta, VERITY_METADATA_MAGIC_DISABLE);
+		errors += verity_run(&img, 1, VERITY_ERR_DISABLED, "disabled", path);
+		verity_put_le32(img.buf + img.meta, VERITY_METADATA_MAGIC);
+
+		errors += verity_run(&img, 1, VERITY_ERR_UNSIGNED, "restored", path);
+		free(img.buf);
+	}
+
+	return errors;
+}
+
+/* random prefixes, lengths and counts against SHA256() on the joined message */
+static int verity_multi_check(const char *path, const unsigned char *buf)
+{
+	unsigned char md[9 * SHA256_DIGEST_LENGTH], ref[SHA256_DIGEST_LENGTH];
+	unsigned char *msg;
+	const unsigned char *in[9];
+	unsigned i, j, n, len, prefix_len;
+	int errors = 0;
+
+	msg = malloc(100 + 4200);
+	if (msg == NULL)
+		return 1;
+
+	for (i = 0; i < 64; i++) {
+		prefix_len = rand() % 100;
+		len = rand() % 4200;
+		n = 1 + rand() % countof(in);
+		for (j = 0; j < n; j++)
+			in[j] = buf + rand() % 65536;
+
+		SHA256_multi(buf, prefix_len, in, len, md, n);
+		for (j = 0; j < n; j++) {
+			memcpy(msg, buf, prefix_len);
+			memcpy(msg + prefix_len, in[j], len);
+			SHA256(msg, prefix_len + len, ref);
+			if (memcmp(ref, md + j * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH)) {
+				printf("verity: %s SHA256_multi mismatch, prefix %u length %u lane %u\n",
+					path, prefix_len, len, j);
+				errors++;
+			}
+		}
+	}
+
+	free(msg);
+	return errors;
+}
+
+static void verity_bench(const char *path, const unsigned char *buf, size_t size)
+{
+	const unsigned char *in[16];
+	unsigned char md[16 * SHA256_DIGEST_LENGTH];
+	bigtime_t t0, single_us, multi_us;
+	size_t off;
+	unsigned i;
+
+	t0 = current_time_hires();
+	for (off = 0; off < size; off += 4096)
+		SHA256(buf + off, 4096, md);
+	single_us = current_time_hires() - t0;
+
+	t0 = current_time_hires();
+	for (off = 0; off < size; off += 16 * 4096) {
+		for (i = 0; i < 16; i++)
+			in[i] = buf + off + i * 4096;
+		SHA256_multi(NULL, 0, in, 4096, md, 16);
+	}
+	multi_us = current_time_hires() - t0;
+
+	/* bytes per microsecond is MB/s */
+	printf("verity: %-8s 4KB blocks: single %4llu MB/s, multi %4llu MB/s\n", path,
+		single_us ? (unsigned long long)size / single_us : 0,
+		multi_us ? (unsigned long long)size / multi_us : 0);
+}
+
+int verity_tests(void)
+{
+	unsigned int saved = OPENSSL_armcap();
+	const size_t size = 4 * 1024 * 1024;
+	unsigned char *buf;
+	unsigned i;
+	int errors = 0;
+
+	buf = malloc(size);
+	if (buf == NULL) {
+		printf("verity: no memory\n");
+		return -1;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)(i * 167 + (i >> 11));
+
+	for (i = 0; i < countof(verity_paths); i++) {
+		const struct verity_path *p = &verity_paths[i];
+
+		if ((saved & p->caps) != p->caps) {
+			printf("verity: %-8s not supported\n", p->name);
+			continue;
+		}
+
+		OPENSSL_armcap_P = p->caps;
+		errors += verity_multi_check(p->name, buf);
+		errors += verity_kat_run(p->name);
+		verity_bench(p->name, buf, size);
+	}
+
+	OPENSSL_armcap_P = saved;
+	free(buf);
+
+	printf("verity: %d errors\n", errors);
+
+	return errors ? -1 : 0;
+}
+
+#endif
@@ -39,6 +39,12 @@ static inline uint32_t read_cpsr(void) {
 	return cpsr;
 }
 
+#if ARM_WITH_NEON
+/* set by arch_early_init() once the fpu is on, the string routines stay
+ * scalar until then */
+extern int arm_neon_enabled;
+#endif
+
 struct arm_iframe {
 	uint32_t spsr;
 	uint32_t r0;
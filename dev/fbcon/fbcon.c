@@ -36,6 +36,7 @@
 #include <platform.h>
 #include <string.h>
 #include <arch/ops.h>
+#include <lib/dma_memcpy.h>
 
 #include "font5x12.h"
 
@@ -490,9 +491,15 @@ void fbcon_putImage(struct fbimage *fbimg, bool flag)
 
 		image_base = ((((total_y/2) - (height / 2) ) *
 				(config->width)) + (total_x/2 - (width / 2)));
-		for (i = 0; i < height; i++) {
-			memcpy (config->base + ((image_base + (i * (config->width))) * bytes_per_bpp),
-				logo_base + (i * pitch * bytes_per_bpp), width * bytes_per_bpp);
+		/* full width rows are contiguous on both sides, copy them at once */
+		if (width == config->width && pitch == width) {
+			dma_memcpy (config->base + (image_base * bytes_per_bpp),
+				logo_base, height * width * bytes_per_bpp);
+		} else {
+			for (i = 0; i < height; i++) {
+				dma_memcpy (config->base + ((image_base + (i * (config->width))) * bytes_per_bpp),
+					logo_base + (i * pitch * bytes_per_bpp), width * bytes_per_bpp);
+			}
 		}
 		/* Flush the contents to memory before giving the data to dma */
 		arch_clean_invalidate_cache_range((addr_t) config->base, (total_x * total_y * bytes_per_bpp));
@@ -513,7 +520,7 @@ void fbcon_putImage(struct fbimage *fbimg, bool flag)
 
 		for (i = 0; i < header->width; i++)
 		{
-			memcpy (config->base +
+			dma_memcpy (config->base +
 				((image_base + (i * (config->width))) * bytes_per_bpp),
 				(fbimg->image + (i * header->height * bytes_per_bpp)),
 				(header->height * bytes_per_bpp));
@@ -31,37 +31,430 @@
 
 #include <bits.h>
 #include <debug.h>
+#include <err.h>
+#include <list.h>
 #include <string.h>
 #include <dev/keys.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/mutex.h>
+#include <kernel/dpc.h>
+#include <platform.h>
 
 static unsigned long key_bitmap[BITMAP_NUM_WORDS(MAX_KEYS)];
 
+/* event ring, filled from irq/timer context and drained by keys_wait_event() */
+static struct key_event key_queue[KEY_EVENT_QUEUE_LEN];
+static uint key_head;
+static uint key_tail;
+static uint key_dropped;
+
+static wait_queue_t key_wait = WAIT_QUEUE_INITIAL_VALUE(key_wait);
+static int key_waiters;
+/* keys_wake_waiters() found nobody blocked, the next wait returns at once */
+static bool key_wake_pending;
+
+/*
+ * Source read() callbacks may talk to the PMIC over SPMI, which has no
+ * locking of its own and can sleep, so they are only ever called from
+ * thread context with key_source_lock held. The poll and debounce timers
+ * just queue a dpc that does the reading.
+ */
+static struct list_node key_sources = LIST_INITIAL_VALUE(key_sources);
+static mutex_t key_source_lock;
+static bool key_sources_ready;
+static timer_t key_poll_timer;
+static struct dpc key_poll_dpc;
+static bool key_poll_running;
+static int key_polled_sources;
+
 void keys_init(void)
 {
+	enter_critical_section();
 	memset(key_bitmap, 0, sizeof(key_bitmap));
+	key_head = key_tail = 0;
+	exit_critical_section();
+}
+
+/* must be called in a critical section */
+static void keys_queue_event(uint16_t code, int16_t value)
+{
+	struct key_event *ev;
+
+	if (key_head - key_tail == KEY_EVENT_QUEUE_LEN) {
+		key_tail++;
+		key_dropped++;
+	}
+
+	ev = &key_queue[key_head % KEY_EVENT_QUEUE_LEN];
+	ev->code = code;
+	ev->value = value;
+	ev->time = current_time();
+	key_head++;
+
+	/* may be in interrupt context, the waiter runs on the next reschedule */
+	if (key_waiters)
+		wait_queue_wake_one(&key_wait, false, NO_ERROR);
 }
 
 void keys_post_event(uint16_t code, int16_t value)
 {
+	int changed;
+
 	if (code >= MAX_KEYS) {
 		dprintf(INFO, "Invalid keycode posted: %d\n", code);
 		return;
 	}
 
-	/* TODO: Implement an actual event queue if it becomes necessary */
+	enter_critical_section();
+
 	if (value)
-		bitmap_set(key_bitmap, code);
+		changed = !bitmap_set(key_bitmap, code);
 	else
-		bitmap_clear(key_bitmap, code);
+		changed = bitmap_clear(key_bitmap, code);
+
+	/* only edges are queued, a level re-posted by a scanner is not an event */
+	if (changed)
+		keys_queue_event(code, value ? 1 : 0);
+
+	exit_critical_section();
 
 //	dprintf(INFO, "key state change: %d %d\n", code, value);
 }
 
+static struct key_source *keys_find_source(uint16_t code)
+{
+	struct key_source *src;
+
+	list_for_every_entry(&key_sources, src, struct key_source, node) {
+		if (src->code == code)
+			return src;
+	}
+
+	return NULL;
+}
+
 int keys_get_state(uint16_t code)
 {
+	struct key_source *src;
+	int state;
+
 	if (code >= MAX_KEYS) {
 		dprintf(INFO, "Invalid keycode requested: %d\n", code);
 		return -1;
 	}
-	return bitmap_test(key_bitmap, code);
+
+	/* nobody is scanning a polled source right now, sample it directly */
+	if (key_sources_ready) {
+		mutex_acquire(&key_source_lock);
+		src = keys_find_source(code);
+		if (src && !src->use_irq && !key_poll_running) {
+			src->state = !!src->read();
+			src->pending = 0;
+
+			enter_critical_section();
+			if (src->state)
+				bitmap_set(key_bitmap, code);
+			else
+				bitmap_clear(key_bitmap, code);
+			exit_critical_section();
+		}
+		mutex_release(&key_source_lock);
+	}
+
+	enter_critical_section();
+	state = bitmap_test(key_bitmap, code);
+	exit_critical_section();
+
+	return state;
+}
+
+/*
+ * Polled sources report a new level once two consecutive scans agree on it,
+ * which is at least KEY_POLL_TIME of stability. Called with key_source_lock
+ * held.
+ */
+static void keys_sample_source(struct key_source *src)
+{
+	int level = !!src->read();
+
+	if (level == src->state) {
+		src->pending = 0;
+		return;
+	}
+
+	if (src->pending++ * KEY_POLL_TIME < KEY_DEBOUNCE_TIME)
+		return;
+
+	src->state = level;
+	src->pending = 0;
+	keys_post_event(src->code, level);
+}
+
+static void keys_poll_scan(void *arg)
+{
+	struct key_source *src;
+
+	mutex_acquire(&key_source_lock);
+	list_for_every_entry(&key_sources, src, struct key_source, node) {
+		if (!src->use_irq)
+			keys_sample_source(src);
+	}
+	mutex_release(&key_source_lock);
+}
+
+static enum handler_return keys_poll(struct timer *t, time_t now, void *arg)
+{
+	/* a scan still queued from the last tick covers this one */
+	dpc_queue_obj(&key_poll_dpc, DPC_FLAG_NORESCHED);
+
+	return INT_RESCHEDULE;
+}
+
+/* must be called in a critical section */
+static void keys_update_poll(void)
+{
+	bool want = key_waiters > 0 && key_polled_sources > 0;
+
+	if (want == key_poll_running)
+		return;
+
+	if (want)
+		timer_set_periodic(&key_poll_timer, KEY_POLL_TIME, keys_poll, NULL);
+	else
+		timer_cancel(&key_poll_timer);
+	key_poll_running = want;
+}
+
+static void keys_debounce_read(void *arg)
+{
+	struct key_source *src = arg;
+	int level;
+
+	mutex_acquire(&key_source_lock);
+
+	/* unregistered while the dpc was queued */
+	if (list_in_list(&src->node)) {
+		level = !!src->read();
+		if (level != src->state) {
+			src->state = level;
+			keys_post_event(src->code, level);
+		}
+	}
+
+	mutex_release(&key_source_lock);
+}
+
+static enum handler_return keys_debounce_done(struct timer *t, time_t now, void *arg)
+{
+	struct key_source *src = arg;
+
+	dpc_queue_obj(&src->debounce_dpc, DPC_FLAG_NORESCHED);
+
+	return INT_RESCHEDULE;
+}
+
+/**
+ * Edge interrupt handler hook for a key source registered with use_irq.
+ * Each edge restarts the debounce window; the level is sampled and reported
+ * once it has been quiet for KEY_DEBOUNCE_TIME.
+ */
+enum handler_return keys_source_irq(struct key_source *src)
+{
+	timer_cancel(&src->debounce);
+	timer_set_oneshot(&src->debounce, KEY_DEBOUNCE_TIME, keys_debounce_done, src);
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* sources are registered from threads, so this runs in thread context */
+static void keys_sources_init(void)
+{
+	if (key_sources_ready)
+		return;
+
+	mutex_init(&key_source_lock);
+	timer_initialize(&key_poll_timer);
+	dpc_initialize(&key_poll_dpc, keys_poll_scan, NULL);
+	key_sources_ready = true;
+}
+
+void keys_register_source(struct key_source *src, uint16_t code,
+		key_read_func read, bool use_irq)
+{
+	ASSERT(src && read && code < MAX_KEYS);
+
+	keys_sources_init();
+
+	src->code = code;
+	src->read = read;
+	src->use_irq = use_irq;
+	src->pending = 0;
+	timer_initialize(&src->debounce);
+	dpc_initialize(&src->debounce_dpc, keys_debounce_read, src);
+
+	mutex_acquire(&key_source_lock);
+
+	/* seed the current level without reporting it as an event */
+	src->state = !!read();
+
+	enter_critical_section();
+
+	if (src->state)
+		bitmap_set(key_bitmap, code);
+	else
+		bitmap_clear(key_bitmap, code);
+
+	list_add_tail(&key_sources, &src->node);
+	if (!use_irq) {
+		key_polled_sources++;
+		keys_update_poll();
+	}
+
+	exit_critical_section();
+
+	mutex_release(&key_source_lock);
+}
+
+void keys_unregister_source(struct key_source *src)
+{
+	mutex_acquire(&key_source_lock);
+	enter_critical_section();
+
+	list_delete(&src->node);
+	timer_cancel(&src->debounce);
+	if (!src->use_irq) {
+		key_polled_sources--;
+		keys_update_poll();
+	}
+
+	exit_critical_section();
+	mutex_release(&key_source_lock);
+}
+
+status_t keys_wait_event(struct key_event *ev, time_t timeout)
+{
+	status_t ret = NO_ERROR;
+	time_t deadline = current_time() + timeout;
+
+	enter_critical_section();
+
+	key_waiters++;
+	keys_update_poll();
+
+	while (key_head == key_tail) {
+		time_t left = INFINITE_TIME;
+
+		/* a wake that came before we got here is not lost */
+		if (key_wake_pending) {
+			key_wake_pending = false;
+			ret = ERR_NO_MSG;
+			break;
+		}
+
+		if (timeout != INFINITE_TIME) {
+			time_t now = current_time();
+
+			if (TIME_GTE(now, deadline)) {
+				ret = ERR_TIMED_OUT;
+				break;
+			}
+			left = deadline - now;
+		}
+
+		ret = wait_queue_block(&key_wait, left);
+		if (ret < 0)
+			break;
+	}
+
+	if (key_head != key_tail) {
+		*ev = key_queue[key_tail % KEY_EVENT_QUEUE_LEN];
+		key_tail++;
+		ret = NO_ERROR;
+	}
+
+	key_waiters--;
+	keys_update_poll();
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/*
+ * Kick every thread out of keys_wait_event() with ERR_NO_MSG. With nobody
+ * blocked the wake is kept for the next keys_wait_event(), which may be
+ * about to block after having checked whatever it is being woken for.
+ */
+void keys_wake_waiters(void)
+{
+	enter_critical_section();
+	if (wait_queue_wake_all(&key_wait, true, ERR_NO_MSG) == 0)
+		key_wake_pending = true;
+	exit_critical_section();
+}
+
+void keys_flush_events(void)
+{
+	enter_critical_section();
+	key_tail = key_head;
+	exit_critical_section();
+}
+
+#if WITH_LIB_CONSOLE
+
+#include <stdlib.h>
+#include <lib/console.h>
+
+static int cmd_keys(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("keys", "key event queue: inject, wait, state", &cmd_keys)
+STATIC_COMMAND_END(keys);
+
+static int cmd_keys(int argc, const cmd_args *argv)
+{
+	struct key_event ev;
+	status_t ret;
+
+	if (argc < 2) {
+usage:
+		printf("usage:\n");
+		printf("\t%s inject <code> <0|1>\n", argv[0].str);
+		printf("\t%s press <code>\n", argv[0].str);
+		printf("\t%s wait [timeout ms]\n", argv[0].str);
+		printf("\t%s state <code>\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "inject")) {
+		if (argc < 4)
+			goto usage;
+		keys_post_event(argv[2].u, argv[3].u ? 1 : 0);
+	} else if (!strcmp(argv[1].str, "press")) {
+		if (argc < 3)
+			goto usage;
+		keys_post_event(argv[2].u, 1);
+		keys_post_event(argv[2].u, 0);
+	} else if (!strcmp(argv[1].str, "wait")) {
+		ret = keys_wait_event(&ev, argc > 2 ? (time_t)argv[2].u : INFINITE_TIME);
+		if (ret < 0) {
+			printf("no event (%d)\n", ret);
+			return ret;
+		}
+		printf("key 0x%x %s at %u ms\n", ev.code,
+			ev.value ? "pressed" : "released", ev.time);
+	} else if (!strcmp(argv[1].str, "state")) {
+		if (argc < 3)
+			goto usage;
+		printf("key 0x%x: %d\n", argv[2].u, keys_get_state(argv[2].u));
+	} else {
+		goto usage;
+	}
+
+	printf("queued %u, dropped %u\n", key_head - key_tail, key_dropped);
+
+	return 0;
 }
+
+#endif
@@ -56,6 +56,8 @@ void arch_invalidate_cache_range(addr_t start, size_t len);
 void arch_sync_cache_range(addr_t start, size_t len);
 void cache_clean_invalidate_unaligned_start_addr(addr_t start, size_t size);
 	
+/* called with interrupts disabled, returns when one is pending (or at
+ * once, on cpus that cannot wait for one with them masked) */
 void arch_idle(void);
 
 void arch_disable_mmu(void);
@@ -33,6 +33,9 @@
 #define __DEV_KEYS_H
 
 #include <sys/types.h>
+#include <list.h>
+#include <kernel/timer.h>
+#include <kernel/dpc.h>
 
 /* these are just the ascii values for the chars */
 #define KEY_0		0x30
@@ -81,11 +84,61 @@
 #define KEY_HOME	0x122
 #define KEY_BACK	0x123
 #define KEY_MENU	0x124
+#define KEY_POWER	0x125
 
 #define MAX_KEYS	0x1ff
 
+/* pending events kept for keys_wait_event(); the oldest are dropped on overflow */
+#define KEY_EVENT_QUEUE_LEN	32
+
+/* a level change must be stable this long before it is reported */
+#define KEY_DEBOUNCE_TIME	20	/* ms */
+
+/* scan period for sources without an interrupt, only while someone waits */
+#define KEY_POLL_TIME		20	/* ms */
+
+struct key_event {
+	uint16_t code;
+	int16_t value;		/* 1 pressed, 0 released */
+	time_t time;
+};
+
+typedef int (*key_read_func)(void);
+
+/*
+ * A single key whose level can be sampled with read(). Sources that can
+ * raise an interrupt on either edge call keys_source_irq() from their
+ * handler; the rest are scanned by a shared timer while a thread is
+ * blocked in keys_wait_event(). read() is always called from a thread,
+ * never from interrupt context.
+ */
+struct key_source {
+	struct list_node node;
+	uint16_t code;
+	key_read_func read;
+	bool use_irq;
+	int state;
+	int pending;
+	timer_t debounce;
+	struct dpc debounce_dpc;
+};
+
 void keys_init(void);
 void keys_post_event(uint16_t code, int16_t value);
 int keys_get_state(uint16_t code);
 
+void keys_register_source(struct key_source *src, uint16_t code,
+		key_read_func read, bool use_irq);
+void keys_unregister_source(struct key_source *src);
+enum handler_return keys_source_irq(struct key_source *src);
+
+/*
+ * Block until a key event is queued or timeout ms pass. Returns NO_ERROR
+ * with *ev filled in, ERR_TIMED_OUT, or ERR_NO_MSG if keys_wake_waiters()
+ * was called, including while no thread was waiting.
+ */
+status_t keys_wait_event(struct key_event *ev, time_t timeout);
+void keys_wake_waiters(void);
+void keys_flush_events(void);
+
 #endif /* __DEV_KEYS_H */
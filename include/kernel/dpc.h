@@ -30,9 +30,41 @@ void dpc_init(void);
 
 typedef void (*dpc_callback)(void *arg);
 
-#define DPC_FLAG_NORESCHED 0x1
+/*
+ * A deferred procedure call. Callers that queue the same work repeatedly,
+ * such as completion handlers, embed one of these and queue it with
+ * dpc_queue_obj(); nothing is allocated. A dpc may be queued again
+ * from its own callback.
+ */
+struct dpc {
+	struct list_node node;
+
+	dpc_callback cb;
+	void *arg;
+
+	uint flags;
+	bigtime_t queue_time;
+};
+
+#define DPC_FLAG_NORESCHED	0x1	/* do not reschedule after queuing */
+#define DPC_FLAG_HIGH		0x2	/* run ahead of normal priority dpcs */
 
+/* internal state, kept in struct dpc flags */
+#define DPC_STATE_QUEUED	0x100
+#define DPC_STATE_POOLED	0x200
+
+/* entries available to dpc_queue() */
+#ifndef DPC_POOL_SIZE
+#define DPC_POOL_SIZE 32
+#endif
+
+void dpc_initialize(struct dpc *dpc, dpc_callback cb, void *arg);
+status_t dpc_queue_obj(struct dpc *dpc, uint flags);
+
+/* one-off call, backed by a fixed pool; ERR_NO_MEMORY when it runs dry */
 status_t dpc_queue(dpc_callback, void *arg, uint flags);
 
+void dpc_dump_stats(void);
+
 #endif
 
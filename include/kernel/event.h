@@ -56,6 +56,7 @@ void event_init(event_t *, bool initial, uint flags);
 void event_destroy(event_t *);
 status_t event_wait(event_t *);
 status_t event_wait_timeout(event_t *, time_t); /* wait on the event with a timeout */
+status_t event_wait_timeout_us(event_t *, bigtime_t); /* same, timeout in us */
 status_t event_signal(event_t *, bool reschedule);
 status_t event_unsignal(event_t *);
 #define event_initialized(e)	((e)->magic == EVENT_MAGIC)
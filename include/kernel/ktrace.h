@@ -0,0 +1,86 @@
+/*
+ * Kernel event trace
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_KTRACE_H
+#define __KERNEL_KTRACE_H
+
+#include <sys/types.h>
+#include <compiler.h>
+
+/*
+ * Set KERNEL_TRACE=1 in a project's DEFINES to build the trace ring in.
+ * Without it every KTRACE() site compiles away.
+ */
+#ifndef KERNEL_TRACE
+#define KERNEL_TRACE 0
+#endif
+
+/* number of records kept, must be a power of 2 */
+#ifndef KTRACE_ENTRIES
+#define KTRACE_ENTRIES 1024
+#endif
+
+enum ktrace_event {
+	KTRACE_CTXSW = 1,	/* a = old thread, b = new thread */
+	KTRACE_WAIT_BLOCK,	/* a = wait queue, b = timeout in us */
+	KTRACE_WAIT_WAKE,	/* a = wait queue, b = woken thread */
+	KTRACE_TIMER_FIRE,	/* a = timer, b = callback */
+	KTRACE_TIMER_DONE,	/* a = timer, b = handler return */
+	KTRACE_IRQ_ENTER,	/* a = vector */
+	KTRACE_IRQ_EXIT,	/* a = vector, b = handler return */
+	KTRACE_DPC_RUN,		/* a = callback, b = arg */
+	KTRACE_DPC_DONE,	/* a = callback */
+};
+
+struct ktrace_rec {
+	uint32_t ts;		/* current_time_hires(), truncated */
+	uint32_t event;
+	uint32_t a;
+	uint32_t b;
+};
+
+#if KERNEL_TRACE
+
+extern volatile int ktrace_enabled;
+
+void ktrace_record(uint32_t event, uint32_t a, uint32_t b);
+void ktrace_start(void);
+void ktrace_stop(void);
+void ktrace_clear(void);
+void ktrace_dump(void);
+
+/* provided by the thread code */
+void ktrace_dump_threads(void);
+
+#define KTRACE(ev, a, b) \
+	do { \
+		if (unlikely(ktrace_enabled)) \
+			ktrace_record((ev), (uint32_t)(a), (uint32_t)(b)); \
+	} while (0)
+
+#else
+
+#define KTRACE(ev, a, b) do { } while (0)
+
+#endif
+
+#endif
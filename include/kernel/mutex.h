@@ -32,8 +32,14 @@ typedef struct mutex {
 	int count;
 	thread_t *holder;
 	wait_queue_t wait;
+	uint contended;
 } mutex_t;
 
+/* number of times a contended acquire yields to a preempted holder before
+ * falling back to blocking on the wait queue
+ */
+#define MUTEX_SPIN_YIELDS 4
+
 /* Rules for Mutexes:
  * - Mutexes are only safe to use from thread context.
  * - Mutexes are non-recursive.
@@ -45,5 +51,21 @@ status_t mutex_acquire(mutex_t *);
 status_t mutex_acquire_timeout(mutex_t *, time_t); /* try to acquire the mutex with a timeout value */
 status_t mutex_release(mutex_t *);
 
+/* global lock contention counters, shared by mutexes and rwlocks */
+struct lock_stats {
+	uint mutex_acquires;
+	uint mutex_contended;
+	uint mutex_spin_acquired;
+	uint mutex_blocked;
+	uint rwlock_read_acquires;
+	uint rwlock_read_blocked;
+	uint rwlock_write_acquires;
+	uint rwlock_write_blocked;
+};
+
+extern struct lock_stats lock_stats;
+
+void lock_dump_stats(void);
+
 #endif
 
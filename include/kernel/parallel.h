@@ -0,0 +1,73 @@
+/*
+ * Parallel loops and task groups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_PARALLEL_H
+#define __KERNEL_PARALLEL_H
+
+#include <sys/types.h>
+#include <kernel/event.h>
+
+/*
+ * Boot-time compute helpers on a pool of PARALLEL_WORKERS kernel threads,
+ * each with its own work-stealing deque. The pool is started on first
+ * use. Callers help with the work while they wait, and with
+ * PARALLEL_WORKERS set to 0 everything runs inline on the caller.
+ *
+ * The kernel is uniprocessor, so the workers share one CPU: pieces that
+ * block, e.g. on storage reads, overlap, pure computation does not get
+ * any faster.
+ */
+#ifndef PARALLEL_WORKERS
+#define PARALLEL_WORKERS 2
+#endif
+
+/* process the half-open index range [start, end) */
+typedef void (*parallel_fn)(void *arg, size_t start, size_t end);
+
+/*
+ * Run fn over [start, end) in pieces of at most chunk indices, spread over
+ * the pool and the caller. Returns once every piece is done.
+ */
+void parallel_for(size_t start, size_t end, size_t chunk,
+		parallel_fn fn, void *arg);
+
+/* Independent tasks queued together and waited for as a unit. */
+typedef void (*task_fn)(void *arg);
+
+struct task_group {
+	volatile uint pending;
+	event_t done;
+};
+
+void task_group_init(struct task_group *group);
+void task_group_run(struct task_group *group, task_fn fn, void *arg);
+void task_group_wait(struct task_group *group);
+
+struct parallel_stats {
+	uint tasks;	/* pieces and tasks run */
+	uint steals;	/* taken from another thread's deque */
+	uint inline_runs;	/* run by the submitter because a deque was full */
+};
+
+void parallel_get_stats(struct parallel_stats *stats);
+
+#endif
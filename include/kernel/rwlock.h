@@ -0,0 +1,54 @@
+/*
+ * Reader/writer locks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_RWLOCK_H
+#define __KERNEL_RWLOCK_H
+
+#include <kernel/thread.h>
+
+#define RWLOCK_MAGIC 'rwlk'
+
+typedef struct rwlock {
+	int magic;
+	int readers;			/* threads currently holding the lock shared */
+	int writers_waiting;
+	thread_t *writer;		/* exclusive holder, if any */
+	wait_queue_t read_wait;
+	wait_queue_t write_wait;
+	uint contended;
+} rwlock_t;
+
+/* Rules for rwlocks:
+ * - Only safe to use from thread context.
+ * - Not recursive, and a reader may not upgrade to a writer.
+ * - Writers are preferred: once a writer is waiting, new readers block
+ *   behind it so a steady stream of readers cannot starve it.
+ */
+
+void rwlock_init(rwlock_t *);
+void rwlock_destroy(rwlock_t *);
+status_t rwlock_acquire_read(rwlock_t *);
+status_t rwlock_release_read(rwlock_t *);
+status_t rwlock_acquire_write(rwlock_t *);
+status_t rwlock_release_write(rwlock_t *);
+
+#endif
@@ -26,8 +26,10 @@
 #include <sys/types.h>
 #include <list.h>
 #include <compiler.h>
+#include <debug.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <kernel/dpc.h>
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -47,6 +49,25 @@ enum thread_tls_list {
 
 #define THREAD_MAGIC 'thrd'
 
+/* thread level statistics */
+#if DEBUGLEVEL > INFO
+#define THREAD_STATS 1
+#else
+#define THREAD_STATS 0
+#endif
+
+#if THREAD_STATS
+/* per thread cpu accounting, in us of current_time_hires() */
+struct thread_acct {
+	bigtime_t run_time;	/* total time running */
+	bigtime_t wait_time;	/* total time ready but not running */
+	bigtime_t max_latency;	/* longest wait from ready to running */
+	bigtime_t last_change;	/* when it last started running or became ready */
+	uint switches;		/* times switched in */
+	uint preemptions;	/* times preempted rather than yielding or blocking */
+};
+#endif
+
 typedef struct thread {
 	int magic;
 	struct list_node thread_list_node;
@@ -76,6 +97,13 @@ typedef struct thread {
 	/* return code */
 	int retcode;
 
+	/* frees the thread once it has exited */
+	struct dpc cleanup_dpc;
+
+#if THREAD_STATS
+	struct thread_acct acct;
+#endif
+
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
@@ -105,6 +133,9 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 status_t thread_resume(thread_t *);
 void thread_exit(int retcode) __NO_RETURN;
 void thread_sleep(time_t delay);
+void thread_sleep_us(bigtime_t delay);
+
+size_t thread_stack_used(thread_t *t);
 
 void dump_thread(thread_t *t);
 void dump_all_threads(void);
@@ -175,6 +206,13 @@ typedef struct wait_queue {
 	int count;
 } wait_queue_t;
 
+#define WAIT_QUEUE_INITIAL_VALUE(q) \
+{ \
+	.magic = WAIT_QUEUE_MAGIC, \
+	.list = LIST_INITIAL_VALUE((q).list), \
+	.count = 0 \
+}
+
 /* wait queue primitive */
 /* NOTE: must be inside critical section when using these */
 void wait_queue_init(wait_queue_t *);
@@ -193,6 +231,7 @@ void wait_queue_destroy(wait_queue_t *, bool reschedule);
  * and return ERR_TIMED_OUT. a timeout of 0 will immediately return.
  */
 status_t wait_queue_block(wait_queue_t *, time_t timeout);
+status_t wait_queue_block_us(wait_queue_t *, bigtime_t timeout);
 
 /* 
  * release one or more threads from the wait queue.
@@ -208,12 +247,6 @@ int wait_queue_wake_all(wait_queue_t *, bool reschedule, status_t wait_queue_err
  */
 status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t wait_queue_error);
 
-/* thread level statistics */
-#if DEBUGLEVEL > INFO
-#define THREAD_STATS 1
-#else
-#define THREAD_STATS 0
-#endif
 #if THREAD_STATS
 struct thread_stats {
 	bigtime_t idle_time;
@@ -229,6 +262,19 @@ struct thread_stats {
 
 extern struct thread_stats thread_stats;
 
+/* snapshot of one thread's accounting, see thread_get_usage() */
+struct thread_usage {
+	char name[32];
+	int priority;
+	enum thread_state state;
+	struct thread_acct acct;
+	size_t stack_size;
+	size_t stack_used;
+};
+
+uint thread_get_usage(struct thread_usage *usage, uint max);
+void dump_all_thread_usage(void);
+
 #endif
 
 #endif
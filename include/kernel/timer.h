@@ -35,10 +35,15 @@ typedef enum handler_return (*timer_callback)(struct timer *, time_t now, void *
 
 typedef struct timer {
 	int magic;
-	struct list_node node;
 
-	time_t scheduled_time;
-	time_t periodic_time;
+	/* pairing heap links, owned by the timer code */
+	struct timer *heap_child;
+	struct timer *heap_next;
+	struct timer *heap_prev;	/* left sibling, or parent if first child */
+	uint32_t heap_seq;		/* arming order, breaks deadline ties */
+
+	bigtime_t scheduled_time;	/* deadline, in us of current_time_hires() */
+	bigtime_t periodic_time;	/* period in us, 0 for one-shot */
 
 	timer_callback callback;
 	void *arg;
@@ -48,10 +53,12 @@ typedef struct timer {
  * - Timer callbacks occur from interrupt context
  * - Timers may be programmed or canceled from interrupt or thread context
  * - Timers may be canceled or reprogrammed from within their callback
- * - Timers currently are dispatched from a 10ms periodic tick
+ * - Timers are dispatched from a one-shot interrupt at the earliest deadline
+ *   on PLATFORM_HAS_DYNAMIC_TIMER platforms, otherwise from a 10ms periodic tick
 */
 void timer_initialize(timer_t *);
 void timer_set_oneshot(timer_t *, time_t delay, timer_callback, void *arg);
+void timer_set_oneshot_us(timer_t *, bigtime_t delay, timer_callback, void *arg);
 void timer_set_periodic(timer_t *, time_t period, timer_callback, void *arg);
 void timer_cancel(timer_t *);
 
@@ -0,0 +1,63 @@
+/*
+ * Boot time profiler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_BOOTPROF_H
+#define __LIB_BOOTPROF_H
+
+#include <sys/types.h>
+
+#define BOOTPROF_MAX_SPANS	48
+
+/*
+ * A named interval of boot time in microseconds from current_time_hires().
+ * end is zero while the span is still open; marks have start == end.
+ */
+struct bootprof_span {
+	const char *name;
+	bigtime_t start;
+	bigtime_t end;
+	uint8_t depth;
+};
+
+#if WITH_LIB_BOOTPROF
+
+int bootprof_begin(const char *name);
+void bootprof_end(int id);
+void bootprof_mark(const char *name);
+
+unsigned int bootprof_count(void);
+const struct bootprof_span *bootprof_get(unsigned int idx);
+void bootprof_dump(void);
+
+#else
+
+static inline int bootprof_begin(const char *name) { return -1; }
+static inline void bootprof_end(int id) { }
+static inline void bootprof_mark(const char *name) { }
+
+static inline unsigned int bootprof_count(void) { return 0; }
+static inline const struct bootprof_span *bootprof_get(unsigned int idx) { return NULL; }
+static inline void bootprof_dump(void) { }
+
+#endif
+
+#endif
@@ -27,16 +27,40 @@
 #include <kernel/event.h>
 
 typedef struct cbuf {
-	uint head; 
-	uint tail;
+	volatile uint head;	/* next byte written, owned by the producer */
+	volatile uint tail;	/* next byte read, owned by the consumer */
 	uint len_pow2;
+	uint flags;
+	volatile bool waiting;	/* a reader is blocked on the event */
 	char *buf;
 	event_t event;
 } cbuf_t;
 
+/*
+ * Exactly one writer and one reader, e.g. a uart rx interrupt and the
+ * console thread. Reads and writes then run without masking interrupts;
+ * the indices are published with memory barriers instead.
+ */
+#define CBUF_FLAG_SPSC	0x1
+
+/* a contiguous piece of the buffer, a span may wrap into two */
+typedef struct cbuf_vec {
+	char *buf;
+	size_t len;
+} cbuf_vec_t;
+
 void cbuf_initialize(cbuf_t *cbuf, size_t len);
+void cbuf_initialize_etc(cbuf_t *cbuf, size_t len, uint flags);
 size_t cbuf_read(cbuf_t *cbuf, void *_buf, size_t buflen, bool block);
 size_t cbuf_write(cbuf_t *cbuf, const void *_buf, size_t len, bool canreschedule);
 
+/* zero copy reading: look at what is buffered, then consume part of it */
+size_t cbuf_peek(cbuf_t *cbuf, cbuf_vec_t vec[2]);
+void cbuf_commit(cbuf_t *cbuf, size_t len);
+
+/* zero copy writing: fill the free space in place, then publish it */
+size_t cbuf_reserve(cbuf_t *cbuf, cbuf_vec_t vec[2]);
+void cbuf_publish(cbuf_t *cbuf, size_t len, bool canreschedule);
+
 #endif
 
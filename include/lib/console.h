@@ -50,6 +50,7 @@ typedef struct _cmd_block {
 
 /* register a static block of commands at init time */
 #define STATIC_COMMAND_START static const cmd _cmd_list[] = {
+#define STATIC_COMMAND(command_str, help_str, func) { command_str, help_str, func },
 #define STATIC_COMMAND_END(name) }; const cmd_block _cmd_block_##name __SECTION(".commands")= { NULL, sizeof(_cmd_list) / sizeof(_cmd_list[0]), _cmd_list }
 
 /* external api */
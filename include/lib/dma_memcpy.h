@@ -0,0 +1,79 @@
+/*
+ * Memory to memory copies through a DMA engine
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_DMA_MEMCPY_H
+#define __LIB_DMA_MEMCPY_H
+
+#include <sys/types.h>
+
+/*
+ * Copies shorter than this stay on the cpu: below it the cache maintenance
+ * and engine setup cost more than the copy itself.
+ */
+#ifndef DMA_MEMCPY_MIN_LEN
+#define DMA_MEMCPY_MIN_LEN	(64 * 1024)
+#endif
+
+struct dma_memcpy_engine {
+	const char *name;
+	/* source and destination alignment the engine needs, a power of two */
+	uint32_t align;
+	/* longest copy per call, 0 for no limit */
+	size_t max_len;
+	/*
+	 * Copy len bytes between physical addresses and wait for the copy to
+	 * finish. The ranges never overlap. Returns 0 on success.
+	 */
+	int (*copy)(addr_t dst, addr_t src, size_t len);
+};
+
+struct dma_memcpy_stats {
+	uint32_t dma_copies;
+	uint32_t cpu_copies;
+	uint32_t errors;
+	uint64_t dma_bytes;
+	uint64_t cpu_bytes;
+};
+
+/* the ADM data mover, msm_shared/adm_memcpy.c, built with ENABLE_ADM_MEMCPY */
+extern const struct dma_memcpy_engine adm_dma_memcpy_engine;
+
+/* a software model of an engine, for qemu and bring up */
+extern const struct dma_memcpy_engine dma_memcpy_sw_engine;
+
+/* NULL sends every copy to the cpu */
+void dma_memcpy_set_engine(const struct dma_memcpy_engine *engine);
+const struct dma_memcpy_engine *dma_memcpy_get_engine(void);
+
+/*
+ * Drop-in replacements for memcpy() and memmove(). The cache line aligned
+ * middle of a large copy goes to the engine, the ends and anything small,
+ * overlapping or unsuitably aligned are copied by the cpu. Caches are
+ * maintained here, callers need not flush either range.
+ */
+void *dma_memcpy(void *dst, const void *src, size_t len);
+void *dma_memmove(void *dst, const void *src, size_t len);
+
+void dma_memcpy_get_stats(struct dma_memcpy_stats *stats);
+void dma_memcpy_reset_stats(void);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Growable string buffer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_STRBUF_H
+#define __LIB_STRBUF_H
+
+#include <sys/types.h>
+
+/*
+ * A NUL terminated string that tracks its own length and capacity, so
+ * appending never rescans what is already there. Capacity grows
+ * geometrically; callers that know the final size up front can pass it
+ * to strbuf_init() and never reallocate.
+ */
+typedef struct strbuf {
+	char *buf;
+	size_t len;
+	size_t cap;
+} strbuf_t;
+
+int strbuf_init(strbuf_t *sb, size_t hint);
+int strbuf_reserve(strbuf_t *sb, size_t extra);
+int strbuf_append_len(strbuf_t *sb, const char *str, size_t len);
+int strbuf_append(strbuf_t *sb, const char *str);
+int strbuf_append_buf(strbuf_t *sb, const strbuf_t *src);
+void strbuf_reset(strbuf_t *sb);
+char *strbuf_detach(strbuf_t *sb, size_t *len);
+void strbuf_free(strbuf_t *sb);
+
+/* Append a string literal or char array without calling strlen */
+#define strbuf_append_lit(sb, lit) \
+	strbuf_append_len((sb), (lit), sizeof(lit) - 1)
+
+#endif
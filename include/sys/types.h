@@ -59,6 +59,7 @@ typedef int kobj_id;
 typedef unsigned long time_t;
 typedef unsigned long long bigtime_t;
 #define INFINITE_TIME ULONG_MAX
+#define INFINITE_TIME_US ULLONG_MAX
 
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
 
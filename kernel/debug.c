@@ -32,8 +32,12 @@
  */
 
 #include <debug.h>
+#include <string.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/ktrace.h>
+#include <kernel/dpc.h>
+#include <kernel/mutex.h>
 #include <platform.h>
 
 #if WITH_LIB_CONSOLE
@@ -42,20 +46,35 @@
 static int cmd_threads(int argc, const cmd_args *argv);
 static int cmd_threadstats(int argc, const cmd_args *argv);
 static int cmd_threadload(int argc, const cmd_args *argv);
+static int cmd_trace(int argc, const cmd_args *argv);
+static int cmd_dpcstats(int argc, const cmd_args *argv);
+static int cmd_lockstats(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > INFO
-STATIC_COMMAND("threads", "list kernel threads", &cmd_threads)
+STATIC_COMMAND("threads", "list kernel threads, -t for cpu usage", &cmd_threads)
 #endif
 #if THREAD_STATS
 STATIC_COMMAND("threadstats", "thread level statistics", &cmd_threadstats)
 STATIC_COMMAND("threadload", "toggle thread load display", &cmd_threadload)
 #endif
+STATIC_COMMAND("dpcstats", "dpc queue statistics and latency", &cmd_dpcstats)
+STATIC_COMMAND("lockstats", "mutex and rwlock contention counters", &cmd_lockstats)
+#if KERNEL_TRACE
+STATIC_COMMAND("trace", "kernel event trace", &cmd_trace)
+#endif
 STATIC_COMMAND_END(kernel);
 
 #if DEBUGLEVEL > INFO
 static int cmd_threads(int argc, const cmd_args *argv)
 {
+#if THREAD_STATS
+	if (argc > 1 && !strcmp(argv[1].str, "-t")) {
+		dump_all_thread_usage();
+		return 0;
+	}
+#endif
+
 	printf("thread list:\n");
 	dump_all_threads();
 
@@ -130,5 +149,46 @@ static int cmd_threadload(int argc, const cmd_args *argv)
 
 #endif
 
+static int cmd_dpcstats(int argc, const cmd_args *argv)
+{
+	dpc_dump_stats();
+
+	return 0;
+}
+
+static int cmd_lockstats(int argc, const cmd_args *argv)
+{
+	lock_dump_stats();
+
+	return 0;
+}
+
+#if KERNEL_TRACE
+static int cmd_trace(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+usage:
+		printf("usage: %s start|stop|clear|dump\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "start")) {
+		ktrace_start();
+	} else if (!strcmp(argv[1].str, "stop")) {
+		ktrace_stop();
+	} else if (!strcmp(argv[1].str, "clear")) {
+		ktrace_clear();
+	} else if (!strcmp(argv[1].str, "dump")) {
+		/* stop first so the dump is a consistent snapshot */
+		ktrace_stop();
+		ktrace_dump();
+	} else {
+		goto usage;
+	}
+
+	return 0;
+}
+#endif
+
 #endif
 
@@ -20,69 +20,227 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+/**
+ * @file
+ * @brief  Deferred procedure calls
+ *
+ * Work queued from interrupt handlers or threads that must not block is
+ * run later by the dpc thread. Queue entries are either embedded in the
+ * caller's own objects or taken from a small static pool, so queuing
+ * never touches the heap and is safe from interrupt context.
+ *
+ * There are two lanes; DPC_FLAG_HIGH entries run before normal ones.
+ */
 #include <debug.h>
 #include <list.h>
-#include <malloc.h>
 #include <err.h>
+#include <platform.h>
 #include <kernel/dpc.h>
 #include <kernel/thread.h>
 #include <kernel/event.h>
+#include <kernel/ktrace.h>
 
-struct dpc {
-	struct list_node node;	
-
-	dpc_callback cb;
-	void *arg;
+enum {
+	DPC_LANE_HIGH,
+	DPC_LANE_NORMAL,
+	DPC_LANES
 };
 
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
+/* queue to run latency, bucket n counts [2^(n-1), 2^n) us */
+#define DPC_LATENCY_BUCKETS 16
+
+static struct list_node dpc_list[DPC_LANES] = {
+	LIST_INITIAL_VALUE(dpc_list[DPC_LANE_HIGH]),
+	LIST_INITIAL_VALUE(dpc_list[DPC_LANE_NORMAL]),
+};
 static event_t dpc_event;
 
+static struct dpc dpc_pool[DPC_POOL_SIZE];
+static struct list_node dpc_free_list = LIST_INITIAL_VALUE(dpc_free_list);
+static uint dpc_free_count;
+
+static struct {
+	uint queued;
+	uint pool_exhausted;
+	uint pool_low_water;
+	uint latency[DPC_LATENCY_BUCKETS];
+	bigtime_t max_latency;
+} dpc_stats;
+
 static int dpc_thread_routine(void *arg);
 
 void dpc_init(void)
 {
+	uint i;
+
+	for (i = 0; i < DPC_POOL_SIZE; i++) {
+		dpc_initialize(&dpc_pool[i], NULL, NULL);
+		list_add_tail(&dpc_free_list, &dpc_pool[i].node);
+	}
+	dpc_free_count = DPC_POOL_SIZE;
+	dpc_stats.pool_low_water = DPC_POOL_SIZE;
+
 	event_init(&dpc_event, false, 0);
 
 	thread_resume(thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE));
 }
 
+/**
+ * @brief  Prepare a caller owned dpc for dpc_queue_obj()
+ */
+void dpc_initialize(struct dpc *dpc, dpc_callback cb, void *arg)
+{
+	list_clear_node(&dpc->node);
+	dpc->cb = cb;
+	dpc->arg = arg;
+	dpc->flags = 0;
+	dpc->queue_time = 0;
+}
+
+/**
+ * @brief  Queue a caller owned dpc
+ *
+ * @return NO_ERROR, or ERR_ALREADY_STARTED if it is still pending, in
+ * which case the pending run covers this request too.
+ */
+status_t dpc_queue_obj(struct dpc *dpc, uint flags)
+{
+	enter_critical_section();
+
+	if (dpc->flags & DPC_STATE_QUEUED) {
+		exit_critical_section();
+		return ERR_ALREADY_STARTED;
+	}
+
+	dpc->flags = (dpc->flags & DPC_STATE_POOLED) | DPC_STATE_QUEUED |
+		(flags & DPC_FLAG_HIGH);
+	dpc->queue_time = current_time_hires();
+	list_add_tail(&dpc_list[(flags & DPC_FLAG_HIGH) ? DPC_LANE_HIGH : DPC_LANE_NORMAL],
+		&dpc->node);
+	dpc_stats.queued++;
+
+	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
 status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 {
 	struct dpc *dpc;
+	status_t err;
 
-	dpc = malloc(sizeof(struct dpc));
+	enter_critical_section();
+
+	dpc = list_remove_head_type(&dpc_free_list, struct dpc, node);
+	if (!dpc) {
+		dpc_stats.pool_exhausted++;
+		exit_critical_section();
+		dprintf(CRITICAL, "dpc: pool exhausted, dropping %p\n", cb);
+		return ERR_NO_MEMORY;
+	}
+
+	if (--dpc_free_count < dpc_stats.pool_low_water)
+		dpc_stats.pool_low_water = dpc_free_count;
 
 	dpc->cb = cb;
 	dpc->arg = arg;
-	enter_critical_section();
-	list_add_tail(&dpc_list, &dpc->node);
-	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+	dpc->flags = DPC_STATE_POOLED;
+	err = dpc_queue_obj(dpc, flags);
+
 	exit_critical_section();
 
-	return NO_ERROR;
+	return err;
+}
+
+static void dpc_record_latency(bigtime_t latency)
+{
+	uint bucket = 0;
+
+	while (latency && bucket < DPC_LATENCY_BUCKETS - 1) {
+		latency >>= 1;
+		bucket++;
+	}
+
+	dpc_stats.latency[bucket]++;
+}
+
+static struct dpc *dpc_dequeue(void)
+{
+	struct dpc *dpc;
+	uint lane;
+
+	for (lane = 0; lane < DPC_LANES; lane++) {
+		dpc = list_remove_head_type(&dpc_list[lane], struct dpc, node);
+		if (dpc)
+			return dpc;
+	}
+
+	return NULL;
 }
 
 static int dpc_thread_routine(void *arg)
 {
+	struct dpc *dpc;
+	dpc_callback cb;
+	void *cb_arg;
+	bigtime_t latency;
+
 	for (;;) {
 		event_wait(&dpc_event);
 
 		enter_critical_section();
-		struct dpc *dpc = list_remove_head_type(&dpc_list, struct dpc, node);
-		if (!dpc)
+		dpc = dpc_dequeue();
+		if (!dpc) {
 			event_unsignal(&dpc_event);
-		exit_critical_section();
-
-		if (dpc) {
-//			dprintf("dpc calling %p, arg %p\n", dpc->cb, dpc->arg);
-			dpc->cb(dpc->arg);
+			exit_critical_section();
+			continue;
+		}
 
-			free(dpc);
+		/* the callback may free or requeue the dpc, don't touch it after */
+		cb = dpc->cb;
+		cb_arg = dpc->arg;
+		dpc->flags &= ~DPC_STATE_QUEUED;
+		if (dpc->flags & DPC_STATE_POOLED) {
+			list_add_tail(&dpc_free_list, &dpc->node);
+			dpc_free_count++;
 		}
+
+		latency = current_time_hires() - dpc->queue_time;
+		if (latency > dpc_stats.max_latency)
+			dpc_stats.max_latency = latency;
+		dpc_record_latency(latency);
+		exit_critical_section();
+
+//		dprintf("dpc calling %p, arg %p\n", cb, cb_arg);
+		KTRACE(KTRACE_DPC_RUN, cb, cb_arg);
+		cb(cb_arg);
+		KTRACE(KTRACE_DPC_DONE, cb, 0);
 	}
 
 	return 0;
 }
 
+void dpc_dump_stats(void)
+{
+	uint i;
+
+	printf("dpc stats:\n");
+	printf("\tqueued: %u\n", dpc_stats.queued);
+	printf("\tpool: %u entries, low water %u, exhausted %u times\n",
+		DPC_POOL_SIZE, dpc_stats.pool_low_water, dpc_stats.pool_exhausted);
+	printf("\tmax latency: %llu us\n", dpc_stats.max_latency);
+	printf("\tlatency histogram (us):\n");
+	for (i = 0; i < DPC_LATENCY_BUCKETS; i++) {
+		if (!dpc_stats.latency[i])
+			continue;
+		if (i == 0)
+			printf("\t\t     < 1: %u\n", dpc_stats.latency[i]);
+		else if (i == DPC_LATENCY_BUCKETS - 1)
+			printf("\t\t>= %6u: %u\n", 1U << (i - 1), dpc_stats.latency[i]);
+		else
+			printf("\t\t<  %6u: %u\n", 1U << i, dpc_stats.latency[i]);
+	}
+}
 
@@ -108,6 +108,19 @@ void event_destroy(event_t *e)
  *         other values on other errors.
  */
 status_t event_wait_timeout(event_t *e, time_t timeout)
+{
+	if (timeout == INFINITE_TIME)
+		return event_wait_timeout_us(e, INFINITE_TIME_US);
+
+	return event_wait_timeout_us(e, (bigtime_t)timeout * 1000);
+}
+
+/**
+ * @brief  Same as event_wait_timeout(), with the timeout in us.
+ *
+ * Pass INFINITE_TIME_US to wait without a timeout.
+ */
+status_t event_wait_timeout_us(event_t *e, bigtime_t timeout)
 {
 	status_t ret = NO_ERROR;
 
@@ -125,7 +138,7 @@ status_t event_wait_timeout(event_t *e, time_t timeout)
 		}
 	} else {
 		/* unsignalled, block here */
-		ret = wait_queue_block(&e->wait, timeout);
+		ret = wait_queue_block_us(&e->wait, timeout);
 		if (ret < 0)
 			goto err;
 	}
@@ -0,0 +1,106 @@
+/*
+ * Kernel event trace
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Binary trace ring for scheduler, timer, IRQ and DPC events.
+ *
+ * Writers claim a slot with a single atomic add on the head index and
+ * then fill it in, so an interrupt landing in the middle of a record
+ * simply takes the next slot. Old records are overwritten once the ring
+ * wraps. Dump the ring with tracing stopped and feed the output to
+ * scripts/ktrace2json.py to get a Chrome trace.
+ */
+
+#include <debug.h>
+#include <platform.h>
+#include <arch/ops.h>
+#include <kernel/thread.h>
+#include <kernel/ktrace.h>
+
+#if KERNEL_TRACE
+
+#if (KTRACE_ENTRIES & (KTRACE_ENTRIES - 1))
+#error KTRACE_ENTRIES must be a power of 2
+#endif
+
+volatile int ktrace_enabled;
+
+static struct ktrace_rec ktrace_ring[KTRACE_ENTRIES];
+static volatile int ktrace_head;
+
+void ktrace_record(uint32_t event, uint32_t a, uint32_t b)
+{
+	struct ktrace_rec *rec;
+	uint32_t idx;
+
+	idx = (uint32_t)atomic_add(&ktrace_head, 1);
+	rec = &ktrace_ring[idx & (KTRACE_ENTRIES - 1)];
+
+	rec->ts = (uint32_t)current_time_hires();
+	rec->event = event;
+	rec->a = a;
+	rec->b = b;
+}
+
+void ktrace_start(void)
+{
+	ktrace_enabled = 1;
+}
+
+void ktrace_stop(void)
+{
+	ktrace_enabled = 0;
+}
+
+void ktrace_clear(void)
+{
+	enter_critical_section();
+	ktrace_head = 0;
+	exit_critical_section();
+}
+
+/**
+ * @brief  Print the ring, oldest record first.
+ *
+ * Thread lines ("T <thread> <name>") come first so the decoder can label
+ * the thread pointers carried by the scheduler events.
+ */
+void ktrace_dump(void)
+{
+	uint32_t head = (uint32_t)ktrace_head;
+	uint32_t count = head < KTRACE_ENTRIES ? head : KTRACE_ENTRIES;
+	uint32_t i;
+	struct ktrace_rec *rec;
+
+	printf("ktrace: %u records, %u dropped\n", count, head - count);
+	ktrace_dump_threads();
+
+	for (i = head - count; i != head; i++) {
+		rec = &ktrace_ring[i & (KTRACE_ENTRIES - 1)];
+		printf("E %u %u 0x%x 0x%x\n", rec->ts, rec->event, rec->a, rec->b);
+	}
+	printf("ktrace: end\n");
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
 #include <boot_stats.h>
+#include <lib/bootprof.h>
 
 #if WITH_LIB_BIO
 #include <lib/bio.h>
@@ -91,6 +92,7 @@ void kmain(void)
 
 	dprintf(INFO, "welcome to lk\n\n");
 	bs_set_timestamp(BS_BL_START);
+	bootprof_mark("lk start");
 
 	// deal with any static constructors
 	dprintf(SPEW, "calling constructors\n");
@@ -137,6 +139,8 @@ int main(void);
 
 static int bootstrap2(void *arg)
 {
+	int prof;
+
 	dprintf(SPEW, "top of bootstrap2()\n");
 
 #if WITH_LIB_ATAGPARSE
@@ -155,11 +159,15 @@ static int bootstrap2(void *arg)
 
 	// initialize the rest of the platform
 	dprintf(SPEW, "initializing platform\n");
+	prof = bootprof_begin("platform init");
 	platform_init();
+	bootprof_end(prof);
 
 	// initialize the target
 	dprintf(SPEW, "initializing target\n");
+	prof = bootprof_begin("target init");
 	target_init();
+	bootprof_end(prof);
 
 	dprintf(SPEW, "calling apps_init()\n");
 	apps_init();
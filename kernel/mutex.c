@@ -38,6 +38,38 @@
 #define MUTEX_CHECK 1
 #endif
 
+struct lock_stats lock_stats;
+
+/*
+ * Only the boot cpu runs threads, so busy waiting on a held mutex can never
+ * observe its release.  The useful part of spin-then-block on this kernel is
+ * the case where the holder was preempted inside its critical section: give
+ * it the cpu a few times before paying for a sleep and wakeup.  Returns true
+ * if the mutex looked free when we stopped.
+ */
+static bool mutex_spin(mutex_t *m)
+{
+	int i;
+
+	for (i = 0; i < MUTEX_SPIN_YIELDS; i++) {
+		thread_t *holder = m->holder;
+
+		if (m->count == 0)
+			return true;
+
+		/* a waiter is being handed the mutex, or the holder is itself
+		 * blocked, or yielding would not let it run: go to sleep.
+		 */
+		if (!holder || holder->state != THREAD_READY ||
+			holder->priority < current_thread->priority)
+			return false;
+
+		thread_yield();
+	}
+
+	return m->count == 0;
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -50,6 +82,7 @@ void mutex_init(mutex_t *m)
 	m->magic = MUTEX_MAGIC;
 	m->count = 0;
 	m->holder = 0;
+	m->contended = 0;
 	wait_queue_init(&m->wait);
 }
 
@@ -88,6 +121,7 @@ void mutex_destroy(mutex_t *m)
 status_t mutex_acquire(mutex_t *m)
 {
 	status_t ret = NO_ERROR;
+	bool spun = false;
 
 	if (current_thread == m->holder)
 		panic("mutex_acquire: thread %p (%s) tried to acquire mutex %p it already owns.\n",
@@ -101,8 +135,16 @@ status_t mutex_acquire(mutex_t *m)
 
 //	dprintf("mutex_acquire: m %p, count %d, curr %p\n", m, m->count, current_thread);
 
+	lock_stats.mutex_acquires++;
+	if (unlikely(m->count > 0)) {
+		m->contended++;
+		lock_stats.mutex_contended++;
+		spun = mutex_spin(m);
+	}
+
 	m->count++;
 	if (unlikely(m->count > 1)) {
+		lock_stats.mutex_blocked++;
 		/* 
 		 * block on the wait queue. If it returns an error, it was likely destroyed
 		 * out from underneath us, so make sure we dont scribble thread ownership 
@@ -111,6 +153,8 @@ status_t mutex_acquire(mutex_t *m)
 		ret = wait_queue_block(&m->wait, INFINITE_TIME);
 		if (ret < 0)
 			goto err;
+	} else if (spun) {
+		lock_stats.mutex_spin_acquired++;
 	}
 	m->holder = current_thread;	
 
@@ -149,8 +193,17 @@ status_t mutex_acquire_timeout(mutex_t *m, time_t timeout)
 
 //	dprintf("mutex_acquire_timeout: m %p, count %d, curr %p, timeout %d\n", m, m->count, current_thread, timeout);
 
+	lock_stats.mutex_acquires++;
+	if (unlikely(m->count > 0)) {
+		m->contended++;
+		lock_stats.mutex_contended++;
+		if (timeout > 0 && mutex_spin(m) && m->count == 0)
+			lock_stats.mutex_spin_acquired++;
+	}
+
 	m->count++;
 	if (unlikely(m->count > 1)) {
+		lock_stats.mutex_blocked++;
 		ret = wait_queue_block(&m->wait, timeout);
 		if (ret < NO_ERROR) {
 			/* if the acquisition timed out, back out the acquire and exit */
@@ -206,3 +259,17 @@ status_t mutex_release(mutex_t *m)
 	return NO_ERROR;
 }
 
+/**
+ * @brief  Dump the global mutex and rwlock contention counters
+ */
+void lock_dump_stats(void)
+{
+	printf("lock stats:\n");
+	printf("\tmutex: %u acquires, %u contended, %u won by yielding, %u blocked\n",
+		lock_stats.mutex_acquires, lock_stats.mutex_contended,
+		lock_stats.mutex_spin_acquired, lock_stats.mutex_blocked);
+	printf("\trwlock read: %u acquires, %u blocked\n",
+		lock_stats.rwlock_read_acquires, lock_stats.rwlock_read_blocked);
+	printf("\trwlock write: %u acquires, %u blocked\n",
+		lock_stats.rwlock_write_acquires, lock_stats.rwlock_write_blocked);
+}
@@ -0,0 +1,60 @@
+/*
+ * One-time initialization
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/once.h>
+#include <kernel/thread.h>
+
+enum {
+	ONCE_NONE = 0,
+	ONCE_RUNNING,
+	ONCE_DONE,
+};
+
+/* initializers run rarely and briefly, so every once_t shares one queue */
+static wait_queue_t once_wait = WAIT_QUEUE_INITIAL_VALUE(once_wait);
+
+void once(once_t *o, once_routine routine)
+{
+	if (likely(o->state == ONCE_DONE))
+		return;
+
+	enter_critical_section();
+
+	if (o->state == ONCE_NONE) {
+		o->state = ONCE_RUNNING;
+		exit_critical_section();
+
+		routine();
+
+		enter_critical_section();
+		o->state = ONCE_DONE;
+		wait_queue_wake_all(&once_wait, true, NO_ERROR);
+	} else {
+		while (o->state == ONCE_RUNNING)
+			wait_queue_block(&once_wait, INFINITE_TIME);
+	}
+
+	exit_critical_section();
+}
@@ -0,0 +1,301 @@
+/*
+ * Parallel loops and task groups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  parallel_for() and task groups on a work-stealing thread pool.
+ *
+ * Each worker thread owns a deque and every other thread shares one more.
+ * A thread pushes and pops work at the bottom of its own deque, and takes
+ * from the top of the others' when its own is empty. parallel_for() hands
+ * out its range lazily: whoever runs a range keeps the lower half and
+ * pushes the upper one, so idle threads steal big pieces and the deques
+ * only ever hold a few entries per loop.
+ *
+ * The kernel is uniprocessor, so a critical section is all the locking
+ * the deques need.
+ */
+
+#include <debug.h>
+#include <string.h>
+#include <kernel/thread.h>
+#include <kernel/parallel.h>
+
+#define PARALLEL_DEQUE_SIZE 32
+
+/* the worker deques, then the one shared by every other thread */
+#define PARALLEL_DEQUES (PARALLEL_WORKERS + 1)
+
+/* either call(arg), or fn over [start, end) in pieces of chunk */
+struct parallel_task {
+	parallel_fn fn;
+	task_fn call;
+	void *arg;
+	size_t start;
+	size_t end;
+	size_t chunk;
+	struct task_group *group;
+};
+
+struct parallel_deque {
+	struct parallel_task task[PARALLEL_DEQUE_SIZE];
+	uint top;
+	uint bottom;
+};
+
+static struct parallel_deque deques[PARALLEL_DEQUES];
+static thread_t *workers[PARALLEL_WORKERS];
+static event_t pool_event;
+static bool pool_started;
+static struct parallel_stats stats;
+
+static uint parallel_self(void)
+{
+	uint i;
+
+	for (i = 0; i < PARALLEL_WORKERS; i++) {
+		if (workers[i] == current_thread)
+			return i;
+	}
+
+	return PARALLEL_WORKERS;
+}
+
+static bool parallel_work_left(void)
+{
+	uint i;
+
+	for (i = 0; i < PARALLEL_DEQUES; i++) {
+		if (deques[i].bottom != deques[i].top)
+			return true;
+	}
+
+	return false;
+}
+
+/* called in a critical section */
+static bool parallel_push(const struct parallel_task *task)
+{
+	struct parallel_deque *dq = &deques[parallel_self()];
+
+	if (!pool_started || dq->bottom - dq->top == PARALLEL_DEQUE_SIZE)
+		return false;
+
+	dq->task[dq->bottom % PARALLEL_DEQUE_SIZE] = *task;
+	dq->bottom++;
+	event_signal(&pool_event, false);
+
+	return true;
+}
+
+/* called in a critical section: own work newest first, then steal the oldest */
+static bool parallel_take(struct parallel_task *task)
+{
+	uint self = parallel_self();
+	struct parallel_deque *dq = &deques[self];
+	uint i;
+
+	if (dq->bottom != dq->top) {
+		dq->bottom--;
+		*task = dq->task[dq->bottom % PARALLEL_DEQUE_SIZE];
+		return true;
+	}
+
+	for (i = 1; i < PARALLEL_DEQUES; i++) {
+		dq = &deques[(self + i) % PARALLEL_DEQUES];
+		if (dq->bottom != dq->top) {
+			*task = dq->task[dq->top % PARALLEL_DEQUE_SIZE];
+			dq->top++;
+			stats.steals++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void parallel_run(struct parallel_task *task);
+
+/* queue a task on this thread's deque, or run it now if that is full */
+static void parallel_submit(struct parallel_task *task)
+{
+	bool pushed;
+
+	enter_critical_section();
+	task->group->pending++;
+	pushed = parallel_push(task);
+	if (!pushed)
+		stats.inline_runs++;
+	exit_critical_section();
+
+	if (!pushed)
+		parallel_run(task);
+}
+
+static void parallel_run(struct parallel_task *task)
+{
+	struct parallel_task split;
+	size_t pieces;
+
+	if (task->call) {
+		task->call(task->arg);
+	} else {
+		/* keep the lower half, leave the upper one for the pool */
+		while (task->end - task->start > task->chunk) {
+			pieces = (task->end - task->start + task->chunk - 1) / task->chunk;
+			split = *task;
+			split.start = task->start + (pieces / 2) * task->chunk;
+			parallel_submit(&split);
+			task->end = split.start;
+		}
+		task->fn(task->arg, task->start, task->end);
+	}
+
+	enter_critical_section();
+	stats.tasks++;
+	if (--task->group->pending == 0)
+		event_signal(&task->group->done, false);
+	exit_critical_section();
+}
+
+static int parallel_worker(void *arg)
+{
+	struct parallel_task task;
+
+	for (;;) {
+		enter_critical_section();
+		while (!parallel_take(&task))
+			event_wait(&pool_event);
+		/* there is more, get another worker going */
+		if (parallel_work_left())
+			event_signal(&pool_event, false);
+		exit_critical_section();
+
+		parallel_run(&task);
+	}
+
+	return 0;
+}
+
+static void parallel_start_pool(void)
+{
+	thread_t *t;
+	uint i;
+
+	enter_critical_section();
+	if (pool_started) {
+		exit_critical_section();
+		return;
+	}
+	event_init(&pool_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	pool_started = true;
+	exit_critical_section();
+
+	/* whatever a missing worker would have done, the waiters do */
+	for (i = 0; i < PARALLEL_WORKERS; i++) {
+		t = thread_create("parallel worker", &parallel_worker, NULL,
+			DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+		if (!t)
+			break;
+		workers[i] = t;
+		thread_resume(t);
+	}
+}
+
+void parallel_for(size_t start, size_t end, size_t chunk,
+		parallel_fn fn, void *arg)
+{
+	struct task_group group;
+	struct parallel_task task;
+
+	if (start >= end)
+		return;
+	if (chunk == 0)
+		chunk = end - start;
+
+	parallel_start_pool();
+	task_group_init(&group);
+
+	memset(&task, 0, sizeof(task));
+	task.fn = fn;
+	task.arg = arg;
+	task.start = start;
+	task.end = end;
+	task.chunk = chunk;
+	task.group = &group;
+
+	/* the caller starts on the range right away */
+	group.pending = 1;
+	parallel_run(&task);
+
+	task_group_wait(&group);
+}
+
+void task_group_init(struct task_group *group)
+{
+	group->pending = 0;
+	event_init(&group->done, false, EVENT_FLAG_AUTOUNSIGNAL);
+}
+
+void task_group_run(struct task_group *group, task_fn fn, void *arg)
+{
+	struct parallel_task task;
+
+	parallel_start_pool();
+
+	memset(&task, 0, sizeof(task));
+	task.call = fn;
+	task.arg = arg;
+	task.group = group;
+	parallel_submit(&task);
+}
+
+/**
+ * @brief  Wait for every task of a group.
+ *
+ * The caller runs queued work, its own group's or not, until the group
+ * is done, and only sleeps when there is nothing left to take.
+ */
+void task_group_wait(struct task_group *group)
+{
+	struct parallel_task task;
+
+	enter_critical_section();
+	while (group->pending) {
+		if (parallel_take(&task)) {
+			exit_critical_section();
+			parallel_run(&task);
+			enter_critical_section();
+		} else {
+			event_wait(&group->done);
+		}
+	}
+	exit_critical_section();
+}
+
+void parallel_get_stats(struct parallel_stats *out)
+{
+	enter_critical_section();
+	*out = stats;
+	exit_critical_section();
+}
@@ -3,14 +3,19 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULES += \
 	lib/libc \
 	lib/debug \
-	lib/heap
+	lib/heap \
+	lib/bootprof
 
 OBJS += \
 	$(LOCAL_DIR)/debug.o \
 	$(LOCAL_DIR)/dpc.o \
 	$(LOCAL_DIR)/event.o \
+	$(LOCAL_DIR)/ktrace.o \
 	$(LOCAL_DIR)/main.o \
 	$(LOCAL_DIR)/mutex.o \
+	$(LOCAL_DIR)/once.o \
+	$(LOCAL_DIR)/parallel.o \
+	$(LOCAL_DIR)/rwlock.o \
 	$(LOCAL_DIR)/thread.o \
 	$(LOCAL_DIR)/timer.o
 
@@ -0,0 +1,173 @@
+/*
+ * Reader/writer locks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/mutex.h>
+#include <kernel/rwlock.h>
+#include <kernel/thread.h>
+
+#if DEBUGLEVEL > INFO
+#define RWLOCK_CHECK 1
+#endif
+
+void rwlock_init(rwlock_t *rw)
+{
+	rw->magic = RWLOCK_MAGIC;
+	rw->readers = 0;
+	rw->writers_waiting = 0;
+	rw->writer = NULL;
+	rw->contended = 0;
+	wait_queue_init(&rw->read_wait);
+	wait_queue_init(&rw->write_wait);
+}
+
+void rwlock_destroy(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->magic = 0;
+	wait_queue_destroy(&rw->read_wait, false);
+	wait_queue_destroy(&rw->write_wait, true);
+	exit_critical_section();
+}
+
+status_t rwlock_acquire_read(rwlock_t *rw)
+{
+	status_t ret = NO_ERROR;
+
+	if (current_thread == rw->writer)
+		panic("rwlock_acquire_read: thread %p (%s) already holds rwlock %p for writing\n",
+				current_thread, current_thread->name, rw);
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	lock_stats.rwlock_read_acquires++;
+	if (unlikely(rw->writer || rw->writers_waiting)) {
+		rw->contended++;
+		lock_stats.rwlock_read_blocked++;
+
+		/* woken in bulk by the last writer to leave; recheck since another
+		 * writer may have queued up in the meantime.
+		 */
+		do {
+			ret = wait_queue_block(&rw->read_wait, INFINITE_TIME);
+			if (ret < 0)
+				goto err;
+		} while (rw->writer || rw->writers_waiting);
+	}
+	rw->readers++;
+
+err:
+	exit_critical_section();
+
+	return ret;
+}
+
+status_t rwlock_release_read(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+	ASSERT(rw->readers > 0);
+#endif
+
+	rw->readers--;
+	if (rw->readers == 0 && rw->writers_waiting)
+		wait_queue_wake_one(&rw->write_wait, true, NO_ERROR);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+status_t rwlock_acquire_write(rwlock_t *rw)
+{
+	status_t ret = NO_ERROR;
+
+	if (current_thread == rw->writer)
+		panic("rwlock_acquire_write: thread %p (%s) tried to acquire rwlock %p it already owns.\n",
+				current_thread, current_thread->name, rw);
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	lock_stats.rwlock_write_acquires++;
+	if (unlikely(rw->writer || rw->readers)) {
+		rw->contended++;
+		lock_stats.rwlock_write_blocked++;
+
+		rw->writers_waiting++;
+		do {
+			ret = wait_queue_block(&rw->write_wait, INFINITE_TIME);
+			if (ret < 0)
+				goto err;
+		} while (rw->writer || rw->readers);
+		rw->writers_waiting--;
+	}
+	rw->writer = current_thread;
+
+err:
+	exit_critical_section();
+
+	return ret;
+}
+
+status_t rwlock_release_write(rwlock_t *rw)
+{
+	if (current_thread != rw->writer)
+		panic("rwlock_release_write: thread %p (%s) tried to release rwlock %p it doesn't own. owned by %p (%s)\n",
+				current_thread, current_thread->name, rw, rw->writer, rw->writer ? rw->writer->name : "none");
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->writer = NULL;
+
+	/* hand off to the next writer if there is one, otherwise let every
+	 * reader that queued up behind us in.
+	 */
+	if (rw->writers_waiting)
+		wait_queue_wake_one(&rw->write_wait, true, NO_ERROR);
+	else
+		wait_queue_wake_all(&rw->read_wait, true, NO_ERROR);
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
@@ -35,11 +35,13 @@
 #include <debug.h>
 #include <list.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
 #include <err.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
+#include <kernel/ktrace.h>
 #include <platform.h>
 
 #if DEBUGLEVEL > INFO
@@ -90,6 +92,15 @@ static void insert_in_run_queue_head(thread_t *t)
 
 	list_add_head(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+
+#if THREAD_STATS
+	/*
+	 * the running thread going back on the queue is still running until
+	 * thread_resched() charges its slice, so its stamp must stay put
+	 */
+	if (t != current_thread)
+		t->acct.last_change = current_time_hires();
+#endif
 }
 
 static void insert_in_run_queue_tail(thread_t *t)
@@ -103,6 +114,11 @@ static void insert_in_run_queue_tail(thread_t *t)
 
 	list_add_tail(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+
+#if THREAD_STATS
+	if (t != current_thread)
+		t->acct.last_change = current_time_hires();
+#endif
 }
 
 static void init_thread_struct(thread_t *t, const char *name)
@@ -112,6 +128,137 @@ static void init_thread_struct(thread_t *t, const char *name)
 	strlcpy(t->name, name, sizeof(t->name));
 }
 
+/*
+ * Thread stacks come in power of two size classes and are kept on per
+ * class free lists when threads exit, so threads that are created and
+ * destroyed over and over don't go back to the heap each time. Larger
+ * requests are allocated directly.
+ *
+ * A fresh stack is painted with STACK_PAINT so the deepest use can be
+ * found later, and its lowest words hold STACK_GUARD to catch overflow.
+ */
+#define STACK_MIN_SHIFT		10	/* 1KB */
+#define STACK_CLASSES		5	/* up to 16KB */
+#define STACK_POOL_DEPTH	4	/* free stacks kept per class */
+#define STACK_GUARD_WORDS	4
+#define STACK_GUARD		0x67617264	/* 'gard' */
+#define STACK_PAINT		0x5354434b	/* 'STCK' */
+
+struct stack_free {
+	struct stack_free *next;
+};
+
+static struct stack_free *stack_pool[STACK_CLASSES];
+static uint stack_pool_count[STACK_CLASSES];
+
+/* class index for a size, or -1 if it is larger than the biggest class */
+static int thread_stack_class(size_t size)
+{
+	int c;
+
+	for (c = 0; c < STACK_CLASSES; c++) {
+		if (size <= ((size_t)1 << (STACK_MIN_SHIFT + c)))
+			return c;
+	}
+
+	return -1;
+}
+
+/* allocate a painted, guarded stack of at least *size bytes */
+static void *thread_stack_alloc(size_t *size)
+{
+	int c = thread_stack_class(*size);
+	void *stack = NULL;
+	uint32_t *w;
+	size_t i;
+
+	if (c >= 0) {
+		*size = (size_t)1 << (STACK_MIN_SHIFT + c);
+
+		enter_critical_section();
+		if (stack_pool[c]) {
+			stack = stack_pool[c];
+			stack_pool[c] = stack_pool[c]->next;
+			stack_pool_count[c]--;
+		}
+		exit_critical_section();
+	} else {
+		*size = ROUNDUP(*size, sizeof(uint32_t));
+	}
+
+	if (!stack)
+		stack = malloc(*size);
+	if (!stack)
+		return NULL;
+
+	w = stack;
+	for (i = 0; i < STACK_GUARD_WORDS; i++)
+		w[i] = STACK_GUARD;
+	for (; i < *size / sizeof(uint32_t); i++)
+		w[i] = STACK_PAINT;
+
+	return stack;
+}
+
+static void thread_stack_free(void *stack, size_t size)
+{
+	int c = thread_stack_class(size);
+
+	if (c >= 0 && ((size_t)1 << (STACK_MIN_SHIFT + c)) == size) {
+		enter_critical_section();
+		if (stack_pool_count[c] < STACK_POOL_DEPTH) {
+			((struct stack_free *)stack)->next = stack_pool[c];
+			stack_pool[c] = stack;
+			stack_pool_count[c]++;
+			stack = NULL;
+		}
+		exit_critical_section();
+	}
+
+	if (stack)
+		free(stack);
+}
+
+static bool thread_stack_guard_ok(thread_t *t)
+{
+	uint32_t *w = t->stack;
+	int i;
+
+	if (!w)
+		return true;
+
+	for (i = 0; i < STACK_GUARD_WORDS; i++) {
+		if (w[i] != STACK_GUARD)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief  Deepest stack use of a thread so far, in bytes
+ *
+ * Found by scanning for the first word that no longer holds the paint
+ * pattern, so it is a high watermark, not the current depth. Returns 0
+ * for threads whose stack was not allocated by thread_create().
+ */
+size_t thread_stack_used(thread_t *t)
+{
+	uint32_t *w = t->stack;
+	size_t words, i;
+
+	if (!w)
+		return 0;
+
+	words = t->stack_size / sizeof(uint32_t);
+	for (i = STACK_GUARD_WORDS; i < words; i++) {
+		if (w[i] != STACK_PAINT)
+			break;
+	}
+
+	return (words - i) * sizeof(uint32_t);
+}
+
 /**
  * @brief  Create a new thread
  *
@@ -157,8 +304,8 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 	t->blocking_wait_queue = NULL;
 	t->wait_queue_block_ret = NO_ERROR;
 
-	/* create the stack */
-	t->stack = malloc(stack_size);
+	/* create the stack, rounded up to its size class */
+	t->stack = thread_stack_alloc(&stack_size);
 	if (!t->stack) {
 		free(t);
 		return NULL;
@@ -228,9 +375,12 @@ static void thread_cleanup_dpc(void *thread)
 	list_delete(&t->thread_list_node);
 	exit_critical_section();
 
+	if (!thread_stack_guard_ok(t))
+		panic("thread %p (%s) overflowed its stack\n", t, t->name);
+
 	/* free its stack and the thread structure itself */
 	if (t->stack)
-		free(t->stack);
+		thread_stack_free(t->stack, t->stack_size);
 
 	free(t);
 }
@@ -258,7 +408,8 @@ void thread_exit(int retcode)
 	current_thread->retcode = retcode;
 
 	/* schedule a dpc to clean ourselves up */
-	dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	dpc_initialize(&current_thread->cleanup_dpc, thread_cleanup_dpc, (void *)current_thread);
+	dpc_queue_obj(&current_thread->cleanup_dpc, DPC_FLAG_NORESCHED);
 
 	/* reschedule */
 	thread_resched();
@@ -269,9 +420,40 @@ void thread_exit(int retcode)
 
 static void idle_thread_routine(void)
 {
-	for(;;)
+	for(;;) {
+		/* an interrupt may have readied a thread without asking for a
+		 * reschedule, and with no periodic tick nobody else will. Check
+		 * and go idle with interrupts off, so one arriving in between
+		 * still ends the wfi; it is taken once they are back on.
+		 */
+		enter_critical_section();
+		if (run_queue_bitmap) {
+			exit_critical_section();
+			thread_yield();
+			continue;
+		}
 		arch_idle();
+		exit_critical_section();
+	}
+}
+
+#if THREAD_STATS
+static void thread_account_switch(thread_t *oldthread, thread_t *newthread, bigtime_t now)
+{
+	bigtime_t latency;
+
+	oldthread->acct.run_time += now - oldthread->acct.last_change;
+	/* if still runnable, its wait for the cpu starts now */
+	oldthread->acct.last_change = now;
+
+	latency = now - newthread->acct.last_change;
+	newthread->acct.wait_time += latency;
+	if (latency > newthread->acct.max_latency)
+		newthread->acct.max_latency = latency;
+	newthread->acct.switches++;
+	newthread->acct.last_change = now;
 }
+#endif
 
 /**
  * @brief  Cause another thread to be executed.
@@ -347,18 +529,23 @@ void thread_resched(void)
 #if THREAD_STATS
 	thread_stats.context_switches++;
 
+	bigtime_t now = current_time_hires();
+
 	if (oldthread == idle_thread) {
-		bigtime_t now = current_time_hires();
 		thread_stats.idle_time += now - thread_stats.last_idle_timestamp;
 	}
 	if (newthread == idle_thread) {
-		thread_stats.last_idle_timestamp = current_time_hires();
+		thread_stats.last_idle_timestamp = now;
 	}
+
+	thread_account_switch(oldthread, newthread, now);
 #endif
 
 #if THREAD_CHECKS
 	ASSERT(critical_section_count > 0);
 	ASSERT(newthread->saved_critical_section_count > 0);
+	if (!thread_stack_guard_ok(oldthread))
+		panic("thread %p (%s) overflowed its stack\n", oldthread, oldthread->name);
 #endif
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
@@ -372,6 +559,8 @@ void thread_resched(void)
 	}
 #endif
 
+	KTRACE(KTRACE_CTXSW, oldthread, newthread);
+
 	/* do the switch */
 	oldthread->saved_critical_section_count = critical_section_count;
 	current_thread = newthread;
@@ -435,8 +624,10 @@ void thread_preempt(void)
 	enter_critical_section();
 
 #if THREAD_STATS
-	if (current_thread != idle_thread)
+	if (current_thread != idle_thread) {
 		thread_stats.preempts++; /* only track when a meaningful preempt happens */
+		current_thread->acct.preemptions++;
+	}
 #endif
 
 	/* we are being preempted, so we get to go back into the front of the run queue if we have quantum left */
@@ -475,8 +666,23 @@ void thread_block(void)
 	exit_critical_section();
 }
 
+/* is a thread of higher priority than the current one ready to run */
+static bool thread_preempt_pending(void)
+{
+	if (!run_queue_bitmap)
+		return false;
+
+	if (current_thread == idle_thread)
+		return true;
+
+	return (run_queue_bitmap & ~((2U << current_thread->priority) - 1)) != 0;
+}
+
 enum handler_return thread_timer_tick(void)
 {
+	if (thread_preempt_pending())
+		return INT_RESCHEDULE;
+
 	if (current_thread == idle_thread)
 		return INT_NO_RESCHEDULE;
 
@@ -514,6 +720,18 @@ static enum handler_return thread_sleep_handler(timer_t *timer, time_t now, void
  * be placed at the head of the run queue.
  */
 void thread_sleep(time_t delay)
+{
+	thread_sleep_us((bigtime_t)delay * 1000);
+}
+
+/**
+ * @brief  Put thread to sleep; delay specified in us
+ *
+ * Like thread_sleep(), for waits shorter than the scheduler tick. Use
+ * this instead of spinning in udelay() when polling hardware from a
+ * thread; other threads run meanwhile.
+ */
+void thread_sleep_us(bigtime_t delay)
 {
 	timer_t timer;
 
@@ -525,7 +743,7 @@ void thread_sleep(time_t delay)
 	timer_initialize(&timer);
 
 	enter_critical_section();
-	timer_set_oneshot(&timer, delay, thread_sleep_handler, (void *)current_thread);
+	timer_set_oneshot_us(&timer, delay, thread_sleep_handler, (void *)current_thread);
 	current_thread->state = THREAD_SLEEPING;
 	thread_resched();
 	exit_critical_section();
@@ -615,7 +833,7 @@ void dump_thread(thread_t *t)
 {
 	dprintf(INFO, "dump_thread: t %p (%s)\n", t, t->name);
 	dprintf(INFO, "\tstate %d, priority %d, remaining quantum %d, critical section %d\n", t->state, t->priority, t->remaining_quantum, t->saved_critical_section_count);
-	dprintf(INFO, "\tstack %p, stack_size %zd\n", t->stack, t->stack_size);
+	dprintf(INFO, "\tstack %p, stack_size %zd, max used %zd\n", t->stack, t->stack_size, thread_stack_used(t));
 	dprintf(INFO, "\tentry %p, arg %p\n", t->entry, t->arg);
 	dprintf(INFO, "\twait queue %p, wait queue ret %d\n", t->blocking_wait_queue, t->wait_queue_block_ret);
 	dprintf(INFO, "\ttls:");
@@ -640,6 +858,95 @@ void dump_all_threads(void)
 	exit_critical_section();
 }
 
+#if THREAD_STATS
+/**
+ * @brief  Copy the accounting of up to max live threads
+ *
+ * The running thread's figures include its current time slice.
+ *
+ * @return number of entries filled in
+ */
+uint thread_get_usage(struct thread_usage *usage, uint max)
+{
+	thread_t *t;
+	uint n = 0;
+	bigtime_t now;
+
+	enter_critical_section();
+	now = current_time_hires();
+	list_for_every_entry(&thread_list, t, thread_t, thread_list_node) {
+		if (n == max)
+			break;
+
+		strlcpy(usage[n].name, t->name, sizeof(usage[n].name));
+		usage[n].priority = t->priority;
+		usage[n].state = t->state;
+		usage[n].acct = t->acct;
+		usage[n].stack_size = t->stack_size;
+		usage[n].stack_used = thread_stack_used(t);
+		if (t == current_thread)
+			usage[n].acct.run_time += now - t->acct.last_change;
+		n++;
+	}
+	exit_critical_section();
+
+	return n;
+}
+
+static const char *thread_state_name(enum thread_state state)
+{
+	switch (state) {
+		case THREAD_SUSPENDED: return "susp";
+		case THREAD_READY: return "ready";
+		case THREAD_RUNNING: return "run";
+		case THREAD_BLOCKED: return "block";
+		case THREAD_SLEEPING: return "sleep";
+		case THREAD_DEATH: return "dead";
+		default: return "?";
+	}
+}
+
+/**
+ * @brief  Print a per thread cpu usage table
+ */
+void dump_all_thread_usage(void)
+{
+	static struct thread_usage usage[32];
+	bigtime_t total = current_time_hires();
+	uint n, i;
+
+	n = thread_get_usage(usage, countof(usage));
+
+	printf("%-16s pri state   run ms  wait ms   cpu%% switch preempt max lat us   stack\n", "name");
+	for (i = 0; i < n; i++) {
+		struct thread_acct *a = &usage[i].acct;
+		uint permille = total ? (uint)((a->run_time * 1000) / total) : 0;
+
+		printf("%-16s %3d %-5s %8llu %8llu %3u.%u %6u %7u %10llu %5zd/%zd\n",
+			usage[i].name, usage[i].priority, thread_state_name(usage[i].state),
+			a->run_time / 1000, a->wait_time / 1000,
+			permille / 10, permille % 10, a->switches, a->preemptions,
+			a->max_latency, usage[i].stack_used, usage[i].stack_size);
+	}
+}
+#endif
+
+#if KERNEL_TRACE
+/**
+ * @brief  List live threads in the form the trace decoder expects
+ */
+void ktrace_dump_threads(void)
+{
+	thread_t *t;
+
+	enter_critical_section();
+	list_for_every_entry(&thread_list, t, thread_t, thread_list_node) {
+		printf("T %p %s\n", t, t->name);
+	}
+	exit_critical_section();
+}
+#endif
+
 /** @} */
 
 
@@ -691,6 +998,20 @@ static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now
  * value specified when the queue was woken by wait_queue_wake_one().
  */
 status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
+{
+	if (timeout == INFINITE_TIME)
+		return wait_queue_block_us(wait, INFINITE_TIME_US);
+
+	return wait_queue_block_us(wait, (bigtime_t)timeout * 1000);
+}
+
+/**
+ * @brief  Block until a wait queue is notified, timeout in us.
+ *
+ * Same as wait_queue_block(), with the timeout in microseconds and
+ * INFINITE_TIME_US to wait indefinitely.
+ */
+status_t wait_queue_block_us(wait_queue_t *wait, bigtime_t timeout)
 {
 	timer_t timer;
 
@@ -709,16 +1030,18 @@ status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
 	current_thread->blocking_wait_queue = wait;
 	current_thread->wait_queue_block_ret = NO_ERROR;
 
+	KTRACE(KTRACE_WAIT_BLOCK, wait, timeout);
+
 	/* if the timeout is nonzero or noninfinite, set a callback to yank us out of the queue */
-	if (timeout != INFINITE_TIME) {
+	if (timeout != INFINITE_TIME_US) {
 		timer_initialize(&timer);
-		timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+		timer_set_oneshot_us(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
 	}
 
 	thread_block();
 
 	/* we don't really know if the timer fired or not, so it's better safe to try to cancel it */
-	if (timeout != INFINITE_TIME) {
+	if (timeout != INFINITE_TIME_US) {
 		timer_cancel(&timer);
 	}
 
@@ -759,6 +1082,8 @@ int wait_queue_wake_one(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		t->wait_queue_block_ret = wait_queue_error;
 		t->blocking_wait_queue = NULL;
 
+		KTRACE(KTRACE_WAIT_WAKE, wait, t);
+
 		/* if we're instructed to reschedule, stick the current thread on the head
 		 * of the run queue first, so that the newly awakened thread gets a chance to run
 		 * before the current one, but the current one doesn't get unnecessarilly punished.
@@ -820,6 +1145,8 @@ int wait_queue_wake_all(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		t->wait_queue_block_ret = wait_queue_error;
 		t->blocking_wait_queue = NULL;
 
+		KTRACE(KTRACE_WAIT_WAKE, wait, t);
+
 		insert_in_run_queue_head(t);
 		ret++;
 	}
@@ -34,16 +34,31 @@
  *
  * Timer callback functions are called in interrupt context.
  *
+ * Deadlines are kept in microseconds of current_time_hires(). Platforms
+ * that define PLATFORM_HAS_DYNAMIC_TIMER program a one-shot interrupt
+ * for the earliest deadline and take no interrupts while the queue is
+ * empty; the others dispatch timers from a 10ms periodic tick.
+ *
+ * Pending timers are kept in a pairing heap ordered by deadline, so
+ * arming a timer is O(1) and expiring or cancelling one is O(log n)
+ * amortized, however many timeouts are outstanding. Cancelling is not
+ * O(1): the timer's children have to be melded back into the heap.
+ * Timers with the same deadline fire in the order they were armed.
+ *
  * @{
  */
 #include <debug.h>
-#include <list.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/ktrace.h>
 #include <platform/timer.h>
 #include <platform.h>
 
-static struct list_node timer_queue;
+/* root of the pairing heap, the timer with the earliest deadline */
+static timer_t *timer_heap;
+
+/* stamped on each timer as it is queued, see timer_before() */
+static uint32_t timer_seq;
 
 static enum handler_return timer_tick(void *arg, time_t now);
 
@@ -53,43 +68,155 @@ static enum handler_return timer_tick(void *arg, time_t now);
 void timer_initialize(timer_t *timer)
 {
 	timer->magic = TIMER_MAGIC;
-	list_clear_node(&timer->node);
+	timer->heap_child = NULL;
+	timer->heap_next = NULL;
+	timer->heap_prev = NULL;
+	timer->heap_seq = 0;
 	timer->scheduled_time = 0;
 	timer->periodic_time = 0;
 	timer->callback = 0;
 	timer->arg = 0;
 }
 
-static void insert_timer_in_queue(timer_t *timer)
+/* every queued timer but the root has a left sibling or a parent */
+static inline bool timer_queued(timer_t *timer)
+{
+	return timer->heap_prev != NULL || timer == timer_heap;
+}
+
+/* earlier deadline, or the same one and armed first; seq may wrap */
+static inline bool timer_before(const timer_t *a, const timer_t *b)
+{
+	if (a->scheduled_time != b->scheduled_time)
+		return a->scheduled_time < b->scheduled_time;
+
+	return (int32_t)(a->heap_seq - b->heap_seq) < 0;
+}
+
+/* link two heaps, the later timer becomes the first child */
+static timer_t *heap_meld(timer_t *a, timer_t *b)
+{
+	timer_t *t;
+
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+
+	if (timer_before(b, a)) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	b->heap_prev = a;
+	b->heap_next = a->heap_child;
+	if (a->heap_child)
+		a->heap_child->heap_prev = b;
+	a->heap_child = b;
+
+	return a;
+}
+
+/* meld a list of sibling subtrees into one heap, the usual two passes */
+static timer_t *heap_merge_pairs(timer_t *first)
 {
-	timer_t *entry;
+	timer_t *pairs = NULL;
+	timer_t *result = NULL;
+	timer_t *a, *b, *next;
+
+	/* left to right, meld siblings in pairs, stacking the results */
+	while (first) {
+		a = first;
+		b = a->heap_next;
+		next = b ? b->heap_next : NULL;
+
+		a->heap_next = a->heap_prev = NULL;
+		if (b)
+			b->heap_next = b->heap_prev = NULL;
+
+		a = heap_meld(a, b);
+		a->heap_next = pairs;
+		pairs = a;
+		first = next;
+	}
+
+	/* right to left, fold the pairs into one heap */
+	while (pairs) {
+		next = pairs->heap_next;
+		pairs->heap_next = NULL;
+		result = heap_meld(result, pairs);
+		pairs = next;
+	}
+
+	return result;
+}
 
+static void insert_timer_in_queue(timer_t *timer)
+{
 //	TRACEF("timer %p, scheduled %d, periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
-	list_for_every_entry(&timer_queue, entry, timer_t, node) {
-		if (TIME_GT(entry->scheduled_time, timer->scheduled_time)) {
-			list_add_before(&entry->node, &timer->node);
-			return;
-		}
+	timer->heap_child = NULL;
+	timer->heap_next = NULL;
+	timer->heap_prev = NULL;
+	timer->heap_seq = timer_seq++;
+	timer_heap = heap_meld(timer_heap, timer);
+}
+
+static void remove_timer_from_queue(timer_t *timer)
+{
+	timer_t *sub = heap_merge_pairs(timer->heap_child);
+
+	if (timer == timer_heap) {
+		timer_heap = sub;
+	} else {
+		/* unlink from the parent's child list */
+		if (timer->heap_prev->heap_child == timer)
+			timer->heap_prev->heap_child = timer->heap_next;
+		else
+			timer->heap_prev->heap_next = timer->heap_next;
+		if (timer->heap_next)
+			timer->heap_next->heap_prev = timer->heap_prev;
+
+		timer_heap = heap_meld(timer_heap, sub);
+	}
+
+	timer->heap_child = NULL;
+	timer->heap_next = NULL;
+	timer->heap_prev = NULL;
+}
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* program the hardware for the head of the queue, or stop it */
+static void timer_program(bigtime_t now)
+{
+	timer_t *head = timer_heap;
+
+	if (!head) {
+		platform_stop_timer();
+		return;
 	}
 
-	/* walked off the end of the list */
-	list_add_tail(&timer_queue, &timer->node);
+	if (head->scheduled_time <= now)
+		platform_set_oneshot_timer(timer_tick, NULL, 0);
+	else
+		platform_set_oneshot_timer(timer_tick, NULL, head->scheduled_time - now);
 }
+#endif
 
-static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callback callback, void *arg)
+static void timer_set(timer_t *timer, bigtime_t delay, bigtime_t period, timer_callback callback, void *arg)
 {
-	time_t now;
+	bigtime_t now;
 
 //	TRACEF("timer %p, delay %d, period %d, callback %p, arg %p, now %d\n", timer, delay, period, callback, arg);
 
 	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);	
 
-	if (list_in_list(&timer->node)) {
-		panic("timer %p already in list\n", timer);
+	if (timer_queued(timer)) {
+		panic("timer %p already queued\n", timer);
 	}
 
-	now = current_time();
+	now = current_time_hires();
 	timer->scheduled_time = now + delay;
 	timer->periodic_time = period;
 	timer->callback = callback;
@@ -102,10 +229,9 @@ static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callbac
 	insert_timer_in_queue(timer);
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	if (list_peek_head_type(&timer_queue, timer_t, node) == timer) {
+	if (timer_heap == timer) {
 		/* we just modified the head of the timer queue */
-//		TRACEF("setting new timer for %u msecs\n", (uint)delay);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
+		timer_program(now);
 	}
 #endif
 
@@ -130,6 +256,18 @@ void timer_set_oneshot(timer_t *timer, time_t delay, timer_callback callback, vo
 {
 	if (delay == 0)
 		delay = 1;
+	timer_set(timer, (bigtime_t)delay * 1000, 0, callback, arg);
+}
+
+/**
+ * @brief  Set up a timer that executes once, delay in microseconds
+ *
+ * Same as timer_set_oneshot(). How closely the deadline is met depends on
+ * the platform: to the timer resolution with PLATFORM_HAS_DYNAMIC_TIMER,
+ * otherwise rounded up to the next periodic tick.
+ */
+void timer_set_oneshot_us(timer_t *timer, bigtime_t delay, timer_callback callback, void *arg)
+{
 	timer_set(timer, delay, 0, callback, arg);
 }
 
@@ -151,7 +289,7 @@ void timer_set_periodic(timer_t *timer, time_t period, timer_callback callback,
 {
 	if (period == 0)
 		period = 1;
-	timer_set(timer, period, period, callback, arg);
+	timer_set(timer, (bigtime_t)period * 1000, (bigtime_t)period * 1000, callback, arg);
 }
 
 /**
@@ -164,11 +302,11 @@ void timer_cancel(timer_t *timer)
 	enter_critical_section();
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	timer_t *oldhead = list_peek_head_type(&timer_queue, timer_t, node);
+	timer_t *oldhead = timer_heap;
 #endif
 
-	if (list_in_list(&timer->node))
-		list_delete(&timer->node);
+	if (timer_queued(timer))
+		remove_timer_from_queue(timer);
 
 	/* to keep it from being reinserted into the queue if called from 
 	 * periodic timer callback.
@@ -179,22 +317,8 @@ void timer_cancel(timer_t *timer)
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* see if we've just modified the head of the timer queue */
-	timer_t *newhead = list_peek_head_type(&timer_queue, timer_t, node);
-	if (newhead == NULL) {
-//		TRACEF("clearing old hw timer, nothing in the queue\n");
-		platform_stop_timer();
-	} else if (newhead != oldhead) {
-		time_t delay;
-		time_t now = current_time();
-
-		if (TIME_LT(newhead->scheduled_time, now))
-			delay = 0;
-		else
-			delay = newhead->scheduled_time - now;
-
-//		TRACEF("setting new timer to %d\n", delay);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
-	}
+	if (timer_heap != oldhead)
+		timer_program(current_time_hires());
 #endif
 
 	exit_critical_section();
@@ -205,6 +329,7 @@ static enum handler_return timer_tick(void *arg, time_t now)
 {
 	timer_t *timer;
 	enum handler_return ret = INT_NO_RESCHEDULE;
+	bigtime_t now_us = current_time_hires();
 
 #if THREAD_STATS
 	thread_stats.timer_ints++;
@@ -214,15 +339,13 @@ static enum handler_return timer_tick(void *arg, time_t now)
 
 	for (;;) {
 		/* see if there's an event to process */
-		timer = list_peek_head_type(&timer_queue, timer_t, node);
-		if (likely(!timer || TIME_LT(now, timer->scheduled_time)))
+		timer = timer_heap;
+		if (likely(!timer || now_us < timer->scheduled_time))
 			break;
 
 		/* process it */
 		DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
-		list_delete(&timer->node);
-//		timer = list_remove_head_type(&timer_queue, timer_t, node);
-//		ASSERT(timer);
+		remove_timer_from_queue(timer);
 
 //		TRACEF("dequeued timer %p, scheduled %d periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
@@ -231,33 +354,28 @@ static enum handler_return timer_tick(void *arg, time_t now)
 #endif
 
 		bool periodic = timer->periodic_time > 0;
+		enum handler_return cb_ret;
 
 //		TRACEF("timer %p firing callback %p, arg %p\n", timer, timer->callback, timer->arg);
-		if (timer->callback(timer, now, timer->arg) == INT_RESCHEDULE)
+		KTRACE(KTRACE_TIMER_FIRE, timer, timer->callback);
+		cb_ret = timer->callback(timer, now, timer->arg);
+		KTRACE(KTRACE_TIMER_DONE, timer, cb_ret);
+		if (cb_ret == INT_RESCHEDULE)
 			ret = INT_RESCHEDULE;
 
 		/* if it was a periodic timer and it hasn't been requeued
 		 * by the callback put it back in the list
 		 */
-		if (periodic && !list_in_list(&timer->node) && timer->periodic_time > 0) {
+		if (periodic && !timer_queued(timer) && timer->periodic_time > 0) {
 //			TRACEF("periodic timer, period %u\n", (uint)timer->periodic_time);
-			timer->scheduled_time = now + timer->periodic_time;
+			timer->scheduled_time = now_us + timer->periodic_time;
 			insert_timer_in_queue(timer);
 		}
 	}
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* reset the timer to the next event */
-	timer = list_peek_head_type(&timer_queue, timer_t, node);
-	if (timer) {
-		/* has to be the case or it would have fired already */
-		ASSERT(TIME_GT(timer->scheduled_time, now));
-
-		time_t delay = timer->scheduled_time - now;
-
-//		TRACEF("setting new timer for %u msecs for event %p\n", (uint)delay, timer);
-		platform_set_oneshot_timer(timer_tick, NULL, delay);
-	}
+	timer_program(now_us);
 #else
 	/* let the scheduler have a shot to do quantum expiration, etc */
 	/* in case of dynamic timer, the scheduler will set up a periodic timer */
@@ -265,17 +383,17 @@ static enum handler_return timer_tick(void *arg, time_t now)
 		ret = INT_RESCHEDULE;
 #endif
 
-	// XXX fix this, should return ret
-	ret = INT_RESCHEDULE;
 	return ret;
 }
 
 void timer_init(void)
 {
-	list_initialize(&timer_queue);
+	timer_heap = NULL;
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
 	/* register for a periodic timer tick */
 	platform_set_periodic_timer(timer_tick, NULL, 10); /* 10ms */
+#endif
 }
 
 
@@ -0,0 +1,160 @@
+/*
+ * Boot time profiler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <platform.h>
+#include <kernel/thread.h>
+#include <lib/bootprof.h>
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+#endif
+
+/*
+ * Spans are recorded in the order they are opened into a fixed table, so
+ * recording never allocates and can be used before the heap is up. Open
+ * spans nest: each one remembers how many were open when it started,
+ * which is enough to print the stages as a tree.
+ */
+static struct bootprof_span spans[BOOTPROF_MAX_SPANS];
+static unsigned int span_count;
+static unsigned int open_depth;
+static bool overflowed;
+
+static int bootprof_alloc(const char *name, bigtime_t now)
+{
+	int id = -1;
+
+	enter_critical_section();
+	if (span_count < BOOTPROF_MAX_SPANS) {
+		id = span_count++;
+		spans[id].name = name;
+		spans[id].start = now;
+		spans[id].end = 0;
+		spans[id].depth = open_depth;
+	} else {
+		overflowed = true;
+	}
+	exit_critical_section();
+
+	return id;
+}
+
+/* Open a span; returns the id to pass to bootprof_end(), or -1 if full */
+int bootprof_begin(const char *name)
+{
+	int id = bootprof_alloc(name, current_time_hires());
+
+	if (id >= 0) {
+		enter_critical_section();
+		open_depth++;
+		exit_critical_section();
+	}
+
+	return id;
+}
+
+void bootprof_end(int id)
+{
+	bigtime_t now = current_time_hires();
+
+	if (id < 0 || (unsigned int)id >= span_count || spans[id].end)
+		return;
+
+	enter_critical_section();
+	spans[id].end = now ? now : 1;
+	if (open_depth)
+		open_depth--;
+	exit_critical_section();
+}
+
+/* Record a single point in time */
+void bootprof_mark(const char *name)
+{
+	bigtime_t now = current_time_hires();
+	int id = bootprof_alloc(name, now);
+
+	if (id >= 0)
+		spans[id].end = now;
+}
+
+unsigned int bootprof_count(void)
+{
+	return span_count;
+}
+
+const struct bootprof_span *bootprof_get(unsigned int idx)
+{
+	if (idx >= span_count)
+		return NULL;
+
+	return &spans[idx];
+}
+
+/* Indentation for nested spans, two spaces per level */
+static const char *bootprof_indent(unsigned int depth)
+{
+	static const char indent[] = "                ";
+
+	depth *= 2;
+	if (depth > sizeof(indent) - 1)
+		depth = sizeof(indent) - 1;
+
+	return indent + sizeof(indent) - 1 - depth;
+}
+
+void bootprof_dump(void)
+{
+	unsigned int i;
+
+	dprintf(INFO, "boot profile (us):\n");
+	for (i = 0; i < span_count; i++) {
+		struct bootprof_span *s = &spans[i];
+
+		if (s->end)
+			dprintf(INFO, "  %s%-24s %10llu %10llu\n",
+				bootprof_indent(s->depth), s->name, s->start,
+				s->end - s->start);
+		else
+			dprintf(INFO, "  %s%-24s %10llu       open\n",
+				bootprof_indent(s->depth), s->name, s->start);
+	}
+
+	if (overflowed)
+		dprintf(INFO, "  (table full, later spans dropped)\n");
+}
+
+#if WITH_LIB_CONSOLE
+
+static int cmd_bootprof(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("bootprof", "dump boot time profile", &cmd_bootprof)
+STATIC_COMMAND_END(bootprof);
+
+static int cmd_bootprof(int argc, const cmd_args *argv)
+{
+	bootprof_dump();
+	return 0;
+}
+
+#endif
@@ -32,7 +32,24 @@
 #define INC_POINTER(cbuf, ptr, inc) \
 	modpow2(((ptr) + (inc)), (cbuf)->len_pow2)
 
+/*
+ * Orders the buffer contents against the index that publishes them. A
+ * compiler barrier is enough while producer and consumer share a cpu.
+ */
+#define cbuf_barrier() __asm__ volatile("" ::: "memory")
+
+/* Without CBUF_FLAG_SPSC every operation runs in a critical section. */
+#define CBUF_LOCK(cbuf) \
+	do { if (!((cbuf)->flags & CBUF_FLAG_SPSC)) enter_critical_section(); } while (0)
+#define CBUF_UNLOCK(cbuf) \
+	do { if (!((cbuf)->flags & CBUF_FLAG_SPSC)) exit_critical_section(); } while (0)
+
 void cbuf_initialize(cbuf_t *cbuf, size_t len)
+{
+	cbuf_initialize_etc(cbuf, len, 0);
+}
+
+void cbuf_initialize_etc(cbuf_t *cbuf, size_t len, uint flags)
 {
 	DEBUG_ASSERT(cbuf);
 	DEBUG_ASSERT(len > 0);
@@ -41,20 +58,78 @@ void cbuf_initialize(cbuf_t *cbuf, size_t len)
 	cbuf->head = 0;
 	cbuf->tail = 0;
 	cbuf->len_pow2 = log2(len);
+	cbuf->flags = flags;
+	cbuf->waiting = false;
 	cbuf->buf = malloc(len);
 	event_init(&cbuf->event, false, 0);
 
-	LTRACEF("len %zd, len_pow2 %u\n", len, cbuf->len_pow2);
+	LTRACEF("len %zd, len_pow2 %u, flags 0x%x\n", len, cbuf->len_pow2, flags);
+}
+
+/* split len bytes starting at pos into at most two contiguous pieces */
+static size_t cbuf_span(cbuf_t *cbuf, uint pos, size_t len, cbuf_vec_t vec[2])
+{
+	size_t first = MIN(valpow2(cbuf->len_pow2) - pos, len);
+
+	vec[0].buf = cbuf->buf + pos;
+	vec[0].len = first;
+	vec[1].buf = cbuf->buf;
+	vec[1].len = len - first;
+
+	return len;
+}
+
+size_t cbuf_peek(cbuf_t *cbuf, cbuf_vec_t vec[2])
+{
+	uint head = cbuf->head;
+	uint tail = cbuf->tail;
+
+	/* the data behind head was written before head was published */
+	cbuf_barrier();
+
+	return cbuf_span(cbuf, tail, modpow2(head - tail, cbuf->len_pow2), vec);
+}
+
+void cbuf_commit(cbuf_t *cbuf, size_t len)
+{
+	/* finish reading the data before handing the space back */
+	cbuf_barrier();
+	cbuf->tail = INC_POINTER(cbuf, cbuf->tail, len);
+}
+
+size_t cbuf_reserve(cbuf_t *cbuf, cbuf_vec_t vec[2])
+{
+	uint head = cbuf->head;
+	uint tail = cbuf->tail;
+
+	cbuf_barrier();
+
+	return cbuf_span(cbuf, head,
+		modpow2(tail - head - 1, cbuf->len_pow2), vec);
 }
 
-static size_t cbuf_space_avail(cbuf_t *cbuf)
+void cbuf_publish(cbuf_t *cbuf, size_t len, bool canreschedule)
 {
-	return (cbuf->head + valpow2(cbuf->len_pow2) - cbuf->tail - 1);
+	if (len == 0)
+		return;
+
+	/* make the data visible before the index that covers it */
+	cbuf_barrier();
+	cbuf->head = INC_POINTER(cbuf, cbuf->head, len);
+	cbuf_barrier();
+
+	/* only a blocked reader needs the event, and only once */
+	if (cbuf->waiting) {
+		cbuf->waiting = false;
+		event_signal(&cbuf->event, canreschedule);
+	}
 }
 
 size_t cbuf_write(cbuf_t *cbuf, const void *_buf, size_t len, bool canreschedule)
 {
 	const char *buf = (const char *)_buf;
+	cbuf_vec_t vec[2];
+	size_t avail;
 
 	LTRACEF("len %zd\n", len);
 
@@ -62,85 +137,67 @@ size_t cbuf_write(cbuf_t *cbuf, const void *_buf, size_t len, bool canreschedule
 	DEBUG_ASSERT(_buf);
 	DEBUG_ASSERT(len < valpow2(cbuf->len_pow2));
 
-	enter_critical_section();
+	CBUF_LOCK(cbuf);
 
-	size_t write_len;
-	size_t pos = 0;
+	avail = cbuf_reserve(cbuf, vec);
+	len = MIN(len, avail);
 
-	while (pos < len && cbuf_space_avail(cbuf) > 0) {
-		if (cbuf->head >= cbuf->tail) {
-			write_len = MIN(valpow2(cbuf->len_pow2) - cbuf->head, len - pos);
-		} else {
-			write_len = MIN(cbuf->tail - cbuf->head - 1, len - pos);
-		}
+	// if it's full, this writes nothing and returns 0
+	memcpy(vec[0].buf, buf, MIN(len, vec[0].len));
+	if (len > vec[0].len)
+		memcpy(vec[1].buf, buf + vec[0].len, len - vec[0].len);
 
-		// if it's full, abort and return how much we've written
-		if (write_len == 0) {
-			break;
-		}
+	cbuf_publish(cbuf, len, canreschedule);
 
-		memcpy(cbuf->buf + cbuf->head, buf + pos, write_len);
+	CBUF_UNLOCK(cbuf);
 
-		cbuf->head = INC_POINTER(cbuf, cbuf->head, write_len);
-		pos += write_len;
-	}
+	return len;
+}
 
-	if (cbuf->head != cbuf->tail)
-		event_signal(&cbuf->event, canreschedule);
+/* block until there is something to read */
+static void cbuf_wait(cbuf_t *cbuf)
+{
+	enter_critical_section();
 
-	exit_critical_section();
+	while (cbuf->head == cbuf->tail) {
+		cbuf->waiting = true;
+		cbuf_barrier();
 
-	return pos;
+		/* recheck, the writer may have published before seeing waiting */
+		if (cbuf->head != cbuf->tail)
+			break;
+
+		event_wait(&cbuf->event);
+		event_unsignal(&cbuf->event);
+	}
+	cbuf->waiting = false;
+
+	exit_critical_section();
 }
 
 size_t cbuf_read(cbuf_t *cbuf, void *_buf, size_t buflen, bool block)
 {
-	size_t ret;
 	char *buf = (char *)_buf;
+	cbuf_vec_t vec[2];
+	size_t len;
 
 	DEBUG_ASSERT(cbuf);
 	DEBUG_ASSERT(_buf);
 
-	enter_critical_section();
+	CBUF_LOCK(cbuf);
 
 	if (block)
-		event_wait(&cbuf->event);
+		cbuf_wait(cbuf);
 
-	// see if there's data available
-	if (cbuf->tail != cbuf->head) {
-		size_t pos = 0;
-
-		// loop until we've read everything we need
-		// at most this will make two passes to deal with wraparound
-		while (pos < buflen && cbuf->tail != cbuf->head) {
-			size_t read_len;
-			if (cbuf->head > cbuf->tail) {
-				// simple case where there is no wraparound
-				read_len = MIN(cbuf->head - cbuf->tail, buflen - pos);
-			} else {
-				// read to the end of buffer in this pass
-				read_len = MIN(valpow2(cbuf->len_pow2) - cbuf->tail, buflen - pos);
-			}
-
-			memcpy(buf + pos, cbuf->buf + cbuf->tail, read_len);
-
-			cbuf->tail = INC_POINTER(cbuf, cbuf->tail, read_len);
-			pos += read_len;
-		}
-
-		if (cbuf->tail == cbuf->head) {
-			// we've emptied the buffer, unsignal the event
-			event_unsignal(&cbuf->event);
-		}
-
-		ret = pos;
-	} else {
-		DEBUG_ASSERT(!block);
-		ret = 0;
-	}
+	len = MIN(cbuf_peek(cbuf, vec), buflen);
 
-	exit_critical_section();
+	memcpy(buf, vec[0].buf, MIN(len, vec[0].len));
+	if (len > vec[0].len)
+		memcpy(buf + vec[0].len, vec[1].buf, len - vec[0].len);
 
-	return ret;
-}
+	cbuf_commit(cbuf, len);
+
+	CBUF_UNLOCK(cbuf);
 
+	return len;
+}
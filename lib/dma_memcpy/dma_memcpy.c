@@ -0,0 +1,178 @@
+/*
+ * Memory to memory copies through a DMA engine
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <platform.h>
+#include <arch/ops.h>
+#include <lib/dma_memcpy.h>
+
+/*
+ * A copy is split as
+ *
+ *   [cpu head][engine: whole cache lines of dst][cpu tail]
+ *
+ * so that no cache line of the destination is shared between the cpu and
+ * the engine: invalidating a partly written line would drop the cpu's
+ * bytes, cleaning it after the engine wrote would overwrite the engine's.
+ */
+
+#if DMA_MEMCPY_ADM
+static const struct dma_memcpy_engine *dma_engine = &adm_dma_memcpy_engine;
+#elif DMA_MEMCPY_SW
+static const struct dma_memcpy_engine *dma_engine = &dma_memcpy_sw_engine;
+#else
+static const struct dma_memcpy_engine *dma_engine;
+#endif
+
+static struct dma_memcpy_stats dma_stats;
+
+void dma_memcpy_set_engine(const struct dma_memcpy_engine *engine)
+{
+	dma_engine = engine;
+}
+
+const struct dma_memcpy_engine *dma_memcpy_get_engine(void)
+{
+	return dma_engine;
+}
+
+void dma_memcpy_get_stats(struct dma_memcpy_stats *stats)
+{
+	*stats = dma_stats;
+}
+
+void dma_memcpy_reset_stats(void)
+{
+	memset(&dma_stats, 0, sizeof(dma_stats));
+}
+
+static int dma_engine_copy(const struct dma_memcpy_engine *e, addr_t dst,
+		addr_t src, size_t len)
+{
+	size_t chunk;
+	int ret;
+
+	/* make the source visible to the engine, drop stale destination lines */
+	arch_clean_cache_range(src, len);
+	arch_clean_invalidate_cache_range(dst, len);
+
+	while (len) {
+		chunk = len;
+		if (e->max_len && chunk > e->max_len)
+			chunk = ROUNDDOWN(e->max_len, CACHE_LINE);
+
+		ret = e->copy(PA(dst), PA(src), chunk);
+		if (ret)
+			return ret;
+
+		dst += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+static void *dma_copy(void *dst, const void *src, size_t len, bool overlap)
+{
+	const struct dma_memcpy_engine *e = dma_engine;
+	addr_t d = (addr_t)dst;
+	addr_t s = (addr_t)src;
+	size_t head, mid;
+	int ret;
+
+	if (!e || len < DMA_MEMCPY_MIN_LEN)
+		goto cpu;
+
+	if (d < s + len && s < d + len)
+		goto cpu;
+
+	head = ROUNDUP(d, CACHE_LINE) - d;
+	mid = ROUNDDOWN(len - head, CACHE_LINE);
+	if (((s + head) & (e->align - 1)) || mid < DMA_MEMCPY_MIN_LEN)
+		goto cpu;
+
+	ret = dma_engine_copy(e, d + head, s + head, mid);
+
+	/* drop lines speculatively fetched while the engine was writing */
+	arch_invalidate_cache_range(d + head, mid);
+
+	if (ret) {
+		dprintf(CRITICAL, "dma_memcpy: %s failed, copying %u bytes by cpu\n",
+			e->name, mid);
+		dma_stats.errors++;
+		goto cpu;
+	}
+
+	memcpy(dst, src, head);
+	memcpy((char *)dst + head + mid, (const char *)src + head + mid,
+		len - head - mid);
+
+	dma_stats.dma_copies++;
+	dma_stats.dma_bytes += mid;
+	dma_stats.cpu_bytes += len - mid;
+	return dst;
+
+cpu:
+	dma_stats.cpu_copies++;
+	dma_stats.cpu_bytes += len;
+	if (overlap)
+		return memmove(dst, src, len);
+	return memcpy(dst, src, len);
+}
+
+void *dma_memcpy(void *dst, const void *src, size_t len)
+{
+	return dma_copy(dst, src, len, false);
+}
+
+void *dma_memmove(void *dst, const void *src, size_t len)
+{
+	return dma_copy(dst, src, len, true);
+}
+
+/*
+ * The model holds callers to the same rules as real hardware, so a target
+ * without an engine (qemu, or a board still bringing one up) exercises the
+ * splitting and cache handling above.
+ */
+#define DMA_SW_ALIGN	8
+#define DMA_SW_MAX_LEN	(256 * 1024)
+
+static int dma_sw_copy(addr_t dst, addr_t src, size_t len)
+{
+	ASSERT(!(dst & (CACHE_LINE - 1)) && !(len & (CACHE_LINE - 1)));
+	ASSERT(!(src & (DMA_SW_ALIGN - 1)));
+	ASSERT(len <= DMA_SW_MAX_LEN);
+
+	memcpy((void *)VA(dst), (const void *)VA(src), len);
+	return 0;
+}
+
+const struct dma_memcpy_engine dma_memcpy_sw_engine = {
+	.name = "sw",
+	.align = DMA_SW_ALIGN,
+	.max_len = DMA_SW_MAX_LEN,
+	.copy = dma_sw_copy,
+};
@@ -0,0 +1,9 @@
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+# the software model as the default engine, for bring up
+ifeq ($(ENABLE_SW_DMA_MEMCPY),1)
+DEFINES += DMA_MEMCPY_SW=1
+endif
+
+OBJS += \
+	$(LOCAL_DIR)/dma_memcpy.o
@@ -6,6 +6,17 @@ OBJS += \
 	$(LOCAL_DIR)/memcpy.o \
 	$(LOCAL_DIR)/memset.o
 
+# NEON versions on cores that have it, memcpy.S and memset.S become their
+# scalar fallbacks (see ARM_WITH_NEON in arch/arm/rules.mk)
+ifeq ($(ARM_CPU),cortex-a8)
+ASM_STRING_OPS += memcmp
+
+OBJS += \
+	$(LOCAL_DIR)/memcpy_neon.o \
+	$(LOCAL_DIR)/memset_neon.o \
+	$(LOCAL_DIR)/memcmp_neon.o
+endif
+
 # filter out the C implementation
 C_STRING_OPS := $(filter-out $(ASM_STRING_OPS),$(C_STRING_OPS))
 
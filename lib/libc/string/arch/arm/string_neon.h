@@ -0,0 +1,72 @@
+/*
+ * Shared pieces of the NEON string routines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __STRING_NEON_H
+#define __STRING_NEON_H
+
+/*
+ * Size classes. Below STRING_NEON_SMALL the routines stay in integer
+ * registers. Up to STRING_NEON_LARGE the data is most likely cached and
+ * is moved 32 bytes per iteration with no further setup. From there on
+ * the destination is aligned, the source is preloaded STRING_NEON_PLD
+ * bytes ahead and 64 bytes are moved per iteration.
+ */
+#define STRING_NEON_SMALL	16
+#define STRING_NEON_LARGE	256
+#define STRING_NEON_PLD		256
+
+/*
+ * NEON registers are not saved across a context switch, so the vector
+ * code runs with interrupts off. Large operations let pending interrupts
+ * in every STRING_NEON_WINDOW bytes, with nothing live in NEON registers.
+ */
+#define STRING_NEON_WINDOW	16384
+
+.syntax	unified
+.arm
+.fpu	neon
+
+// branch to \fallback until arch_early_init() has turned the fpu on
+.macro	neon_check fallback
+	movw	r12, #:lower16:arm_neon_enabled
+	movt	r12, #:upper16:arm_neon_enabled
+	ldr	r12, [r12]
+	cmp	r12, #0
+	beq	\fallback
+.endm
+
+// r12 holds the interrupt state from neon_begin until neon_end
+.macro	neon_begin
+	mrs	r12, cpsr
+	cpsid	i
+.endm
+
+.macro	neon_end
+	msr	cpsr_c, r12
+.endm
+
+.macro	neon_window
+	msr	cpsr_c, r12
+	cpsid	i
+.endm
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * libfdt - Flat Device Tree manipulation
+ *
+ * libfdt is dual licensed: you can use it either under the terms of
+ * the GPL, or the BSD license, at your option.
+ *
+ *  a) This library is free software; you can redistribute it and/or
+ *     modify it under the terms of the GNU General Public License as
+ *     published by the Free Software Foundation; either version 2 of the
+ *     License, or (at your option) any later version.
+ *
+ *     This library is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public
+ *     License along with this library; if not, write to the Free
+ *     Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ *     MA 02110-1301 USA
+ *
+ * Alternatively,
+ *
+ *  b) Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *     1. Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *     2. Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *     THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *     CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *     INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *     MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *     DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *     CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *     SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *     NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *     LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ *     HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *     CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *     OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *     EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "libfdt_env.h"
+
+#include <fdt.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+#include "libfdt_internal.h"
+
+/*
+ * Optional offset index for read-mostly trees.
+ *
+ * fdt_index_build() walks the structure block once and records every
+ * node's offset, parent and phandle. Paths are hashed with the unit
+ * addresses stripped from each component, so "/soc/memory" and
+ * "/soc@0/memory@80000000" land in the same bucket; candidates are then
+ * verified component by component with the same matching rules as
+ * fdt_subnode_offset(). A single tree is indexed at a time.
+ *
+ * Writes through fdt_rw/fdt_wip keep the index usable where they can:
+ * splices in the structure block just shift the recorded offsets, while
+ * anything that adds, removes or renames nodes, or touches a phandle,
+ * invalidates it and lookups fall back to the linear walk.
+ */
+
+#define FDT_INDEX_MAX_DEPTH	32
+#define FDT_HASH_INIT		2166136261u
+#define FDT_HASH_PRIME		16777619u
+
+struct fdt_index_node {
+	int offset;
+	int parent;
+	uint32_t phandle;
+	uint32_t path_hash;
+};
+
+static struct {
+	const void *fdt;
+	int valid;
+	int count;
+	uint32_t mask;
+	struct fdt_index_node *nodes;
+	int *path_slots;	/* node index + 1, 0 for an empty slot */
+	int *phandle_slots;
+} fdt_idx;
+
+static uint32_t _fdt_hash_component(uint32_t hash, const char *s, int len)
+{
+	const char *at = memchr(s, '@', len);
+	int i;
+
+	if (at)
+		len = at - s;
+
+	hash = (hash ^ '/') * FDT_HASH_PRIME;
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (uint8_t)s[i]) * FDT_HASH_PRIME;
+
+	return hash;
+}
+
+static uint32_t _fdt_hash_phandle(uint32_t phandle)
+{
+	return phandle * 2654435761u;
+}
+
+static void _fdt_index_insert(int *slots, uint32_t hash, int node)
+{
+	uint32_t i;
+
+	for (i = hash & fdt_idx.mask; slots[i]; i = (i + 1) & fdt_idx.mask)
+		;
+	slots[i] = node + 1;
+}
+
+void fdt_index_release(const void *fdt)
+{
+	if (fdt && fdt != fdt_idx.fdt)
+		return;
+
+	free(fdt_idx.nodes);
+	free(fdt_idx.path_slots);
+	free(fdt_idx.phandle_slots);
+	memset(&fdt_idx, 0, sizeof(fdt_idx));
+}
+
+int fdt_index_build(const void *fdt)
+{
+	int stack[FDT_INDEX_MAX_DEPTH];
+	int offset, depth, count, n;
+	uint32_t slots;
+
+	FDT_CHECK_HEADER(fdt);
+
+	fdt_index_release(NULL);
+
+	count = 0;
+	for (offset = 0, depth = 0; (offset >= 0) && (depth >= 0);
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -FDT_ERR_BADSTRUCTURE;
+		count++;
+	}
+	if ((offset < 0) && (offset != -FDT_ERR_NOTFOUND))
+		return offset;
+
+	for (slots = 16; slots < (uint32_t)(2 * count); slots <<= 1)
+		;
+
+	fdt_idx.nodes = malloc(count * sizeof(*fdt_idx.nodes));
+	fdt_idx.path_slots = calloc(slots, sizeof(int));
+	fdt_idx.phandle_slots = calloc(slots, sizeof(int));
+	if (!fdt_idx.nodes || !fdt_idx.path_slots || !fdt_idx.phandle_slots) {
+		fdt_index_release(NULL);
+		return -FDT_ERR_NOSPACE;
+	}
+	fdt_idx.mask = slots - 1;
+
+	n = 0;
+	for (offset = 0, depth = 0; (offset >= 0) && (depth >= 0) && (n < count);
+	     offset = fdt_next_node(fdt, offset, &depth), n++) {
+		struct fdt_index_node *node = &fdt_idx.nodes[n];
+		const char *name;
+		int len;
+
+		node->offset = offset;
+		node->phandle = fdt_get_phandle(fdt, offset);
+		if (depth == 0) {
+			node->parent = -1;
+			node->path_hash = FDT_HASH_INIT;
+		} else {
+			name = fdt_get_name(fdt, offset, &len);
+			if (!name) {
+				fdt_index_release(NULL);
+				return len;
+			}
+			node->parent = stack[depth - 1];
+			node->path_hash = _fdt_hash_component(
+				fdt_idx.nodes[node->parent].path_hash, name, len);
+		}
+		stack[depth] = n;
+
+		_fdt_index_insert(fdt_idx.path_slots, node->path_hash, n);
+		if (node->phandle && (node->phandle != (uint32_t)-1))
+			_fdt_index_insert(fdt_idx.phandle_slots,
+					  _fdt_hash_phandle(node->phandle), n);
+	}
+
+	fdt_idx.fdt = fdt;
+	fdt_idx.count = n;
+	fdt_idx.valid = 1;
+
+	return 0;
+}
+
+static int _fdt_index_usable(const void *fdt)
+{
+	return fdt_idx.valid && (fdt_idx.fdt == fdt);
+}
+
+/* Check that the indexed node really is the one path names. */
+static int _fdt_index_path_matches(const void *fdt, int n,
+				   const char *path, int len)
+{
+	const char *end = path + len;
+
+	for (;;) {
+		const char *start, *name;
+		int complen, namelen;
+
+		while ((end > path) && (end[-1] == '/'))
+			end--;
+		if (end == path)
+			return fdt_idx.nodes[n].parent < 0;
+		if (fdt_idx.nodes[n].parent < 0)
+			return 0;
+
+		for (start = end; (start > path) && (start[-1] != '/'); start--)
+			;
+		complen = end - start;
+
+		name = fdt_get_name(fdt, fdt_idx.nodes[n].offset, &namelen);
+		if (!name || (namelen < complen) ||
+		    memcmp(name, start, complen))
+			return 0;
+		if ((namelen != complen) &&
+		    ((name[complen] != '@') || memchr(start, '@', complen)))
+			return 0;
+
+		n = fdt_idx.nodes[n].parent;
+		end = start;
+	}
+}
+
+int _fdt_index_path_offset(const void *fdt, const char *path, int len,
+			   int *offset)
+{
+	const char *p = path, *end = path + len;
+	uint32_t hash = FDT_HASH_INIT;
+	uint32_t i;
+
+	if (!_fdt_index_usable(fdt))
+		return 0;
+
+	while (p < end) {
+		const char *q;
+
+		if (*p == '/') {
+			p++;
+			continue;
+		}
+		q = memchr(p, '/', end - p);
+		if (!q)
+			q = end;
+		hash = _fdt_hash_component(hash, p, q - p);
+		p = q;
+	}
+
+	for (i = hash & fdt_idx.mask; fdt_idx.path_slots[i];
+	     i = (i + 1) & fdt_idx.mask) {
+		int n = fdt_idx.path_slots[i] - 1;
+
+		if ((fdt_idx.nodes[n].path_hash == hash) &&
+		    _fdt_index_path_matches(fdt, n, path, len)) {
+			*offset = fdt_idx.nodes[n].offset;
+			return 1;
+		}
+	}
+
+	*offset = -FDT_ERR_NOTFOUND;
+	return 1;
+}
+
+int _fdt_index_phandle_offset(const void *fdt, uint32_t phandle, int *offset)
+{
+	uint32_t i;
+
+	if (!_fdt_index_usable(fdt))
+		return 0;
+
+	for (i = _fdt_hash_phandle(phandle) & fdt_idx.mask;
+	     fdt_idx.phandle_slots[i]; i = (i + 1) & fdt_idx.mask) {
+		int n = fdt_idx.phandle_slots[i] - 1;
+
+		if (fdt_idx.nodes[n].phandle == phandle) {
+			*offset = fdt_idx.nodes[n].offset;
+			return 1;
+		}
+	}
+
+	*offset = -FDT_ERR_NOTFOUND;
+	return 1;
+}
+
+void _fdt_index_shift(const void *fdt, int offset, int delta)
+{
+	int n;
+
+	if (!_fdt_index_usable(fdt) || !delta)
+		return;
+
+	for (n = 0; n < fdt_idx.count; n++)
+		if (fdt_idx.nodes[n].offset >= offset)
+			fdt_idx.nodes[n].offset += delta;
+}
+
+void _fdt_index_invalidate(const void *fdt)
+{
+	if (fdt_idx.fdt == fdt)
+		fdt_idx.valid = 0;
+}
+
+void _fdt_index_prop_changed(const void *fdt, const char *name, int namelen)
+{
+	if (!_fdt_index_usable(fdt))
+		return;
+
+	if (((namelen == 7) && !memcmp(name, "phandle", 7)) ||
+	    ((namelen == 13) && !memcmp(name, "linux,phandle", 13)))
+		_fdt_index_invalidate(fdt);
+}
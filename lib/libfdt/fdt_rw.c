@@ -129,6 +129,8 @@ static int _fdt_splice_struct(void *fdt, void *p,
 	if ((err = _fdt_splice(fdt, p, oldlen, newlen)))
 		return err;
 
+	_fdt_index_shift(fdt, ((char *)p - (char *)_fdt_offset_ptr(fdt, 0)) + oldlen,
+			 delta);
 	fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + delta);
 	fdt_set_off_dt_strings(fdt, fdt_off_dt_strings(fdt) + delta);
 	return 0;
@@ -268,6 +270,7 @@ int fdt_set_name(void *fdt, int nodeoffset, const char *name)
 		return err;
 
 	memcpy(namep, name, newlen+1);
+	_fdt_index_invalidate(fdt);
 	return 0;
 }
 
@@ -279,6 +282,8 @@ int fdt_setprop(void *fdt, int nodeoffset, const char *name,
 
 	FDT_RW_CHECK_HEADER(fdt);
 
+	_fdt_index_prop_changed(fdt, name, strlen(name));
+
 	err = _fdt_resize_property(fdt, nodeoffset, name, len, &prop);
 	if (err == -FDT_ERR_NOTFOUND)
 		err = _fdt_add_property(fdt, nodeoffset, name, len, &prop);
@@ -297,6 +302,8 @@ int fdt_appendprop(void *fdt, int nodeoffset, const char *name,
 
 	FDT_RW_CHECK_HEADER(fdt);
 
+	_fdt_index_prop_changed(fdt, name, strlen(name));
+
 	prop = fdt_get_property_w(fdt, nodeoffset, name, &oldlen);
 	if (prop) {
 		newlen = len + oldlen;
@@ -324,6 +331,8 @@ int fdt_appendprop_str(void *fdt, int nodeoffset, const char *name,
 
 	FDT_RW_CHECK_HEADER(fdt);
 
+	_fdt_index_prop_changed(fdt, name, strlen(name));
+
 	prop = fdt_get_property_w(fdt, nodeoffset, name, &oldlen);
 	if (prop) {
 		newlen = len + oldlen;
@@ -353,6 +362,8 @@ int fdt_delprop(void *fdt, int nodeoffset, const char *name)
 
 	FDT_RW_CHECK_HEADER(fdt);
 
+	_fdt_index_prop_changed(fdt, name, strlen(name));
+
 	prop = fdt_get_property_w(fdt, nodeoffset, name, &len);
 	if (! prop)
 		return len;
@@ -407,6 +418,7 @@ int fdt_add_subnode_namelen(void *fdt, int parentoffset,
 	endtag = (uint32_t *)((char *)nh + nodelen - FDT_TAGSIZE);
 	*endtag = cpu_to_fdt32(FDT_END_NODE);
 
+	_fdt_index_invalidate(fdt);
 	return offset;
 }
 
@@ -425,6 +437,7 @@ int fdt_del_node(void *fdt, int nodeoffset)
 	if (endoffset < 0)
 		return endoffset;
 
+	_fdt_index_invalidate(fdt);
 	return _fdt_splice_struct(fdt, _fdt_offset_ptr_w(fdt, nodeoffset),
 				  endoffset - nodeoffset, 0);
 }
@@ -467,6 +480,9 @@ int fdt_open_into(const void *fdt, void *buf, int bufsize)
 	fdtend = fdtstart + fdt_totalsize(fdt);
 	FDT_CHECK_HEADER(fdt);
 
+	if (buf != fdt)
+		_fdt_index_invalidate(buf);
+
 	if ((fdt_num_mem_rsv(fdt) + 1) >
 			(int) (UINT_MAX / sizeof(struct fdt_reserve_entry)))
 		return err;
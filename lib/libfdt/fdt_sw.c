@@ -92,6 +92,7 @@ int fdt_create(void *buf, int bufsize)
 	if (bufsize < (int)sizeof(struct fdt_header))
 		return -FDT_ERR_NOSPACE;
 
+	_fdt_index_invalidate(buf);
 	memset(buf, 0, bufsize);
 
 	fdt_set_magic(fdt, FDT_SW_MAGIC);
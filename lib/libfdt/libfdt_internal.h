@@ -67,6 +67,14 @@ int _fdt_check_prop_offset(const void *fdt, int offset);
 const char *_fdt_find_string(const char *strtab, int tabsize, const char *s);
 int _fdt_node_end_offset(void *fdt, int nodeoffset);
 
+/* offset index hooks, see fdt_index.c */
+int _fdt_index_path_offset(const void *fdt, const char *path, int len,
+			   int *offset);
+int _fdt_index_phandle_offset(const void *fdt, uint32_t phandle, int *offset);
+void _fdt_index_shift(const void *fdt, int offset, int delta);
+void _fdt_index_invalidate(const void *fdt);
+void _fdt_index_prop_changed(const void *fdt, const char *name, int namelen);
+
 static inline const void *_fdt_offset_ptr(const void *fdt, int offset)
 {
 	return (const char *)fdt + fdt_off_dt_struct(fdt) + offset;
@@ -0,0 +1,23 @@
+/* crypto/arm_arch.h
+ *
+ * ARM capability bits used to pick between the assembler implementations
+ * at run time. The values follow later OpenSSL releases.
+ */
+#ifndef __ARM_ARCH_H__
+#define __ARM_ARCH_H__
+
+#define ARMV7_NEON	(1<<0)
+#define ARMV8_AES	(1<<2)
+#define ARMV8_SHA1	(1<<3)
+#define ARMV8_SHA256	(1<<4)
+#define ARMV8_PMULL	(1<<5)
+
+#ifndef __ASSEMBLER__
+/* probed on first use by OPENSSL_armcap(); may be masked to force a path */
+extern unsigned int OPENSSL_armcap_P;
+
+void OPENSSL_cpuid_setup(void);
+unsigned int OPENSSL_armcap(void);
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/* crypto/armcap.c
+ *
+ * Bare metal counterpart of the OpenSSL ARM capability probe: there is no
+ * auxv or SIGILL handler to lean on, so read the ID registers directly.
+ */
+#include <arm_arch.h>
+
+unsigned int OPENSSL_armcap_P;
+static int armcap_probed;
+
+void OPENSSL_cpuid_setup(void)
+{
+	unsigned int cap = 0;
+#if ARM_WITH_NEON
+	unsigned int isar5;
+
+	/* cp10/cp11 are enabled by the arch code on every cpu we run on */
+	cap |= ARMV7_NEON;
+
+	/* ID_ISAR5 reads as zero on ARMv7 */
+	__asm__ volatile("mrc	p15, 0, %0, c0, c2, 5" : "=r" (isar5));
+	switch ((isar5 >> 4) & 0xf) {
+	case 2:
+		cap |= ARMV8_PMULL;
+		/* fall through */
+	case 1:
+		cap |= ARMV8_AES;
+	}
+	if (((isar5 >> 8) & 0xf) == 1)
+		cap |= ARMV8_SHA1;
+	if (((isar5 >> 12) & 0xf) == 1)
+		cap |= ARMV8_SHA256;
+#endif
+	OPENSSL_armcap_P = cap;
+	armcap_probed = 1;
+}
+
+unsigned int OPENSSL_armcap(void)
+{
+	if (!armcap_probed)
+		OPENSSL_cpuid_setup();
+	return OPENSSL_armcap_P;
+}
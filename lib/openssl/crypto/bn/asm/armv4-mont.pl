@@ -51,11 +51,11 @@ $_num="$num,#15*4";	$_bpend=$_num;
 $code=<<___;
 .text
 
-.global	bn_mul_mont
-.type	bn_mul_mont,%function
+.global	bn_mul_mont_armv4
+.type	bn_mul_mont_armv4,%function
 
 .align	2
-bn_mul_mont:
+bn_mul_mont_armv4:
 	stmdb	sp!,{r0,r2}		@ sp points at argument block
 	ldr	$num,[sp,#3*4]		@ load num
 	cmp	$num,#2
@@ -191,7 +191,7 @@ bn_mul_mont:
 .Labrt:	tst	lr,#1
 	moveq	pc,lr			@ be binary compatible with V4, yet
 	bx	lr			@ interoperable with Thumb ISA:-)
-.size	bn_mul_mont,.-bn_mul_mont
+.size	bn_mul_mont_armv4,.-bn_mul_mont_armv4
 .asciz	"Montgomery multiplication for ARMv4, CRYPTOGAMS by <appro\@openssl.org>"
 .align	2
 ___
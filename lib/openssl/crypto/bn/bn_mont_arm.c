@@ -0,0 +1,108 @@
+/* crypto/bn/bn_mont_arm.c
+ *
+ * Run time selection of bn_mul_mont(): a NEON Montgomery multiplication
+ * for the moduli used by RSA signature checks, the CRYPTOGAMS ARMv4 code
+ * for everything else.
+ *
+ * The NEON version works on 16 bit halves of the multiplier and of the
+ * reduction factor, so each 32x16 bit product is below 2^48 and the column
+ * sums kept in 64 bit lanes never need a carry pass until the end. The
+ * vector part is bn_mont_neon_madd() in asm/armv7-mont-neon.S; the per
+ * column reduction factors are worked out here. Like sha_arm.c it runs
+ * with interrupts off on the thread cpu, since NEON registers are not
+ * saved across a context switch. That also makes the static column
+ * buffer safe to share.
+ */
+#include <string.h>
+#include <stdint.h>
+#include <arm_arch.h>
+#include <arch/arm.h>
+#include <kernel/thread.h>
+#include "bn_lcl.h"
+
+int bn_mul_mont_armv4(BN_ULONG *rp, const BN_ULONG *ap, const BN_ULONG *bp,
+		const BN_ULONG *np, const BN_ULONG *n0, int num);
+
+#if ARM_WITH_NEON
+/* moduli from 1024 to 4096 bits, in 32 bit words */
+#define BN_MONT_NEON_MIN	32
+#define BN_MONT_NEON_MAX	128
+
+void bn_mont_neon_madd(uint64_t *t, const BN_ULONG *a, const BN_ULONG *n,
+		const uint32_t bm[4], int num);
+
+/* tl[2 * num] followed by th[2 * num], see armv7-mont-neon.S */
+static uint64_t bn_mont_neon_t[4 * BN_MONT_NEON_MAX];
+static BN_ULONG bn_mont_neon_r[BN_MONT_NEON_MAX];
+
+static void bn_mul_mont_neon(BN_ULONG *rp, const BN_ULONG *ap,
+		const BN_ULONG *bp, const BN_ULONG *np, BN_ULONG n0, int num)
+{
+	uint64_t *tl = bn_mont_neon_t;
+	uint64_t *th = tl + 2 * num;
+	BN_ULONG *r = bn_mont_neon_r;
+	uint32_t bm[4];
+	uint64_t c = 0;		/* carry into the current 16 bit column */
+	uint64_t u, v;
+	BN_ULONG borrow;
+	int i;
+
+	memset(tl, 0, 4 * num * sizeof(*tl));
+
+	for (i = 0; i < num; i++) {
+		bm[0] = bp[i] & 0xffff;
+		bm[1] = bp[i] >> 16;
+
+		/*
+		 * Pick the reduction factors that clear the two 16 bit columns
+		 * of word i. Both only depend on word i, so they are found
+		 * with scalar arithmetic before one vector pass adds
+		 * everything in.
+		 */
+		u = tl[i] + (uint64_t)ap[0] * bm[0] + c;
+		bm[2] = ((uint32_t)u * n0) & 0xffff;
+		u += (uint64_t)np[0] * bm[2];
+		c = u >> 16;
+
+		v = th[i] + (uint64_t)ap[0] * bm[1] + c;
+		bm[3] = ((uint32_t)v * n0) & 0xffff;
+		v += (uint64_t)np[0] * bm[3];
+		c = v >> 16;
+
+		bn_mont_neon_madd(tl + i, ap, np, bm, num);
+	}
+
+	/* the result is in columns num .. 2*num-1, plus one carry bit */
+	for (i = 0; i < num; i++) {
+		u = tl[num + i] + c;
+		v = th[num + i] + (u >> 16);
+		r[i] = (BN_ULONG)(u & 0xffff) | (BN_ULONG)(v << 16);
+		c = v >> 16;
+	}
+
+	/* r < 2 * np, subtract np once if needed */
+	borrow = bn_sub_words(rp, r, np, num);
+	if (c < borrow)
+		memcpy(rp, r, num * sizeof(*rp));
+}
+#endif
+
+int bn_mul_mont(BN_ULONG *rp, const BN_ULONG *ap, const BN_ULONG *bp,
+		const BN_ULONG *np, const BN_ULONG *n0, int num)
+{
+#if ARM_WITH_NEON
+	/*
+	 * With interrupts already off this may be a secondary cpu, which
+	 * must not touch the shared column buffer.
+	 */
+	if ((OPENSSL_armcap() & ARMV7_NEON) && !(num & 3) &&
+	    num >= BN_MONT_NEON_MIN && num <= BN_MONT_NEON_MAX &&
+	    !(read_cpsr() & (1<<7))) {
+		enter_critical_section();
+		bn_mul_mont_neon(rp, ap, bp, np, n0[0], num);
+		exit_critical_section();
+		return 1;
+	}
+#endif
+	return bn_mul_mont_armv4(rp, ap, bp, np, n0, num);
+}
@@ -16,7 +16,8 @@ INCLUDES += \
 			-I$(LOCAL_DIR)/../include/openssl \
 			-I$(LOCAL_DIR)/../../openssl
 
-OBJS +=  $(LOCAL_DIR)/bn/asm/armv4-mont.o
+OBJS +=  $(LOCAL_DIR)/bn/asm/armv4-mont.o \
+	$(LOCAL_DIR)/bn/bn_mont_arm.o
 
 OBJS += \
 	$(LOCAL_DIR)/bio/b_print.o \
@@ -317,7 +318,18 @@ OBJS += \
 	$(LOCAL_DIR)/x509v3/v3err.o \
 	$(LOCAL_DIR)/x509v3/v3_utl.o \
 	$(LOCAL_DIR)/sha/asm/sha1-armv4-large.o \
-	$(LOCAL_DIR)/sha/asm/sha256-armv4.o
+	$(LOCAL_DIR)/sha/asm/sha256-armv4.o \
+	$(LOCAL_DIR)/sha/sha_arm.o \
+	$(LOCAL_DIR)/armcap.o
+
+# run time selected SHA-1/SHA-256 and Montgomery multiplication for NEON
+# and ARMv8 Crypto Extensions
+ifeq ($(ARM_CPU),cortex-a8)
+OBJS += \
+	$(LOCAL_DIR)/sha/asm/sha-armv8-ce.o \
+	$(LOCAL_DIR)/sha/asm/sha256-armv7-neon.o \
+	$(LOCAL_DIR)/bn/asm/armv7-mont-neon.o
+endif
 
 include $(LOCAL_DIR)/../android-config.mk
 
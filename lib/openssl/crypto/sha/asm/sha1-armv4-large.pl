@@ -144,11 +144,11 @@ ___
 $code=<<___;
 .text
 
-.global	sha1_block_data_order
-.type	sha1_block_data_order,%function
+.global	sha1_block_data_order_armv4
+.type	sha1_block_data_order_armv4,%function
 
 .align	2
-sha1_block_data_order:
+sha1_block_data_order_armv4:
 	stmdb	sp!,{r4-r12,lr}
 	add	$len,$inp,$len,lsl#6	@ $len to point at the end of $inp
 	ldmia	$ctx,{$a,$b,$c,$d,$e}
@@ -224,7 +224,7 @@ $code.=<<___;
 .LK_20_39:	.word	0x6ed9eba1
 .LK_40_59:	.word	0x8f1bbcdc
 .LK_60_79:	.word	0xca62c1d6
-.size	sha1_block_data_order,.-sha1_block_data_order
+.size	sha1_block_data_order_armv4,.-sha1_block_data_order_armv4
 .asciz	"SHA1 block transform for ARMv4, CRYPTOGAMS by <appro\@openssl.org>"
 .align	2
 ___
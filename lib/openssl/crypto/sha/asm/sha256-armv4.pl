@@ -122,10 +122,10 @@ K256:
 .word	0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 .size	K256,.-K256
 
-.global	sha256_block_data_order
-.type	sha256_block_data_order,%function
-sha256_block_data_order:
-	sub	r3,pc,#8		@ sha256_block_data_order
+.global	sha256_block_data_order_armv4
+.type	sha256_block_data_order_armv4,%function
+sha256_block_data_order_armv4:
+	sub	r3,pc,#8		@ sha256_block_data_order_armv4
 	add	$len,$inp,$len,lsl#6	@ len to point at the end of inp
 	stmdb	sp!,{$ctx,$inp,$len,r4-r12,lr}
 	ldmia	$ctx,{$A,$B,$C,$D,$E,$F,$G,$H}
@@ -170,7 +170,7 @@ $code.=<<___;
 	tst	lr,#1
 	moveq	pc,lr			@ be binary compatible with V4, yet
 	bx	lr			@ interoperable with Thumb ISA:-)
-.size   sha256_block_data_order,.-sha256_block_data_order
+.size   sha256_block_data_order_armv4,.-sha256_block_data_order_armv4
 .asciz  "SHA256 block transform for ARMv4, CRYPTOGAMS by <appro\@openssl.org>"
 .align	2
 ___
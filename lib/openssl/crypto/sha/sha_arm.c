@@ -0,0 +1,195 @@
+/* crypto/sha/sha_arm.c
+ *
+ * Run time selection of the SHA-1/SHA-256 block functions: ARMv8 Crypto
+ * Extensions if ID_ISAR5 has them, then NEON, then the CRYPTOGAMS ARMv4
+ * code as the last resort.
+ *
+ * The kernel does not save NEON registers across a context switch, so on
+ * the thread cpu the NEON paths run with interrupts off, a bounded number
+ * of blocks at a time. Secondary cpus run with interrupts masked and need
+ * no such care.
+ *
+ * SHA256_multi() hashes many equal length messages, four lanes at a time
+ * with NEON when there are no Crypto Extensions to beat it.
+ */
+#include <string.h>
+#include <openssl/sha.h>
+#include <arm_arch.h>
+#include <arch/arm.h>
+#include <kernel/thread.h>
+
+/* blocks hashed per interrupt-off section, about 4KB for CE and 1KB for NEON */
+#define SHA_CE_CHUNK	64
+#define SHA_NEON_CHUNK	16
+
+typedef void (*sha_block_fn)(void *ctx, const void *in, size_t num);
+
+void sha1_block_data_order_armv4(SHA_CTX *c, const void *p, size_t num);
+void sha256_block_data_order_armv4(SHA256_CTX *ctx, const void *in, size_t num);
+#if ARM_WITH_NEON
+/* ctx is a SHA_CTX or SHA256_CTX, see sha-armv8-ce.S and sha256-armv7-neon.S */
+void sha1_block_data_order_armv8(void *ctx, const void *in, size_t num);
+void sha256_block_data_order_armv8(void *ctx, const void *in, size_t num);
+void sha256_block_data_order_neon(void *ctx, const void *in, size_t num);
+void sha256_block_data_order_neon_x4(uint32_t state[32],
+		const unsigned char *const in[4], size_t num);
+
+static void sha_neon_blocks(sha_block_fn fn, void *ctx, const void *in,
+		size_t num, size_t chunk)
+{
+	const unsigned char *p = in;
+	size_t n;
+
+	/* already atomic: irq context, a critical section or a secondary cpu */
+	if (read_cpsr() & (1<<7)) {
+		fn(ctx, p, num);
+		return;
+	}
+
+	while (num) {
+		n = num < chunk ? num : chunk;
+		enter_critical_section();
+		fn(ctx, p, n);
+		exit_critical_section();
+		p += n * SHA_CBLOCK;
+		num -= n;
+	}
+}
+#endif
+
+void sha1_block_data_order(SHA_CTX *c, const void *p, size_t num)
+{
+#if ARM_WITH_NEON
+	if (OPENSSL_armcap() & ARMV8_SHA1) {
+		sha_neon_blocks(sha1_block_data_order_armv8, c, p, num, SHA_CE_CHUNK);
+		return;
+	}
+#endif
+	sha1_block_data_order_armv4(c, p, num);
+}
+
+void sha256_block_data_order(SHA256_CTX *ctx, const void *in, size_t num)
+{
+#if ARM_WITH_NEON
+	unsigned int cap = OPENSSL_armcap();
+
+	if (cap & ARMV8_SHA256) {
+		sha_neon_blocks(sha256_block_data_order_armv8,
+				ctx, in, num, SHA_CE_CHUNK);
+		return;
+	}
+	if (cap & ARMV7_NEON) {
+		sha_neon_blocks(sha256_block_data_order_neon,
+				ctx, in, num, SHA_NEON_CHUNK);
+		return;
+	}
+#endif
+	sha256_block_data_order_armv4(ctx, in, num);
+}
+
+#if ARM_WITH_NEON
+static void sha256_x4_blocks(uint32_t *st, const unsigned char **p, size_t num)
+{
+	size_t n;
+	unsigned l;
+
+	if (read_cpsr() & (1<<7)) {
+		sha256_block_data_order_neon_x4(st, p, num);
+		return;
+	}
+
+	/* four lanes per block, so a quarter of the single message chunk */
+	while (num) {
+		n = num < SHA_NEON_CHUNK / 4 ? num : SHA_NEON_CHUNK / 4;
+		enter_critical_section();
+		sha256_block_data_order_neon_x4(st, p, n);
+		exit_critical_section();
+		for (l = 0; l < 4; l++)
+			p[l] += n * SHA256_CBLOCK;
+		num -= n;
+	}
+}
+
+/* finish four messages that continue from the same prefix state */
+static void sha256_multi_x4(const SHA256_CTX *base,
+		const unsigned char *const *in, size_t len, unsigned char *md)
+{
+	unsigned char blk[4][2 * SHA256_CBLOCK];
+	const unsigned char *p[4];
+	uint32_t st[32];
+	uint64_t bits;
+	size_t head = base->num, off = 0, tail, n;
+	unsigned i, l;
+
+	bits = (((uint64_t)base->Nh << 32) | base->Nl) + (uint64_t)len * 8;
+
+	for (i = 0; i < 8; i++)
+		for (l = 0; l < 4; l++)
+			st[4 * i + l] = base->h[i];
+
+	/* complete the block the prefix left partly filled */
+	if (head && head + len >= SHA256_CBLOCK) {
+		off = SHA256_CBLOCK - head;
+		for (l = 0; l < 4; l++) {
+			memcpy(blk[l], base->data, head);
+			memcpy(blk[l] + head, in[l], off);
+			p[l] = blk[l];
+		}
+		sha256_x4_blocks(st, p, 1);
+		head = 0;
+	}
+
+	n = (len - off) / SHA256_CBLOCK;
+	if (n) {
+		for (l = 0; l < 4; l++)
+			p[l] = in[l] + off;
+		sha256_x4_blocks(st, p, n);
+		off += n * SHA256_CBLOCK;
+	}
+
+	/* the rest, the padding and the bit count in one or two blocks */
+	tail = head + len - off;
+	n = tail < SHA256_CBLOCK - 8 ? 1 : 2;
+	for (l = 0; l < 4; l++) {
+		memcpy(blk[l], base->data, head);
+		memcpy(blk[l] + head, in[l] + off, len - off);
+		blk[l][tail] = 0x80;
+		memset(blk[l] + tail + 1, 0, n * SHA256_CBLOCK - 8 - tail - 1);
+		for (i = 0; i < 8; i++)
+			blk[l][n * SHA256_CBLOCK - 1 - i] = (unsigned char)(bits >> (8 * i));
+		p[l] = blk[l];
+	}
+	sha256_x4_blocks(st, p, n);
+
+	for (l = 0; l < 4; l++)
+		for (i = 0; i < 8; i++) {
+			md[32 * l + 4 * i] = st[4 * i + l] >> 24;
+			md[32 * l + 4 * i + 1] = st[4 * i + l] >> 16;
+			md[32 * l + 4 * i + 2] = st[4 * i + l] >> 8;
+			md[32 * l + 4 * i + 3] = st[4 * i + l];
+		}
+}
+#endif
+
+void SHA256_multi(const unsigned char *prefix, size_t prefix_len,
+	const unsigned char *const *in, size_t len, unsigned char *md, size_t num)
+{
+	SHA256_CTX base, c;
+	size_t i = 0;
+
+	SHA256_Init(&base);
+	SHA256_Update(&base, prefix, prefix_len);
+
+#if ARM_WITH_NEON
+	if ((OPENSSL_armcap() & (ARMV7_NEON | ARMV8_SHA256)) == ARMV7_NEON)
+		for (; i + 4 <= num; i += 4)
+			sha256_multi_x4(&base, in + i, len,
+					md + i * SHA256_DIGEST_LENGTH);
+#endif
+
+	for (; i < num; i++) {
+		c = base;
+		SHA256_Update(&c, in[i], len);
+		SHA256_Final(md + i * SHA256_DIGEST_LENGTH, &c);
+	}
+}
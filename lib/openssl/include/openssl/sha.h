@@ -144,6 +144,9 @@ int SHA256_Update(SHA256_CTX *c, const void *data, size_t len);
 int SHA256_Final(unsigned char *md, SHA256_CTX *c);
 unsigned char *SHA256(const unsigned char *d, size_t n,unsigned char *md);
 void SHA256_Transform(SHA256_CTX *c, const unsigned char *data);
+/* md[32 * i] = SHA-256 of prefix followed by the len bytes at in[i], i < num */
+void SHA256_multi(const unsigned char *prefix, size_t prefix_len,
+	const unsigned char *const *in, size_t len, unsigned char *md, size_t num);
 #endif
 
 #define SHA384_DIGEST_LENGTH	48
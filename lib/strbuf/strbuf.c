@@ -0,0 +1,138 @@
+/*
+ * Growable string buffer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <debug.h>
+#include <err.h>
+#include <lib/strbuf.h>
+
+#define STRBUF_MIN_CAP 64
+
+int strbuf_init(strbuf_t *sb, size_t hint)
+{
+	DEBUG_ASSERT(sb);
+
+	sb->buf = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+
+	return strbuf_reserve(sb, hint);
+}
+
+/* Make sure there is room for extra more bytes plus the terminator */
+int strbuf_reserve(strbuf_t *sb, size_t extra)
+{
+	size_t need;
+	size_t cap;
+	char *buf;
+
+	DEBUG_ASSERT(sb);
+
+	need = sb->len + extra + 1;
+	if (need <= sb->len)
+		return ERR_INVALID_ARGS;
+	if (need <= sb->cap)
+		return NO_ERROR;
+
+	cap = sb->cap ? sb->cap : STRBUF_MIN_CAP;
+	while (cap < need) {
+		if (cap > ((size_t)-1) / 2) {
+			cap = need;
+			break;
+		}
+		cap *= 2;
+	}
+
+	buf = realloc(sb->buf, cap);
+	if (!buf)
+		return ERR_NO_MEMORY;
+
+	if (!sb->buf)
+		buf[0] = '\0';
+	sb->buf = buf;
+	sb->cap = cap;
+
+	return NO_ERROR;
+}
+
+int strbuf_append_len(strbuf_t *sb, const char *str, size_t len)
+{
+	int ret;
+
+	ret = strbuf_reserve(sb, len);
+	if (ret != NO_ERROR)
+		return ret;
+
+	memcpy(sb->buf + sb->len, str, len);
+	sb->len += len;
+	sb->buf[sb->len] = '\0';
+
+	return NO_ERROR;
+}
+
+int strbuf_append(strbuf_t *sb, const char *str)
+{
+	return strbuf_append_len(sb, str, strlen(str));
+}
+
+int strbuf_append_buf(strbuf_t *sb, const strbuf_t *src)
+{
+	if (!src->len)
+		return NO_ERROR;
+
+	return strbuf_append_len(sb, src->buf, src->len);
+}
+
+/* Drop the contents but keep the allocation for reuse */
+void strbuf_reset(strbuf_t *sb)
+{
+	sb->len = 0;
+	if (sb->buf)
+		sb->buf[0] = '\0';
+}
+
+/*
+ * Hand the string over to the caller, who frees it with free(). The
+ * buffer is left empty and may be reused.
+ */
+char *strbuf_detach(strbuf_t *sb, size_t *len)
+{
+	char *buf = sb->buf;
+
+	if (len)
+		*len = sb->len;
+
+	sb->buf = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+
+	return buf;
+}
+
+void strbuf_free(strbuf_t *sb)
+{
+	free(sb->buf);
+	sb->buf = NULL;
+	sb->len = 0;
+	sb->cap = 0;
+}
@@ -53,6 +53,18 @@
 #define PL011_UARTICR (17)
 #define PL011_UARTMACR (18)
 
+/* counter/timers, timer 0 runs at 40MHz, timers 1 and 2 at 1MHz */
+#define INTEGRATOR_TIMER(n) (INTEGRATOR_TIMER_REG_BASE + (n) * 0x100)
+#define TIMER_LOAD(n)    (INTEGRATOR_TIMER(n) + 0x00)
+#define TIMER_VALUE(n)   (INTEGRATOR_TIMER(n) + 0x04)
+#define TIMER_CONTROL(n) (INTEGRATOR_TIMER(n) + 0x08)
+#define TIMER_INTCLR(n)  (INTEGRATOR_TIMER(n) + 0x0c)
+
+#define TIMER_CTRL_ENABLE   (1 << 7)
+#define TIMER_CTRL_PERIODIC (1 << 6)
+#define TIMER_CTRL_INTEN    (1 << 5)
+#define TIMER_CTRL_32BIT    (1 << 1)
+
 #define INT_VECTORS 32 // XXX just made this up
 
 #endif
@@ -22,6 +22,7 @@
  */
 #include <sys/types.h>
 #include <err.h>
+#include <reg.h>
 #include <kernel/thread.h>
 #include <debug.h>
 #include <platform.h>
@@ -37,6 +38,11 @@ static uint32_t ticks_per_interval;
 static platform_timer_callback t_callback;
 static void *callback_arg;
 
+/* timer 1 free runs down from 0xffffffff at 1MHz, extended to 64 bits here */
+#define HIRES_TIMER 1
+static uint32_t hires_last;
+static bigtime_t hires_time;
+
 status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval)
 {
 #if 0
@@ -75,12 +81,30 @@ retry:
 
 	return t;
 #else
-	static time_t time = 0;
-	return time++;
+	return current_time_hires() / 1000;
 #endif
 
 }
 
+/* Return current time in micro seconds */
+bigtime_t current_time_hires(void)
+{
+	uint32_t now;
+	bigtime_t t;
+
+	enter_critical_section();
+
+	/* the counter counts down, so elapsed is last - now, modulo 2^32 */
+	now = readl(TIMER_VALUE(HIRES_TIMER));
+	hires_time += hires_last - now;
+	hires_last = now;
+	t = hires_time;
+
+	exit_critical_section();
+
+	return t;
+}
+
 static enum handler_return os_timer_tick(void *arg)
 {
 	system_time += tick_interval;
@@ -91,6 +115,12 @@ static enum handler_return os_timer_tick(void *arg)
 
 void platform_init_timer(void)
 {
+	/* free running, so it wraps to 0xffffffff rather than reloading */
+	writel(0, TIMER_CONTROL(HIRES_TIMER));
+	writel(0xffffffff, TIMER_LOAD(HIRES_TIMER));
+	writel(TIMER_CTRL_ENABLE | TIMER_CTRL_32BIT, TIMER_CONTROL(HIRES_TIMER));
+	hires_last = readl(TIMER_VALUE(HIRES_TIMER));
+
 #if 0
 	OS_TIMER_CTRL_REG = 0; // stop the timer if it's already running
 
@@ -35,6 +35,7 @@
 #include <arch/arm.h>
 #include <reg.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/interrupts.h>
 
 #include <platform/irqs.h>
@@ -103,7 +104,9 @@ enum handler_return vic_platform_irq(struct arm_iframe *frame)
 	if (num > NR_IRQS_VIC)
 		return 0;
 	writel(1 << (num & 31), (num > 31) ? VIC_INT_CLEAR1 : VIC_INT_CLEAR0);
+	KTRACE(KTRACE_IRQ_ENTER, num, 0);
 	ret = handler[num].func(handler[num].arg);
+	KTRACE(KTRACE_IRQ_EXIT, num, ret);
 	writel(0, VIC_IRQ_VEC_WR);
 	return ret;
 }
@@ -0,0 +1,117 @@
+/*
+ * Memory to memory copies with the ADM data mover
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <reg.h>
+#include <arch/defines.h>
+#include <platform/adm.h>
+#include <lib/dma_memcpy.h>
+#include "adm.h"
+
+extern void udelay(unsigned usecs);
+
+/*
+ * One command list of single item commands per call, each moving up to
+ * ADM_COPY_CHUNK bytes, so a call covers max_len bytes.
+ *
+ * adm_transfer_start() in adm.c is tied to the mmc code and polls in
+ * 10ms steps, far too coarse for copies that finish in a few ms, so the
+ * channel is driven directly here.
+ */
+#define ADM_COPY_CHUNK		0x8000
+#define ADM_COPY_ENTRIES	32
+
+/* 1 sec, as for mmc transfers */
+#define ADM_COPY_POLL_US	10
+#define ADM_COPY_POLLS		100000
+
+/* Must be aligned on 8 byte boundary. */
+static uint32_t copy_cmd_ptr_list[2] __attribute__ ((aligned(8)));
+static uint32_t copy_cmd_list[4 * ADM_COPY_ENTRIES] __attribute__ ((aligned(8)));
+
+static int adm_copy_wait(void)
+{
+	uint32_t polls = ADM_COPY_POLLS;
+	uint32_t rslt;
+
+	do {
+		if (readl(ADM_REG_STATUS(ADM_CHN, ADM_SD)) &
+		    ADM_REG_STATUS__RSLT_VLD___M)
+			break;
+		udelay(ADM_COPY_POLL_US);
+	} while (--polls);
+
+	/* the kernel does not clear ADM interrupts, see adm_transfer_start() */
+	readl(ADM_REG_IRQ(ADM_SD));
+
+	if (!polls)
+		return -1;
+
+	rslt = readl(ADM_REG_RSLT(ADM_CHN, ADM_SD));
+	if ((rslt & ADM_REG_RSLT__ERR___M) ||
+	    !(rslt & ADM_REG_RSLT__TPD___M) ||
+	    !(rslt & ADM_REG_RSLT__V___M))
+		return -1;
+
+	return 0;
+}
+
+static int adm_copy(addr_t dst, addr_t src, size_t len)
+{
+	uint32_t *cmd = copy_cmd_list;
+	uint32_t chunk;
+
+	ASSERT(len && len <= ADM_COPY_CHUNK * ADM_COPY_ENTRIES);
+
+	while (len) {
+		chunk = (len > ADM_COPY_CHUNK) ? ADM_COPY_CHUNK : len;
+
+		cmd[0] = ADM_ADDR_MODE_SI;	/* CMD         */
+		cmd[1] = src;			/* SRC addr    */
+		cmd[2] = dst;			/* DST addr    */
+		cmd[3] = chunk;			/* Length      */
+
+		src += chunk;
+		dst += chunk;
+		len -= chunk;
+		cmd += 4;
+	}
+	cmd[-4] |= ADM_CMD_LIST_LC;
+
+	copy_cmd_ptr_list[0] = (ADM_CMD_PTR_LP | ADM_CMD_PTR_CMD_LIST |
+				(((uint32_t) copy_cmd_list) >> 3));
+
+	/* command list writes must land before the channel is started */
+	dmb();
+
+	writel(((uint32_t) copy_cmd_ptr_list) >> 3,
+	       ADM_REG_CMD_PTR(ADM_CHN, ADM_SD));
+
+	return adm_copy_wait();
+}
+
+const struct dma_memcpy_engine adm_dma_memcpy_engine = {
+	.name = "adm",
+	.align = 8,
+	.max_len = ADM_COPY_CHUNK * ADM_COPY_ENTRIES,
+	.copy = adm_copy,
+};
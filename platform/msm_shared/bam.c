@@ -69,6 +69,48 @@ static enum handler_return bam_interrupt_handler(void* arg)
 	return 0;
 }
 
+/* A non blocking check for an interrupt on a pipe.
+ * bam : BAM instance for the descriptors to be queued.
+ * pipe_num : pipe number for the descriptors to be queued.
+ * interrupt: interrupt to check for.
+ * return : BAM_RESULT_SUCCESS if it fired (it is then cleared),
+ *          BAM_RESULT_TIMEOUT if it has not fired yet.
+ */
+int bam_poll_interrupt(struct bam_instance *bam,
+                       uint8_t pipe_num,
+                       enum p_int_type interrupt)
+{
+	uint32_t val;
+
+	/* Determine the pipe causing the interrupt */
+	val = readl(BAM_IRQ_SRCS(bam->base, bam->ee));
+
+	/* Flush out the right most global interrupt bit */
+	if (!((val & 0x7FFF) & (1 << bam->pipe[pipe_num].pipe_num)))
+		return BAM_RESULT_TIMEOUT;
+
+	/* Check the interrupt type */
+	/* Read interrupt status register */
+	val = readl(BAM_P_IRQ_STTSn(bam->pipe[pipe_num].pipe_num, bam->base));
+
+	/* Check for error */
+	if (val & P_ERR_EN_MASK)
+	{
+		dprintf(CRITICAL, "Unexpected interrupt : val %u\n", val);
+		return BAM_RESULT_FAILURE;
+	}
+
+	if (!(val & interrupt))
+		return BAM_RESULT_TIMEOUT;
+
+	/* Correct interrupt was fired. */
+	/* Clear the other interrupts */
+	val = P_OUT_OF_DESC_EN_MASK | P_PRCSD_DESC_EN_MASK | P_TRNSFR_END_EN_MASK;
+	writel (val, BAM_P_IRQ_CLRn(bam->pipe[pipe_num].pipe_num, bam->base));
+
+	return BAM_RESULT_SUCCESS;
+}
+
 /* A blocking function that waits till an interrupt is signalled.
  * bam : BAM instance for the descriptors to be queued.
  * pipe_num : pipe number for the descriptors to be queued.
@@ -78,39 +120,13 @@ int bam_wait_for_interrupt(struct bam_instance *bam,
                            uint8_t pipe_num,
                            enum p_int_type interrupt)
 {
-	uint32_t val;
-
-	while (1)
-	{
-		/* Wait for a interrupt on the right pipe */
-		do{
-			/* Determine the pipe causing the interrupt */
-			val = readl(BAM_IRQ_SRCS(bam->base, bam->ee));
-			/* Flush out the right most global interrupt bit */
-		} while (!((val & 0x7FFF) & (1 << bam->pipe[pipe_num].pipe_num)));
-
-		/* Check the interrupt type */
-		/* Read interrupt status register */
-		val = readl(BAM_P_IRQ_STTSn(bam->pipe[pipe_num].pipe_num, bam->base));
-
-		/* Check for error */
-		if (val & P_ERR_EN_MASK)
-			goto bam_wait_int_error;
-
-		if (val & interrupt)
-		{
-			/* Correct interrupt was fired. */
-			 /* Clear the other interrupts */
-			val = P_OUT_OF_DESC_EN_MASK | P_PRCSD_DESC_EN_MASK | P_TRNSFR_END_EN_MASK;
-			writel (val, BAM_P_IRQ_CLRn(bam->pipe[pipe_num].pipe_num, bam->base));
-			return BAM_RESULT_SUCCESS;
-		}
-	}
+	int ret;
 
-bam_wait_int_error:
+	do {
+		ret = bam_poll_interrupt(bam, pipe_num, interrupt);
+	} while (ret == BAM_RESULT_TIMEOUT);
 
-	dprintf(CRITICAL, "Unexpected interrupt : val %u\n", val);
-	return BAM_RESULT_FAILURE;
+	return ret;
 }
 
 /* Enable BAM and pipe level interrupts */
@@ -287,12 +303,19 @@ void bam_read_offset_update(struct bam_instance *bam, unsigned int pipe_num)
 {
 	uint32_t offset;
 
-	offset = readl(BAM_P_SW_OFSTSn(bam->pipe[pipe_num].pipe_num, bam->base));
-	offset &= 0xFFFF;
+	offset = bam_read_sw_offset(bam, pipe_num);
 
 	dprintf(SPEW, "Offset value is %d \n", offset);
 }
 
+/* Function to read the byte offset within the FIFO of the first
+ * descriptor the BAM has not processed yet.
+ */
+uint16_t bam_read_sw_offset(struct bam_instance *bam, unsigned int pipe_num)
+{
+	return readl(BAM_P_SW_OFSTSn(bam->pipe[pipe_num].pipe_num, bam->base)) & 0xFFFF;
+}
+
 /* Function to get the next desc address.
  * Keeps track of circular properties of the FIFO
  * and returns the appropriate address.
@@ -475,3 +498,76 @@ struct cmd_element* bam_add_cmd_element(struct cmd_element *ptr,
 	/* Return the address to add the next element to */
 	return ptr + 1;
 }
+
+/* Number of descriptors that can still be written to a FIFO.
+ * sw_offset : byte offset of the first descriptor not yet processed.
+ * Two slots are kept free, like crypto5_get_max_auth_blk_size() assumes,
+ * so a full FIFO never looks empty. FIFO sizes need not be powers of two.
+ */
+static unsigned int bam_fifo_free(struct bam_desc_fifo *fifo, uint16_t sw_offset)
+{
+	uint32_t ring = fifo->size * BAM_DESC_SIZE;
+	uint32_t prod = (fifo->current - fifo->head) * BAM_DESC_SIZE;
+	unsigned int busy = ((prod + ring - sw_offset % ring) % ring) / BAM_DESC_SIZE;
+
+	if (busy + 2 >= fifo->size)
+		return 0;
+
+	return fifo->size - 2 - busy;
+}
+
+/* Function to queue the next part of a scatter-gather list.
+ * bam : BAM instance to be used.
+ * iter : list and position to continue from, advanced past what is queued.
+ * sw_offset : byte offset of the first descriptor not yet processed.
+ * flags : Flags to be set on the last desc of the whole list.
+ * return : number of descriptors written, -1 on error.
+ *
+ * Entries are split at max_desc_len and as many descriptors are written as
+ * the FIFO has room for; call again as the BAM consumes them. Addresses
+ * are converted with PA() and the data caches are left to the caller.
+ *
+ * Note: This function does not notify the BAM about the added descriptors.
+ */
+int bam_add_sg(struct bam_instance *bam,
+               unsigned int pipe_num,
+               struct bam_sg_iter *iter,
+               uint16_t sw_offset,
+               uint8_t flags)
+{
+	const struct bam_sg *sg;
+	unsigned int room;
+	unsigned int n = 0;
+	uint32_t len;
+	uint8_t desc_flags;
+
+	room = bam_fifo_free(&bam->pipe[pipe_num].fifo, sw_offset);
+
+	while (n < room && iter->ent < iter->nents)
+	{
+		sg = &iter->sg[iter->ent];
+
+		len = sg->len - iter->offset;
+		if (len > bam->max_desc_len)
+			len = bam->max_desc_len;
+
+		desc_flags = 0;
+		if (iter->offset + len == sg->len && iter->ent == iter->nents - 1)
+			desc_flags = flags;
+
+		if (bam_add_one_desc(bam, pipe_num,
+							 (unsigned char *)PA((addr_t)(sg->addr + iter->offset)),
+							 len, desc_flags))
+			return -1;
+
+		n++;
+		iter->offset += len;
+		if (iter->offset == sg->len)
+		{
+			iter->ent++;
+			iter->offset = 0;
+		}
+	}
+
+	return n;
+}
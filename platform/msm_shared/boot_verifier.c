@@ -216,9 +216,8 @@ bool boot_verify_compare_sha256(unsigned char *image_ptr,
 cleanup:
 	if (plain_text != NULL)
 		free(plain_text);
-	EVP_cleanup();
-	CRYPTO_cleanup_all_ex_data();
-	ERR_remove_thread_state(NULL);
+	/* keys stay cached across images, see image_rsa_key_cache() */
+	ERR_clear_error();
 	return auth;
 
 }
@@ -312,7 +311,8 @@ static bool verify_image_with_sig(unsigned char* img_addr, uint32_t img_size,
 		{
 			// convert to rsa key format
 			dprintf(INFO, "RSA KEY found from the embedded certificate\n");
-			rsa = EVP_PKEY_get1_RSA(key);
+			rsa = image_rsa_key_cache(EVP_PKEY_get1_RSA(key));
+			EVP_PKEY_free(key);
 			rsa_from_cert = rsa;
 		}
 		else
@@ -388,9 +388,22 @@ static void read_oem_keystore()
 	{
 		oem_keystore = ks;
 		user_keystore = ks;
+		/* set up the Montgomery context now rather than on every boot image */
+		image_rsa_key_prepare(ks->mykeybag->mykey->key_material);
 	}
 }
 
+RSA *boot_verify_get_key(void)
+{
+	read_oem_keystore();
+
+	if (dev_boot_state == YELLOW && rsa_from_cert != NULL)
+		return rsa_from_cert;
+	if (user_keystore == NULL)
+		return NULL;
+	return user_keystore->mykeybag->mykey->key_material;
+}
+
 uint32_t boot_verify_keystore_init()
 {
 	/* Read OEM Keystore */
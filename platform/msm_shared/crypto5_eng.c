@@ -30,6 +30,7 @@
 #include <debug.h>
 #include <endian.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <arch/ops.h>
 #include <platform.h>
 #include <platform/iomap.h>
@@ -280,6 +281,7 @@ void crypto5_init_params(struct crypto_dev *dev, struct crypto_init_params *para
 	dev->ce_array       = crypto_allocate_ce_array(params->num_ce);
 	dev->ce_array_index = 0;
 	dev->cd_start       = 0;
+	dev->sg_state       = CRYPTO_SG_IDLE;
 }
 
 void crypto5_init(struct crypto_dev *dev)
@@ -290,6 +292,9 @@ void crypto5_init(struct crypto_dev *dev)
 	/* Configure CE clocks. */
 	clock_config_ce(dev->instance);
 
+	/* The pipes are reset below, dropping any transfer left in flight. */
+	dev->sg_state = CRYPTO_SG_IDLE;
+
 	/* Setup BAM */
 	if (crypto_bam_init(dev) != CRYPTO_ERR_NONE)
 	{
@@ -534,6 +539,157 @@ CRYPTO_SEND_DATA_ERR:
 	return ret_status;
 }
 
+/* Function: crypto5_send_sg
+ * Arg     : dev, ctx set up by crypto5_set_ctx() for the total length,
+ *           list of sections and number of entries.
+ * Return  : CRYPTO_ERR_NONE once the transfer is started,
+ *           CRYPTO_ERR_NOT_SUPPORTED if the list has to go through
+ *           crypto5_send_data() instead.
+ * Flow    : The auth registers are programmed for the whole length and the
+ *           result dump is queued on the read pipe. The sections then go to
+ *           the write pipe as a single descriptor chain with EOT/NWD only on
+ *           its last descriptor. The chain is written as far as the FIFO
+ *           allows and topped up by crypto5_sg_poll() as the BAM drains it,
+ *           so the caller is free to do other work, e.g. read the next
+ *           image from storage, in between. sg must stay valid until
+ *           crypto5_sg_poll() stops returning CRYPTO_ERR_BUSY.
+ */
+uint32_t crypto5_send_sg(struct crypto_dev *dev,
+						 void *ctx_ptr,
+						 const struct bam_sg *sg,
+						 uint32_t nents)
+{
+	crypto_SHA256_ctx *sha256_ctx = (crypto_SHA256_ctx *) ctx_ptr;
+	uint32_t minor_ver;
+	uint32_t total = 0;
+	uint32_t total_bytes_to_write = 0;
+	uint8_t *buffer = NULL;
+	uint32_t bam_status;
+	uint32_t i;
+
+	if (!nents || dev->sg_state != CRYPTO_SG_IDLE)
+		return CRYPTO_ERR_FAIL;
+
+	/* Bits 23:16 - minor version */
+	minor_ver = (readl(CRYPTO_VERSION(dev->base)) & 0x00FF0000) >> 16;
+
+	for (i = 0; i < nents; i++)
+	{
+		if (!sg[i].len || sg[i].len > UINT_MAX - total)
+			return CRYPTO_ERR_NOT_SUPPORTED;
+
+		/* 5.0.0 needs every desc burst aligned, see crypto5_set_auth_cfg(). */
+		if (minor_ver == 0 &&
+			(((uint32_t) sg[i].addr | sg[i].len) & (CRYPTO_BURST_LEN - 1)))
+			return CRYPTO_ERR_NOT_SUPPORTED;
+
+		total += sg[i].len;
+	}
+
+	if (total != sha256_ctx->bytes_to_write)
+	{
+		dprintf(CRITICAL, "Crypto sg length %u does not match ctx %u\n",
+				total, sha256_ctx->bytes_to_write);
+		return CRYPTO_ERR_FAIL;
+	}
+
+	for (i = 0; i < nents; i++)
+		arch_clean_invalidate_cache_range((addr_t) sg[i].addr, sg[i].len);
+
+	crypto5_set_auth_cfg(dev, &buffer, sg[0].addr, CRYPTO_BURST_LEN - 1, total,
+						 &total_bytes_to_write);
+
+	arch_clean_invalidate_cache_range((addr_t) (dev->dump), sizeof(struct output_dump));
+
+	bam_status = ADD_READ_DESC(&dev->bam,
+							   (unsigned char *)PA((addr_t)(dev->dump)),
+							   sizeof(struct output_dump),
+							   BAM_DESC_INT_FLAG);
+
+	if (bam_status)
+	{
+		dprintf(CRITICAL, "Crypto send sg failed\n");
+		return CRYPTO_ERR_FAIL;
+	}
+
+	dev->sg_iter.sg     = sg;
+	dev->sg_iter.nents  = nents;
+	dev->sg_iter.ent    = 0;
+	dev->sg_iter.offset = 0;
+	dev->sg_state       = CRYPTO_SG_QUEUE;
+
+	if (crypto5_sg_poll(dev) == CRYPTO_ERR_FAIL)
+		return CRYPTO_ERR_FAIL;
+
+	return CRYPTO_ERR_NONE;
+}
+
+/* Function: crypto5_sg_poll
+ * Arg     : dev
+ * Return  : CRYPTO_ERR_BUSY while the transfer started by crypto5_send_sg()
+ *           is in flight, then CRYPTO_ERR_NONE or CRYPTO_ERR_FAIL.
+ * Flow    : Writes descriptors for the rest of the list into the room the
+ *           BAM has made in the write FIFO. Once all are queued, checks
+ *           without blocking for the last data desc and then the dump.
+ */
+uint32_t crypto5_sg_poll(struct crypto_dev *dev)
+{
+	struct bam_instance *bam = &dev->bam;
+	uint8_t wr_flags = BAM_DESC_NWD_FLAG | BAM_DESC_INT_FLAG | BAM_DESC_EOT_FLAG;
+	int ret;
+
+	switch (dev->sg_state)
+	{
+	case CRYPTO_SG_QUEUE:
+		ret = bam_add_sg(bam, CRYPTO_WRITE_PIPE_INDEX, &dev->sg_iter,
+						 bam_read_sw_offset(bam, CRYPTO_WRITE_PIPE_INDEX),
+						 wr_flags);
+		if (ret < 0)
+		{
+			dprintf(CRITICAL, "Crypto send sg failed\n");
+			goto crypto_sg_poll_err;
+		}
+
+		if (ret)
+			bam_sys_gen_event(bam, CRYPTO_WRITE_PIPE_INDEX, ret);
+
+		if (dev->sg_iter.ent == dev->sg_iter.nents)
+			dev->sg_state = CRYPTO_SG_DRAIN;
+
+		return CRYPTO_ERR_BUSY;
+
+	case CRYPTO_SG_DRAIN:
+		ret = bam_poll_interrupt(bam, CRYPTO_WRITE_PIPE_INDEX, P_PRCSD_DESC_EN_MASK);
+		if (ret == BAM_RESULT_FAILURE)
+			goto crypto_sg_poll_err;
+
+		if (ret == BAM_RESULT_SUCCESS)
+			dev->sg_state = CRYPTO_SG_DUMP;
+
+		return CRYPTO_ERR_BUSY;
+
+	case CRYPTO_SG_DUMP:
+		ret = bam_poll_interrupt(bam, CRYPTO_READ_PIPE_INDEX, P_PRCSD_DESC_EN_MASK);
+		if (ret == BAM_RESULT_FAILURE)
+			goto crypto_sg_poll_err;
+
+		if (ret == BAM_RESULT_TIMEOUT)
+			return CRYPTO_ERR_BUSY;
+
+		arch_clean_invalidate_cache_range((addr_t) (dev->dump), sizeof(struct output_dump));
+		dev->sg_state = CRYPTO_SG_IDLE;
+
+		return CRYPTO_ERR_NONE;
+
+	default:
+		return CRYPTO_ERR_FAIL;
+	}
+
+crypto_sg_poll_err:
+	dev->sg_state = CRYPTO_SG_IDLE;
+	return CRYPTO_ERR_FAIL;
+}
+
 void crypto5_cleanup(struct crypto_dev *dev)
 {
 	CLEAR_STATUS(dev);
@@ -93,6 +93,28 @@ void crypto_send_data(void *ctx_ptr,
 	*ret_status = crypto5_send_data(&dev, ctx_ptr, data_ptr);
 }
 
+void crypto_start_sg(void *ctx_ptr,
+					 const struct bam_sg *sg,
+					 unsigned int nents,
+					 crypto_auth_alg_type auth_alg,
+					 unsigned int *ret_status)
+{
+	uint32_t total = 0;
+	unsigned int i;
+
+	for (i = 0; i < nents; i++)
+		total += sg[i].len;
+
+	crypto_set_sha_ctx(ctx_ptr, total, auth_alg, TRUE, TRUE);
+
+	*ret_status = crypto5_send_sg(&dev, ctx_ptr, sg, nents);
+}
+
+void crypto_poll_sg(unsigned int *ret_status)
+{
+	*ret_status = crypto5_sg_poll(&dev);
+}
+
 void crypto_get_digest(unsigned char *digest_ptr,
 					   unsigned int *ret_status,
 					   crypto_auth_alg_type auth_alg,
@@ -27,8 +27,10 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <sha.h>
 #include <debug.h>
+#include <compiler.h>
 #include <sys/types.h>
 #include "crypto_hash.h"
 
@@ -36,6 +38,11 @@ static crypto_SHA256_ctx g_sha256_ctx;
 static crypto_SHA1_ctx g_sha1_ctx;
 static bool crypto_init_done;
 
+/* the hash_find_sg_start() in flight on the engine, and the last result */
+static unsigned char *sg_hash_digest;
+static crypto_auth_alg_type sg_hash_alg;
+static unsigned int sg_hash_status = CRYPTO_ERR_NONE;
+
 extern void ce_clock_init(void);
 
 /*
@@ -76,6 +83,290 @@ hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
 	}
 }
 
+/*
+ * Calculates SHAx digest of the concatenation of the sections in sg, e.g.
+ * kernel, ramdisk and DTB, without copying them together first. Where the
+ * engine supports it the whole list is handed over as one transfer.
+ */
+
+void
+hash_find_sg(const struct bam_sg *sg, unsigned int nents,
+	     unsigned char *digest, unsigned char auth_alg)
+{
+	unsigned int ret_val = CRYPTO_ERR_NOT_SUPPORTED;
+	unsigned int i;
+	SHA_CTX sha1_ctx;
+	SHA256_CTX sha256_ctx;
+
+	if (!nents || (auth_alg != CRYPTO_AUTH_ALG_SHA1 &&
+		       auth_alg != CRYPTO_AUTH_ALG_SHA256)) {
+		dprintf(CRITICAL, "hash_find_sg: invalid params\n");
+		return;
+	}
+
+	if (sg_hash_digest) {
+		dprintf(CRITICAL, "hash_find_sg: engine busy\n");
+		return;
+	}
+
+	if (board_ce_type() == CRYPTO_ENGINE_TYPE_HW) {
+		crypto_init();
+		ret_val = do_sha_sg(sg, nents, digest, auth_alg);
+		if (ret_val == CRYPTO_ERR_NONE)
+			return;
+		if (ret_val != CRYPTO_ERR_NOT_SUPPORTED) {
+			dprintf(CRITICAL, "hash_find_sg returns error %d\n", ret_val);
+			return;
+		}
+	}
+
+	/* Software hashing, also for lists the engine cannot take */
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1) {
+		SHA1_Init(&sha1_ctx);
+		for (i = 0; i < nents; i++)
+			SHA1_Update(&sha1_ctx, sg[i].addr, sg[i].len);
+		SHA1_Final(digest, &sha1_ctx);
+	} else {
+		SHA256_Init(&sha256_ctx);
+		for (i = 0; i < nents; i++)
+			SHA256_Update(&sha256_ctx, sg[i].addr, sg[i].len);
+		SHA256_Final(digest, &sha256_ctx);
+	}
+}
+
+unsigned int
+hash_find_sg_start(const struct bam_sg *sg, unsigned int nents,
+		   unsigned char *digest, unsigned char auth_alg)
+{
+	unsigned int ret_val;
+
+	if (!nents || sg_hash_digest || (auth_alg != CRYPTO_AUTH_ALG_SHA1 &&
+					 auth_alg != CRYPTO_AUTH_ALG_SHA256)) {
+		dprintf(CRITICAL, "hash_find_sg_start: invalid params\n");
+		return CRYPTO_ERR_FAIL;
+	}
+
+	if (board_ce_type() == CRYPTO_ENGINE_TYPE_HW) {
+		crypto_init();
+		ret_val = do_sha_sg_start(sg, nents, auth_alg);
+		if (ret_val == CRYPTO_ERR_NONE) {
+			sg_hash_digest = digest;
+			sg_hash_alg = auth_alg;
+			sg_hash_status = CRYPTO_ERR_BUSY;
+			return CRYPTO_ERR_NONE;
+		}
+		if (ret_val != CRYPTO_ERR_NOT_SUPPORTED) {
+			dprintf(CRITICAL, "hash_find_sg_start returns error %d\n",
+				ret_val);
+			sg_hash_status = ret_val;
+			return ret_val;
+		}
+	}
+
+	hash_find_sg(sg, nents, digest, auth_alg);
+	sg_hash_status = CRYPTO_ERR_NONE;
+	return CRYPTO_ERR_NONE;
+}
+
+/*
+ * Moves the hash started by hash_find_sg_start() along without blocking.
+ * Returns CRYPTO_ERR_BUSY until the digest has been written, then the
+ * result of that hash until the next one is started.
+ */
+
+unsigned int hash_find_sg_poll(void)
+{
+	unsigned int ret_val;
+
+	if (!sg_hash_digest)
+		return sg_hash_status;
+
+	crypto_poll_sg(&ret_val);
+	if (ret_val == CRYPTO_ERR_BUSY)
+		return ret_val;
+
+	if (ret_val == CRYPTO_ERR_NONE)
+		ret_val = do_sha_sg_finish(sg_hash_digest, sg_hash_alg);
+
+	if (ret_val != CRYPTO_ERR_NONE)
+		dprintf(CRITICAL, "hash_find_sg_poll returns error %d\n", ret_val);
+
+	sg_hash_digest = NULL;
+	sg_hash_status = ret_val;
+	return ret_val;
+}
+
+unsigned int hash_find_sg_wait(void)
+{
+	unsigned int ret_val;
+
+	do {
+		ret_val = hash_find_sg_poll();
+	} while (ret_val == CRYPTO_ERR_BUSY);
+
+	return ret_val;
+}
+
+/*
+ * Start a streaming SHAx calculation. The crypto engine is used where the
+ * board has one, otherwise openssl, which picks the ARMv8 / NEON code at
+ * run time where the CPU supports it.
+ */
+
+crypto_result_type hash_init(struct hash_ctx *ctx, unsigned char auth_alg)
+{
+	if (ctx == NULL || (auth_alg != CRYPTO_AUTH_ALG_SHA1 &&
+			    auth_alg != CRYPTO_AUTH_ALG_SHA256))
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	ctx->auth_alg = auth_alg;
+	ctx->engine = board_ce_type();
+	ctx->first = TRUE;
+	ctx->buf_len = 0;
+
+	switch (ctx->engine) {
+	case CRYPTO_ENGINE_TYPE_HW:
+		crypto_init();
+		if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			crypto_sha1_init((crypto_SHA1_ctx *) &ctx->u.hw);
+		else
+			crypto_sha256_init(&ctx->u.hw);
+		break;
+	case CRYPTO_ENGINE_TYPE_SW:
+		if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Init(&ctx->u.sha1);
+		else
+			SHA256_Init(&ctx->u.sha256);
+		break;
+	default:
+		return CRYPTO_SHA_ERR_FAIL;
+	}
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+/*
+ * Hand len bytes to the crypto engine as one operation. Everything but
+ * the last operation must be a multiple of CRYPTO_SHA_BLOCK_SIZE, which
+ * keeps the engine's saved_buff unused.
+ */
+
+static crypto_result_type
+hash_hw_send(struct hash_ctx *ctx, const unsigned char *data,
+	     unsigned int len, bool last)
+{
+	crypto_result_type ret_val;
+
+	ret_val = do_sha_update(&ctx->u.hw, (unsigned char *)data, len,
+				ctx->auth_alg, ctx->first, last);
+	ctx->first = FALSE;
+
+	return ret_val;
+}
+
+crypto_result_type
+hash_update(struct hash_ctx *ctx, const void *data, unsigned int len)
+{
+	const unsigned char *p = data;
+	crypto_result_type ret_val;
+	unsigned int n;
+
+	if (ctx->engine == CRYPTO_ENGINE_TYPE_SW) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Update(&ctx->u.sha1, p, len);
+		else
+			SHA256_Update(&ctx->u.sha256, p, len);
+		return CRYPTO_SHA_ERR_NONE;
+	}
+
+	/* Top up a partial block first; a full one is only sent once more
+	 * data shows it is not the last. */
+	if (ctx->buf_len) {
+		n = MIN(len, CRYPTO_SHA_BLOCK_SIZE - ctx->buf_len);
+		memcpy(ctx->buf + ctx->buf_len, p, n);
+		ctx->buf_len += n;
+		p += n;
+		len -= n;
+
+		if (!len)
+			return CRYPTO_SHA_ERR_NONE;
+
+		ret_val = hash_hw_send(ctx, ctx->buf, CRYPTO_SHA_BLOCK_SIZE, FALSE);
+		if (ret_val != CRYPTO_SHA_ERR_NONE)
+			return ret_val;
+		ctx->buf_len = 0;
+	}
+
+	if (!len)
+		return CRYPTO_SHA_ERR_NONE;
+
+	/* Whole blocks straight from the caller's buffer, keeping 1..64
+	 * bytes back for hash_final(). */
+	n = ((len - 1) / CRYPTO_SHA_BLOCK_SIZE) * CRYPTO_SHA_BLOCK_SIZE;
+	if (n) {
+		ret_val = hash_hw_send(ctx, p, n, FALSE);
+		if (ret_val != CRYPTO_SHA_ERR_NONE)
+			return ret_val;
+		p += n;
+		len -= n;
+	}
+
+	memcpy(ctx->buf, p, len);
+	ctx->buf_len = len;
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+crypto_result_type hash_final(struct hash_ctx *ctx, unsigned char *digest)
+{
+	crypto_result_type ret_val;
+
+	if (ctx->engine == CRYPTO_ENGINE_TYPE_SW) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Final(digest, &ctx->u.sha1);
+		else
+			SHA256_Final(digest, &ctx->u.sha256);
+		return CRYPTO_SHA_ERR_NONE;
+	}
+
+	/* The engine cannot hash an empty message */
+	if (!ctx->buf_len) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1(ctx->buf, 0, digest);
+		else
+			SHA256(ctx->buf, 0, digest);
+		return CRYPTO_SHA_ERR_NONE;
+	}
+
+	ret_val = hash_hw_send(ctx, ctx->buf, ctx->buf_len, TRUE);
+	if (ret_val != CRYPTO_SHA_ERR_NONE) {
+		dprintf(CRITICAL, "hash_final returns error %d\n", ret_val);
+		return ret_val;
+	}
+
+	memcpy(digest, (unsigned char *)ctx->u.hw.auth_iv,
+	       ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1 ? 20 : 32);
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+/*
+ * Defaults for engines without scatter-gather support.
+ */
+
+__WEAK void
+crypto_start_sg(void *ctx_ptr, const struct bam_sg *sg, unsigned int nents,
+		crypto_auth_alg_type auth_alg, unsigned int *ret_status)
+{
+	*ret_status = CRYPTO_ERR_NOT_SUPPORTED;
+}
+
+__WEAK void
+crypto_poll_sg(unsigned int *ret_status)
+{
+	*ret_status = CRYPTO_ERR_FAIL;
+}
+
 /*
  * Function to reset and init crypto engine. It resets the engine for the
  * first time. Used for multiple SHA operations.
@@ -231,6 +522,21 @@ do_sha(unsigned char *buff_ptr,
 {
 	void *ctx_ptr = NULL;
 	crypto_result_type ret_val = CRYPTO_SHA_ERR_NONE;
+	struct bam_sg sg;
+
+	/* Send the whole buffer as one transfer if the engine can */
+	sg.addr = buff_ptr;
+	sg.len = buff_size;
+
+	switch (do_sha_sg(&sg, 1, digest_ptr, auth_alg)) {
+	case CRYPTO_ERR_NONE:
+		return CRYPTO_SHA_ERR_NONE;
+	case CRYPTO_ERR_NOT_SUPPORTED:
+		break;
+	default:
+		dprintf(CRITICAL, "do_sha_sg returns error\n");
+		return CRYPTO_SHA_ERR_FAIL;
+	}
 
 	/* Initialize SHA context based on algorithm */
 	if (auth_alg == CRYPTO_AUTH_ALG_SHA1) {
@@ -263,6 +569,82 @@ do_sha(unsigned char *buff_ptr,
 	return CRYPTO_SHA_ERR_NONE;
 }
 
+/*
+ * Scatter-gather variant of do_sha(). Returns CRYPTO_ERR_NOT_SUPPORTED,
+ * without touching the engine, if it cannot take the list in one go.
+ */
+
+static unsigned int
+do_sha_sg(const struct bam_sg *sg, unsigned int nents,
+	  unsigned char *digest_ptr, crypto_auth_alg_type auth_alg)
+{
+	unsigned int ret_val;
+
+	ret_val = do_sha_sg_start(sg, nents, auth_alg);
+	if (ret_val != CRYPTO_ERR_NONE)
+		return ret_val;
+
+	do {
+		crypto_poll_sg(&ret_val);
+	} while (ret_val == CRYPTO_ERR_BUSY);
+
+	if (ret_val != CRYPTO_ERR_NONE)
+		return ret_val;
+
+	return do_sha_sg_finish(digest_ptr, auth_alg);
+}
+
+static unsigned int
+do_sha_sg_start(const struct bam_sg *sg, unsigned int nents,
+		crypto_auth_alg_type auth_alg)
+{
+	void *ctx_ptr = NULL;
+	unsigned int ret_val = CRYPTO_ERR_NONE;
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1) {
+		crypto_sha1_init(&g_sha1_ctx);
+		ctx_ptr = (void *)&g_sha1_ctx;
+	} else if (auth_alg == CRYPTO_AUTH_ALG_SHA256) {
+		crypto_sha256_init(&g_sha256_ctx);
+		ctx_ptr = (void *)&g_sha256_ctx;
+	}
+
+	crypto_start_sg(ctx_ptr, sg, nents, auth_alg, &ret_val);
+
+	return ret_val;
+}
+
+static unsigned int
+do_sha_sg_finish(unsigned char *digest_ptr, crypto_auth_alg_type auth_alg)
+{
+	void *ctx_ptr;
+	unsigned int ret_val = CRYPTO_ERR_NONE;
+	unsigned int digest_len;
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1) {
+		ctx_ptr = (void *)&g_sha1_ctx;
+		digest_len = 20;
+	} else {
+		ctx_ptr = (void *)&g_sha256_ctx;
+		digest_len = 32;
+	}
+
+	crypto_get_digest((unsigned char *)(((crypto_SHA1_ctx *) ctx_ptr)->auth_iv),
+			  &ret_val, auth_alg, TRUE);
+
+	if (ret_val != CRYPTO_ERR_NONE) {
+		dprintf(CRITICAL,
+			"do_sha_sg returns error from crypto_get_digest\n");
+		return ret_val;
+	}
+
+	memcpy(digest_ptr,
+	       (unsigned char *)(((crypto_SHA1_ctx *) ctx_ptr)->auth_iv),
+	       digest_len);
+
+	return CRYPTO_ERR_NONE;
+}
+
 /*
  * Common function to calculate SHA1 and SHA256 digest based on auth algorithm.
  * Calls crypto engine APIs to setup SHAx registers, send the data and gets
@@ -39,6 +39,7 @@
 #include <kernel/thread.h>
 #include <target.h>
 #include <partial_goods.h>
+#include <lib/bootprof.h>
 
 struct dt_entry_v1
 {
@@ -538,6 +539,161 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 	return NULL;
 }
 
+/*
+ * Returns the total size of the dtbo image whose header is at dtbo,
+ * or 0 if it does not start with a valid dtbo table header.
+ */
+uint32_t dev_tree_dtbo_size(void *dtbo)
+{
+	struct dtbo_table_header *hdr = (struct dtbo_table_header *) dtbo;
+	uint64_t entries_end;
+
+	if (fdt32_to_cpu(hdr->magic) != DTBO_TABLE_MAGIC)
+		return 0;
+
+	if (fdt32_to_cpu(hdr->header_size) < sizeof(struct dtbo_table_header) ||
+		fdt32_to_cpu(hdr->dt_entry_size) < sizeof(struct dtbo_table_entry))
+		return 0;
+
+	entries_end = (uint64_t)fdt32_to_cpu(hdr->dt_entries_offset) +
+		(uint64_t)fdt32_to_cpu(hdr->dt_entry_count) * fdt32_to_cpu(hdr->dt_entry_size);
+	if (entries_end > fdt32_to_cpu(hdr->total_size))
+		return 0;
+
+	return fdt32_to_cpu(hdr->total_size);
+}
+
+static struct dtbo_table_entry *dev_tree_dtbo_match(void *dtbo)
+{
+	struct dtbo_table_header *hdr = (struct dtbo_table_header *) dtbo;
+	struct dtbo_table_entry *entry;
+	struct dtbo_table_entry *fallback = NULL;
+	uint32_t entry_size = fdt32_to_cpu(hdr->dt_entry_size);
+	uint32_t msm_id = board_platform_id() & 0x0000ffff;
+	uint32_t i;
+
+	for (i = 0; i < fdt32_to_cpu(hdr->dt_entry_count); i++)
+	{
+		entry = (struct dtbo_table_entry *)((char *)dtbo +
+			fdt32_to_cpu(hdr->dt_entries_offset) + i * entry_size);
+
+		if (fdt32_to_cpu(entry->id) != board_hardware_id())
+			continue;
+
+		if (fdt32_to_cpu(entry->custom[0]) &&
+			(fdt32_to_cpu(entry->custom[0]) != msm_id))
+			continue;
+
+		if (fdt32_to_cpu(entry->rev) == board_hardware_subtype())
+			return entry;
+
+		if (!fdt32_to_cpu(entry->rev) && !fallback)
+			fallback = entry;
+	}
+
+	return fallback;
+}
+
+/*
+ * Apply the overlay matching this board from the dtbo image to the
+ * device tree at fdt. The tree is composed in the work buffer and only
+ * copied back on success, so fdt is left untouched on any error.
+ *
+ * The dtbo partition is not covered by verified boot, so the overlay is
+ * only applied on an unlocked device; a locked one boots the base tree
+ * its verified boot image came with.
+ *
+ * Return Value: 0 on success, if the device is locked or if no overlay
+ *               matches the board, negative value on failure.
+ */
+int dev_tree_apply_dtbo(void *fdt, void *dtbo, uint32_t dtbo_size, void *work,
+			uint32_t work_size, bool unlocked)
+{
+	struct dtbo_table_entry *entry;
+	void *overlay;
+	uint32_t dt_offset;
+	uint32_t dt_size;
+	uint64_t new_size;
+	int ret;
+
+	if (!unlocked)
+	{
+		dprintf(INFO, "Device is locked, ignoring unverified dtbo\n");
+		return 0;
+	}
+
+	if (!dev_tree_dtbo_size(dtbo) || dev_tree_dtbo_size(dtbo) > dtbo_size)
+	{
+		dprintf(CRITICAL, "ERROR: Invalid dtbo table header\n");
+		return -1;
+	}
+
+	entry = dev_tree_dtbo_match(dtbo);
+	if (!entry)
+	{
+		dprintf(INFO, "No dtbo entry for the board: <%u %u %u>\n",
+			board_platform_id(), board_hardware_id(), board_hardware_subtype());
+		return 0;
+	}
+
+	dt_offset = fdt32_to_cpu(entry->dt_offset);
+	dt_size = fdt32_to_cpu(entry->dt_size);
+	if (((uint64_t)dt_offset + (uint64_t)dt_size) > dev_tree_dtbo_size(dtbo))
+	{
+		dprintf(CRITICAL, "ERROR: dtbo entry out of bounds\n");
+		return -1;
+	}
+
+	overlay = (char *)dtbo + dt_offset;
+	if (fdt_check_header(overlay) || fdt_check_header_ext(overlay) ||
+		(fdt_totalsize(overlay) > dt_size))
+	{
+		dprintf(CRITICAL, "ERROR: Invalid device tree overlay header\n");
+		return -1;
+	}
+
+	new_size = (uint64_t)fdt_totalsize(fdt) + dt_size + DTB_PAD_SIZE;
+	if (new_size > work_size)
+	{
+		dprintf(CRITICAL, "ERROR: No space to apply device tree overlay\n");
+		return -1;
+	}
+
+	ret = fdt_open_into(fdt, work, (int)new_size);
+	if (ret)
+	{
+		dprintf(CRITICAL, "Failed to move/resize dtb buffer: %d\n", ret);
+		return ret;
+	}
+
+	/*
+	 * No index here: merging the overlay adds nodes, which invalidates
+	 * it. update_device_tree() indexes the tree once overlays are in.
+	 */
+	ret = fdt_overlay_apply(work, overlay);
+	if (ret)
+	{
+		dprintf(CRITICAL, "ERROR: Cannot apply device tree overlay: %s\n", fdt_strerror(ret));
+		return ret;
+	}
+
+	fdt_pack(work);
+
+	if (check_aboot_addr_range_overlap((uintptr_t)fdt, fdt_totalsize(work)))
+	{
+		dprintf(CRITICAL, "Error: Fdt addresses overlap with aboot addresses.\n");
+		return -1;
+	}
+
+	dprintf(INFO, "Applied dtbo entry %u/%u/0x%x (%u bytes)\n",
+		fdt32_to_cpu(entry->id), fdt32_to_cpu(entry->rev),
+		fdt32_to_cpu(entry->custom[0]), dt_size);
+
+	memmove(fdt, work, fdt_totalsize(work));
+
+	return 0;
+}
+
 /* Returns 0 if the device tree is valid. */
 int dev_tree_validate(struct dt_table *table, unsigned int page_size, uint32_t *dt_hdr_size)
 {
@@ -1282,6 +1438,54 @@ int dev_tree_add_mem_info(void *fdt, uint32_t offset, uint64_t addr, uint64_t si
 	return ret;
 }
 
+/*
+ * Export the boot profile under /chosen/lk-bootprof so the kernel can
+ * report per-stage bootloader timing. "names" is a string list and
+ * "timestamps-us" holds a <start duration> pair per name. Spans still
+ * open at this point are reported up to now. The data only uses the
+ * existing padding; if it does not fit the node is dropped.
+ */
+static void update_bootprof_node(void *fdt, int chosen)
+{
+	const struct bootprof_span *span;
+	unsigned int count = bootprof_count();
+	unsigned int i;
+	uint32_t times[2];
+	bigtime_t now;
+	int node;
+	int ret = 0;
+
+	if (!count)
+		return;
+
+	node = fdt_add_subnode(fdt, chosen, "lk-bootprof");
+	if (node < 0)
+	{
+		dprintf(CRITICAL, "Failed to add bootprof node: %d\n", node);
+		return;
+	}
+
+	now = current_time_hires();
+	for (i = 0; i < count && !ret; i++)
+	{
+		span = bootprof_get(i);
+		times[0] = cpu_to_fdt32((uint32_t)span->start);
+		times[1] = cpu_to_fdt32((uint32_t)((span->end ? span->end : now) -
+						   span->start));
+
+		ret = fdt_appendprop_string(fdt, node, "names", span->name);
+		if (!ret)
+			ret = fdt_appendprop(fdt, node, "timestamps-us", times,
+					     sizeof(times));
+	}
+
+	if (ret)
+	{
+		dprintf(CRITICAL, "Dropping bootprof node: %d\n", ret);
+		fdt_del_node(fdt, node);
+	}
+}
+
 /* Top level function that updates the device tree. */
 int update_device_tree(void *fdt, const char *cmdline,
 					   void *ramdisk, uint32_t ramdisk_size)
@@ -1311,12 +1515,19 @@ int update_device_tree(void *fdt, const char *cmdline,
 		return ret;
 	}
 
+	/*
+	 * Index the tree so the fixups below don't rescan it for every lookup.
+	 * Any dtbo has been applied by now, so the index stays valid until
+	 * the bootprof node is added at the end.
+	 */
+	fdt_index_build(fdt);
+
 	/* Get offset of the memory node */
 	ret = fdt_path_offset(fdt, "/memory");
 	if (ret < 0)
 	{
 		dprintf(CRITICAL, "Could not find memory node.\n");
-		return ret;
+		goto out;
 	}
 
 	offset = ret;
@@ -1325,7 +1536,7 @@ int update_device_tree(void *fdt, const char *cmdline,
 	if(ret)
 	{
 		dprintf(CRITICAL, "ERROR: Cannot update memory node\n");
-		return ret;
+		goto out;
 	}
 
 	/* Get offset of the chosen node */
@@ -1333,7 +1544,7 @@ int update_device_tree(void *fdt, const char *cmdline,
 	if (ret < 0)
 	{
 		dprintf(CRITICAL, "Could not find chosen node.\n");
-		return ret;
+		goto out;
 	}
 
 	offset = ret;
@@ -1344,7 +1555,7 @@ int update_device_tree(void *fdt, const char *cmdline,
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [bootargs]\n");
-			return ret;
+			goto out;
 		}
 	}
 
@@ -1355,7 +1566,7 @@ int update_device_tree(void *fdt, const char *cmdline,
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-start]\n");
-			return ret;
+			goto out;
 		}
 
 		/* Adding the initrd-end to the chosen node */
@@ -1364,16 +1575,21 @@ int update_device_tree(void *fdt, const char *cmdline,
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-end]\n");
-			return ret;
+			goto out;
 		}
 	}
 
+	update_bootprof_node(fdt, offset);
+
 	fdt_pack(fdt);
 
 #if ENABLE_PARTIAL_GOODS_SUPPORT
 	update_partial_goods_dtb_nodes(fdt);
 #endif
 
+out:
+	fdt_index_release(fdt);
+
 	return ret;
 }
 
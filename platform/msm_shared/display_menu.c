@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <openssl/evp.h>
 #include <dev/fbcon.h>
+#include <dev/keys.h>
 #include <kernel/thread.h>
 #include <display_menu.h>
 #include <menu_keys_detect.h>
@@ -109,12 +110,12 @@ static void wait_for_exit()
 	select_msg = &msg_info;
 
 	mutex_acquire(&select_msg->msg_lock);
-	while(!select_msg->info.rel_exit == true) {
+	if (!select_msg->info.rel_exit) {
+		mutex_release(&select_msg->msg_lock);
+		event_wait(&select_msg->exit_event);
+	} else {
 		mutex_release(&select_msg->msg_lock);
-		thread_sleep(10);
-		mutex_acquire(&select_msg->msg_lock);
 	}
-	mutex_release(&select_msg->msg_lock);
 
 	is_thread_start = false;
 	fbcon_clear();
@@ -138,6 +139,8 @@ void exit_menu_keys_detection()
 	select_msg->info.is_exit = true;
 	mutex_release(&select_msg->msg_lock);
 
+	/* the detect thread is blocked waiting for a key, kick it */
+	keys_wake_waiters();
 	wait_for_exit();
 }
 
@@ -427,6 +430,7 @@ void msg_lock_init()
 
 	if (!is_msg_lock_init) {
 		mutex_init(&msg_lock_info->msg_lock);
+		event_init(&msg_lock_info->exit_event, false, EVENT_FLAG_AUTOUNSIGNAL);
 		is_msg_lock_init = true;
 	}
 }
@@ -436,6 +440,7 @@ static void display_menu_thread_start(struct select_msg_info *msg_info)
 	thread_t *thr;
 
 	if (!is_thread_start) {
+		event_unsignal(&msg_info->exit_event);
 		thr = thread_create("selectkeydetect", &select_msg_keys_detect,
 			(void*)msg_info, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
 		if (!thr) {
@@ -56,20 +56,75 @@ int image_decrypt_signature_rsa(unsigned char *signature_ptr,
 }
 
 /*
- * Returns -1 if decryption failed otherwise size of plain_text in bytes
+ * Public keys used for signature checks are kept for the rest of the boot
+ * together with their Montgomery context, so checking another image with
+ * the same key skips the ASN.1 parsing and the bignum setup.
  */
-static int
-image_decrypt_signature(unsigned char *signature_ptr, unsigned char *plain_text)
+#define IMAGE_KEY_CACHE_SIZE	4
+
+static RSA *image_key_cache[IMAGE_KEY_CACHE_SIZE];
+
+bool image_rsa_key_prepare(RSA *rsa)
 {
-	/*
-	 * Extract Public Key and Decrypt Signature
-	 */
-	int ret = -1;
+	BN_CTX *ctx;
+	bool ret;
+
+	if (rsa == NULL || rsa->n == NULL)
+		return false;
+
+	/* RSA_public_decrypt() only keeps the context for caching keys */
+	if (!(rsa->flags & RSA_FLAG_CACHE_PUBLIC) || rsa->_method_mod_n != NULL)
+		return true;
+
+	ctx = BN_CTX_new();
+	if (ctx == NULL)
+		return false;
+
+	ret = BN_MONT_CTX_set_locked(&rsa->_method_mod_n, CRYPTO_LOCK_RSA,
+			rsa->n, ctx) != NULL;
+	BN_CTX_free(ctx);
+
+	return ret;
+}
+
+RSA *image_rsa_key_cache(RSA *rsa)
+{
+	unsigned i;
+
+	if (rsa == NULL)
+		return NULL;
+
+	for (i = 0; i < IMAGE_KEY_CACHE_SIZE && image_key_cache[i]; i++) {
+		RSA *key = image_key_cache[i];
+
+		if (key == rsa)
+			return key;
+		if (!BN_cmp(key->n, rsa->n) && !BN_cmp(key->e, rsa->e)) {
+			RSA_free(rsa);
+			return key;
+		}
+	}
+
+	image_rsa_key_prepare(rsa);
+
+	/* when the cache is full the key is simply never freed */
+	if (i < IMAGE_KEY_CACHE_SIZE)
+		image_key_cache[i] = rsa;
+
+	return rsa;
+}
+
+/* Public key of the built in certificate, parsed on first use */
+static RSA *image_cert_key(void)
+{
+	static RSA *cert_key;
 	X509 *x509_certificate = NULL;
 	const unsigned char *cert_ptr = (const unsigned char *)certBuffer;
 	unsigned int cert_size = sizeof(certBuffer);
 	EVP_PKEY *pub_key = NULL;
-	RSA *rsa_key = NULL;
+
+	if (cert_key != NULL)
+		return cert_key;
 
 	/*
 	 * Get Pubkey and Convert the internal EVP_PKEY to RSA internal struct
@@ -85,24 +140,65 @@ image_decrypt_signature(unsigned char *signature_ptr, unsigned char *plain_text)
 		goto cleanup;
 	}
 
-	rsa_key = EVP_PKEY_get1_RSA(pub_key);
-	if (rsa_key == NULL) {
-		dprintf(CRITICAL, "ERROR: Boot Invalid, RSA_KEY is NULL!\n");
-		goto cleanup;
-	}
-
-	ret = image_decrypt_signature_rsa(signature_ptr, plain_text, rsa_key);
-	dprintf(SPEW, "DEBUG openssl: Return of RSA_public_decrypt = %d\n",
-		ret);
+	cert_key = image_rsa_key_cache(EVP_PKEY_get1_RSA(pub_key));
 
  cleanup:
-	if (rsa_key != NULL)
-		RSA_free(rsa_key);
 	if (x509_certificate != NULL)
 		X509_free(x509_certificate);
 	if (pub_key != NULL)
 		EVP_PKEY_free(pub_key);
-	return ret;
+	return cert_key;
+}
+
+/*
+ * Returns -1 if decryption failed otherwise size of plain_text in bytes
+ */
+static int
+image_decrypt_signature(unsigned char *signature_ptr, unsigned char *plain_text)
+{
+	/*
+	 * Extract Public Key and Decrypt Signature
+	 */
+	return image_decrypt_signature_rsa(signature_ptr, plain_text,
+			image_cert_key());
+}
+
+static const unsigned char *prefix_addr;
+static uint32_t prefix_len;
+static struct hash_ctx prefix_hash;
+
+void image_set_prefix_hash(const unsigned char *addr, uint32_t len,
+		const struct hash_ctx *ctx)
+{
+	prefix_addr = NULL;
+	if (addr == NULL || ctx == NULL)
+		return;
+
+	memcpy(&prefix_hash, ctx, sizeof(prefix_hash));
+	prefix_len = len;
+	prefix_addr = addr;
+}
+
+/*
+ * Finish the digest from the prefix hash if it covers the start of this
+ * image. Returns false if it does not apply, the caller hashes everything.
+ */
+static bool image_digest_from_prefix(unsigned char *image_ptr,
+		unsigned int image_size, unsigned hash_type, unsigned char *digest)
+{
+	struct hash_ctx ctx;
+
+	if (prefix_addr != image_ptr || prefix_len > image_size ||
+	    prefix_hash.auth_alg != hash_type)
+		return false;
+
+	/* work on a copy, the same image may be checked against several keys */
+	memcpy(&ctx, &prefix_hash, sizeof(ctx));
+	if (hash_update(&ctx, image_ptr + prefix_len,
+			image_size - prefix_len) != CRYPTO_SHA_ERR_NONE)
+		return false;
+
+	return hash_final(&ctx, digest) == CRYPTO_SHA_ERR_NONE;
 }
 
 /* Calculates digest of an image and save it in digest buffer */
@@ -112,7 +208,8 @@ void image_find_digest(unsigned char *image_ptr, unsigned int image_size,
 	/*
 	 * Calculate hash of image and save calculated hash on TZ.
 	 */
-	hash_find(image_ptr, image_size, (unsigned char *)digest, hash_type);
+	if (!image_digest_from_prefix(image_ptr, image_size, hash_type, digest))
+		hash_find(image_ptr, image_size, (unsigned char *)digest, hash_type);
 #ifdef TZ_SAVE_KERNEL_HASH
 	if (hash_type == CRYPTO_AUTH_ALG_SHA256) {
 		save_kernel_hash_cmd(digest);
@@ -177,12 +274,10 @@ image_verify(unsigned char *image_ptr,
 		auth = 1;
 	}
 
-	/* Cleanup after complete usage of openssl - cached data and objects */
+	/* The key stays cached for the next image, only drop openssl errors */
  cleanup:
 	if (plain_text != NULL)
 		free(plain_text);
-	EVP_cleanup();
-	CRYPTO_cleanup_all_ex_data();
-	ERR_remove_thread_state(NULL);
+	ERR_clear_error();
 	return auth;
 }
@@ -242,6 +242,28 @@ struct bam_instance {
 	void (*callback)(int);
 };
 
+/* Scatter-gather list entry, see bam_add_sg().
+ * addr: Virtual address of the data.
+ * len: Length of the data, must not be 0.
+ */
+struct bam_sg {
+	unsigned char *addr;
+	uint32_t len;
+};
+
+/* Position within a scatter-gather list being queued.
+ * sg: The list.
+ * nents: Number of entries in sg.
+ * ent: Entry holding the next byte to be queued.
+ * offset: Bytes of sg[ent] already queued.
+ */
+struct bam_sg_iter {
+	const struct bam_sg *sg;
+	unsigned int nents;
+	unsigned int ent;
+	uint32_t offset;
+};
+
 /* Command element(CE) structure*/
 struct cmd_element {
 	uint32_t addr_n_cmd;
@@ -272,10 +294,19 @@ int bam_add_one_desc(struct bam_instance *bam,
 void bam_sys_gen_event(struct bam_instance *bam,
                        uint8_t pipe_num,
                        unsigned int num_desc);
+int bam_add_sg(struct bam_instance *bam,
+               unsigned int pipe_num,
+               struct bam_sg_iter *iter,
+               uint16_t sw_offset,
+               uint8_t flags);
+int bam_poll_interrupt(struct bam_instance *bam,
+                       uint8_t pipe_num,
+                       enum p_int_type interrupt);
 int bam_wait_for_interrupt(struct bam_instance *bam,
                            uint8_t pipe_num,
                            enum p_int_type interrupt);
 void bam_read_offset_update(struct bam_instance *bam, unsigned int pipe_num);
+uint16_t bam_read_sw_offset(struct bam_instance *bam, unsigned int pipe_num);
 void bam_pipe_reset(struct bam_instance *bam,
 					uint8_t pipe_num);
 
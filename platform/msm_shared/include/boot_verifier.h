@@ -176,6 +176,8 @@ bool boot_verify_validate_keystore(unsigned char * user_addr, unsigned sz);
 /* Function to check if partition is allowed to flash in verified mode */
 bool boot_verify_flash_allowed(const char * entry);
 KEYSTORE *boot_gerity_get_oem_keystore(void);
+/* Key the boot image was verified with, for other images signed alike */
+RSA *boot_verify_get_key(void);
 /* Function to send root of trust to trust zone */
 bool send_rot_command(uint32_t is_unlocked);
 unsigned char* get_boot_fingerprint(unsigned int* buf_size);
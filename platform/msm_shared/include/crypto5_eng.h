@@ -107,6 +107,15 @@ struct crypto_bam_pipes
 	uint8_t write_pipe_grp;
 };
 
+/* States of a scatter-gather transfer, see crypto5_send_sg(). */
+enum crypto_sg_state
+{
+	CRYPTO_SG_IDLE,
+	CRYPTO_SG_QUEUE,	/* data descriptors still to be written */
+	CRYPTO_SG_DRAIN,	/* waiting for the last data descriptor */
+	CRYPTO_SG_DUMP,		/* waiting for the result dump */
+};
+
 struct output_dump
 {
 	uint32_t auth_iv[16];
@@ -127,17 +136,21 @@ struct output_dump
  * dump              : ptr to the result dump memory.
  * bam               : bam instance used with this CE.
  * do_bam_init       : Flag to determine if bam should be initalized.
+ * sg_iter           : position in the list of the scatter-gather transfer in flight.
+ * sg_state          : state of that transfer.
  */
 struct crypto_dev
 {
-	uint32_t            base;
-	uint32_t            instance;
-	struct cmd_element  *ce_array;
-	uint32_t            ce_array_index;
-	uint32_t            cd_start;
-	struct output_dump  *dump;
-	struct bam_instance bam;
-	uint8_t             do_bam_init;
+	uint32_t             base;
+	uint32_t             instance;
+	struct cmd_element   *ce_array;
+	uint32_t             ce_array_index;
+	uint32_t             cd_start;
+	struct output_dump   *dump;
+	struct bam_instance  bam;
+	uint8_t              do_bam_init;
+	struct bam_sg_iter   sg_iter;
+	enum crypto_sg_state sg_state;
 };
 
 /* Struct to pass the initial params to CE.
@@ -171,6 +184,11 @@ void crypto5_set_ctx(struct crypto_dev *dev,
 uint32_t crypto5_send_data(struct crypto_dev *dev,
 						   void *ctx_ptr,
 						   uint8_t *data_ptr);
+uint32_t crypto5_send_sg(struct crypto_dev *dev,
+						 void *ctx_ptr,
+						 const struct bam_sg *sg,
+						 uint32_t nents);
+uint32_t crypto5_sg_poll(struct crypto_dev *dev);
 void crypto5_cleanup(struct crypto_dev *dev);
 uint32_t crypto5_get_digest(struct crypto_dev *dev,
 							uint8_t *digest_ptr,
@@ -29,6 +29,9 @@
 #ifndef __CRYPTO_HASH_H__
 #define __CRYPYO_HASH_H__
 
+#include <bam.h>
+#include <sha.h>
+
 #ifndef NULL
 #define NULL		0
 #endif
@@ -43,6 +46,8 @@
 
 #define CRYPTO_ERR_NONE				0x01
 #define CRYPTO_ERR_FAIL				0x02
+#define CRYPTO_ERR_BUSY				0x03
+#define CRYPTO_ERR_NOT_SUPPORTED		0x04
 
 typedef enum {
 	CRYPTO_FIRST_CHUNK = 1,
@@ -85,6 +90,25 @@ typedef struct {
 	unsigned int auth_iv[8];
 } crypto_SHA256_ctx;
 
+/*
+ * Streaming SHAx context, see hash_init(). Data may be passed to
+ * hash_update() in chunks of any size and alignment; the digest does not
+ * depend on how it is split. The hardware path keeps 1..64 bytes back in
+ * buf so every engine operation but the last is whole blocks.
+ */
+struct hash_ctx {
+	unsigned char auth_alg;
+	crypto_engine_type engine;
+	bool first;
+	unsigned int buf_len;
+	unsigned char buf[CRYPTO_SHA_BLOCK_SIZE];
+	union {
+		crypto_SHA256_ctx hw;	/* also holds a crypto_SHA1_ctx */
+		SHA_CTX sha1;
+		SHA256_CTX sha256;
+	} u;
+};
+
 extern void crypto_eng_reset(void);
 
 extern void crypto_eng_init(void);
@@ -99,6 +123,13 @@ extern void crypto_send_data(void *ctx_ptr,
 			     unsigned int bytes_to_write,
 			     unsigned int *ret_status);
 
+extern void crypto_start_sg(void *ctx_ptr,
+			    const struct bam_sg *sg, unsigned int nents,
+			    crypto_auth_alg_type auth_alg,
+			    unsigned int *ret_status);
+
+extern void crypto_poll_sg(unsigned int *ret_status);
+
 extern void crypto_get_digest(unsigned char *digest_ptr,
 			      unsigned int *ret_status,
 			      crypto_auth_alg_type auth_alg, bool last);
@@ -109,6 +140,10 @@ extern uint32_t crypto_get_max_auth_blk_size(void);
 
 static void crypto_init(void);
 
+static crypto_result_type crypto_sha1_init(crypto_SHA1_ctx *ctx_ptr);
+
+static crypto_result_type crypto_sha256_init(crypto_SHA256_ctx *ctx_ptr);
+
 static crypto_result_type do_sha(unsigned char *buff_ptr,
 				 unsigned int buff_size,
 				 unsigned char *digest_ptr,
@@ -131,10 +166,45 @@ static crypto_result_type crypto_sha1(unsigned char *buff_ptr,
 				      unsigned int buff_size,
 				      unsigned char *digest_ptr);
 
+static unsigned int do_sha_sg(const struct bam_sg *sg,
+			      unsigned int nents,
+			      unsigned char *digest_ptr,
+			      crypto_auth_alg_type auth_alg);
+
+static unsigned int do_sha_sg_start(const struct bam_sg *sg,
+				    unsigned int nents,
+				    crypto_auth_alg_type auth_alg);
+
+static unsigned int do_sha_sg_finish(unsigned char *digest_ptr,
+				     crypto_auth_alg_type auth_alg);
+
 bool crypto_initialized(void);
 void
 hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
           unsigned char auth_alg);
+void
+hash_find_sg(const struct bam_sg *sg, unsigned int nents,
+             unsigned char *digest, unsigned char auth_alg);
+
+/*
+ * hash_find_sg() split in two so the caller can work, e.g. read the next
+ * block from storage, while the engine hashes. One hash may be in flight;
+ * sg and digest must stay valid until hash_find_sg_poll() or
+ * hash_find_sg_wait() returns something other than CRYPTO_ERR_BUSY; both
+ * keep returning that result until the next hash_find_sg_start().
+ * Without an engine, or for a list it cannot take, hash_find_sg_start()
+ * hashes in software before returning.
+ */
+unsigned int
+hash_find_sg_start(const struct bam_sg *sg, unsigned int nents,
+                   unsigned char *digest, unsigned char auth_alg);
+unsigned int hash_find_sg_poll(void);
+unsigned int hash_find_sg_wait(void);
+
+crypto_result_type hash_init(struct hash_ctx *ctx, unsigned char auth_alg);
+crypto_result_type hash_update(struct hash_ctx *ctx, const void *data,
+			       unsigned int len);
+crypto_result_type hash_final(struct hash_ctx *ctx, unsigned char *digest);
 
 crypto_engine_type board_ce_type(void);
 #endif
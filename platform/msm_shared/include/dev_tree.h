@@ -46,6 +46,9 @@
 
 #define DTB_PAD_SIZE            1024
 
+/* Android dtbo partition: a table of device tree overlays (big endian) */
+#define DTBO_TABLE_MAGIC        0xd7b7ab1e
+
 /*
  * For DTB V1: The DTB entries would be of the format
  * qcom,msm-id = <msm8974, CDP, rev_1>; (3 * sizeof(uint32_t))
@@ -88,6 +91,32 @@ struct dt_table
 	uint32_t num_entries;
 };
 
+struct dtbo_table_header
+{
+	uint32_t magic;
+	uint32_t total_size;
+	uint32_t header_size;
+	uint32_t dt_entry_size;
+	uint32_t dt_entry_count;
+	uint32_t dt_entries_offset;
+	uint32_t page_size;
+	uint32_t version;
+};
+
+/*
+ * id is matched against the board hardware id, rev against the board
+ * hardware subtype and custom[0] against the msm id (0 matches any soc).
+ * An entry with rev 0 is used when no subtype specific overlay exists.
+ */
+struct dtbo_table_entry
+{
+	uint32_t dt_size;
+	uint32_t dt_offset;
+	uint32_t id;
+	uint32_t rev;
+	uint32_t custom[4];
+};
+
 struct plat_id
 {
 	uint32_t platform_id;
@@ -143,4 +172,7 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 int update_device_tree(void *fdt, const char *, void *, unsigned);
 int dev_tree_add_mem_info(void *fdt, uint32_t offset, uint64_t size, uint64_t addr);
 void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset, void *tags);
+uint32_t dev_tree_dtbo_size(void *dtbo);
+int dev_tree_apply_dtbo(void *fdt, void *dtbo, uint32_t dtbo_size, void *work,
+			uint32_t work_size, bool unlocked);
 #endif
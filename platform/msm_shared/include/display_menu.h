@@ -31,6 +31,7 @@
 
 #include <openssl/evp.h>
 #include <kernel/mutex.h>
+#include <kernel/event.h>
 
 #define SELECT_OPTION_MAX	5
 
@@ -62,6 +63,7 @@ struct select_msg_info {
 	struct menu_info	info;
 	uint32_t		last_msg_type;
 	mutex_t			msg_lock;
+	event_t			exit_event;	/* signalled once rel_exit is set */
 };
 
 void wait_for_users_action(void);
@@ -40,10 +40,32 @@ int image_verify(unsigned char *image_ptr,
 		 unsigned char *signature_ptr,
 		 unsigned int image_size, unsigned hash_type);
 
+/* Precompute the Montgomery context RSA_public_decrypt() uses for rsa */
+bool image_rsa_key_prepare(RSA *rsa);
+
+/*
+ * Keep rsa for the rest of the boot. Takes over the caller's reference and
+ * returns the cached key with the same modulus and exponent if there is
+ * one. The returned key must not be freed.
+ */
+RSA *image_rsa_key_cache(RSA *rsa);
+
 /* Decrypt signature with RSA public key */
 int image_decrypt_signature_rsa(unsigned char *signature_ptr,
 		unsigned char *plain_text, RSA *rsa_key);
 
+struct hash_ctx;
+
+/*
+ * Hash state covering the first len bytes at addr, e.g. computed while the
+ * image was received. image_find_digest() continues from it instead of
+ * hashing those bytes again when asked for the same algorithm over a range
+ * starting at addr. The caller must drop it (addr NULL) before the memory
+ * is reused.
+ */
+void image_set_prefix_hash(const unsigned char *addr, uint32_t len,
+		const struct hash_ctx *ctx);
+
 /* Find hash of image */
 void image_find_digest(unsigned char *image_ptr, unsigned int image_size,
 		unsigned hash_type, unsigned char *digest);
@@ -37,9 +37,12 @@
 
 void qtimer_set_physical_timer(time_t msecs_interval,
 	platform_timer_callback tmr_callback, void *tmr_arg);
+void qtimer_set_oneshot_timer(uint32_t ticks,
+	platform_timer_callback tmr_callback, void *tmr_arg);
 void qtimer_disable(void);
 uint64_t qtimer_get_phy_timer_cnt(void);
 uint32_t qtimer_current_time(void);
+time_t qtimer_counter_time(void);
 uint32_t qtimer_get_frequency(void);
 void qtimer_uninit(void);
 void qtimer_init(void);
@@ -400,6 +400,7 @@ int restore_secure_cfg(uint32_t id);
 
 void scm_elexec_call(paddr_t kernel_entry, paddr_t dtb_offset);
 void *get_canary(void);
+int scm_random(uint32_t * rbuf, uint32_t  r_len);
 /* API to configure XPU violations as fatal */
 int scm_xpu_err_fatal_init(void);
 
@@ -0,0 +1,108 @@
+/*
+ * dm-verity hash tree verification
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __VERITY_H
+#define __VERITY_H
+
+#include <sys/types.h>
+#include <rsa.h>
+
+/*
+ * Android verity layout: the filesystem (data_blocks blocks), then a 32KB
+ * metadata area holding the signed dm-verity table, then the hash tree
+ * with its top level first. Every block hash is SHA-256 over the salt
+ * followed by the block, as with dm-verity format version 1.
+ */
+#define VERITY_METADATA_SIZE		32768
+#define VERITY_METADATA_MAGIC		0xb001b001
+#define VERITY_METADATA_MAGIC_DISABLE	0x46464f56
+#define VERITY_SIGNATURE_SIZE		256
+#define VERITY_TABLE_MAX		1024
+#define VERITY_SALT_MAX			128
+#define VERITY_LEVELS_MAX		16
+
+enum verity_error {
+	VERITY_OK = 0,
+	VERITY_ERR_IO = -1,
+	VERITY_ERR_FORMAT = -2,
+	VERITY_ERR_SIGNATURE = -3,
+	VERITY_ERR_HASH = -4,
+	VERITY_ERR_NOMEM = -5,
+	VERITY_ERR_DISABLED = -6,
+	VERITY_ERR_UNSIGNED = -7,	/* hashes match a table nobody signed */
+};
+
+struct verity;
+
+/* read len bytes at offset from v->base */
+typedef int (*verity_read_fn)(struct verity *v, uint64_t offset, void *buf,
+		uint32_t len);
+
+struct verity {
+	verity_read_fn read;
+	void *arg;
+	uint64_t base;			/* e.g. the partition offset */
+	uint64_t size;			/* bytes from base that may be read */
+
+	uint32_t block_size;		/* data and hash blocks */
+	uint64_t data_blocks;
+	uint64_t hash_start;		/* first hash block */
+	unsigned char root[32];
+	unsigned char salt[VERITY_SALT_MAX];
+	uint32_t salt_len;
+	bool signature_checked;
+
+	/* level 0 hashes the data, level levels - 1 is the single top block */
+	unsigned int levels;
+	uint64_t level_blocks[VERITY_LEVELS_MAX];
+	uint64_t level_start[VERITY_LEVELS_MAX];	/* within the tree */
+	uint64_t tree_blocks;
+};
+
+/*
+ * Find the metadata after the ext4 filesystem on the device, check the
+ * table signature when key is not NULL and set up the tree geometry.
+ * Without a key the table, and so the root digest, is only as good as
+ * the partition it was read from: verity_verify() then never returns
+ * VERITY_OK.
+ */
+int verity_init(struct verity *v, verity_read_fn read, void *arg,
+		uint64_t base, uint64_t size, RSA *key);
+
+/* verity_init() on a partition of the boot device */
+int verity_init_partition(struct verity *v, const char *name, RSA *key);
+
+/*
+ * Load the hash tree into buf and check it down from the root, then hash
+ * the data against it. If everything matches but the table signature was
+ * not checked, the result is VERITY_ERR_UNSIGNED. sample is 1 to check every data block; larger
+ * values check about one chunk of data in sample, picked afresh on every
+ * call from a scm_random() seed.
+ * buf must hold the tree plus a read buffer, see verity_buf_size().
+ */
+int verity_verify(struct verity *v, uint32_t sample, void *buf,
+		size_t buf_size);
+
+uint64_t verity_buf_size(const struct verity *v);
+const char *verity_strerror(int err);
+
+#endif
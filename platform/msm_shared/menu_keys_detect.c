@@ -27,6 +27,7 @@
 */
 
 #include <debug.h>
+#include <err.h>
 #include <reg.h>
 #include <stdlib.h>
 #include <pm8x41.h>
@@ -55,18 +56,30 @@ extern uint32_t target_volume_down();
 extern void reboot_device(unsigned reboot_reason);
 extern void shutdown_device();
 
-typedef uint32_t (*keys_detect_func)(void);
 typedef void (*keys_action_func)(struct select_msg_info* msg_info);
 
-struct keys_stru {
-	int type;
-	keys_detect_func keys_pressed_func;
-};
+static int menu_read_volume_up(void)
+{
+	return target_volume_up();
+}
+
+static int menu_read_volume_down(void)
+{
+	return target_volume_down();
+}
 
-struct keys_stru keys[] = {
-	{VOLUME_UP, (uint32_t (*)(void))target_volume_up},
-	{VOLUME_DOWN, target_volume_down},
-	{POWER_KEY, pm8x41_get_pwrkey_is_pressed},
+static int menu_read_power_key(void)
+{
+	return pm8x41_get_pwrkey_is_pressed();
+}
+
+/* no pmic interrupt plumbing yet, so these are scanned by dev/keys while
+ * the menu thread is blocked in keys_wait_event()
+ */
+static struct key_source menu_key_sources[] = {
+	[VOLUME_UP] = { .code = KEY_VOLUMEUP, .read = menu_read_volume_up },
+	[VOLUME_DOWN] = { .code = KEY_VOLUMEDOWN, .read = menu_read_volume_down },
+	[POWER_KEY] = { .code = KEY_POWER, .read = menu_read_power_key },
 };
 
 struct pages_action {
@@ -95,20 +108,6 @@ static uint32_t unlock_index_action[] = {
 		[1] = RESTART,
 };
 
-static int is_key_pressed(int keys_type)
-{
-	int count = 0;
-
-	if (keys[keys_type].keys_pressed_func()) {
-		/*if key is pressed, wait for 1 second to see if it is released*/
-		while(count++ < 10 && keys[keys_type].keys_pressed_func())
-			thread_sleep(100);
-		return 1;
-	}
-
-	return 0;
-}
-
 static void update_device_status(struct select_msg_info* msg_info, int reason)
 {
 	fbcon_clear();
@@ -331,64 +330,96 @@ static struct pages_action menu_pages_action[] = {
 
 };
 
+static bool menu_keys_pressed(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(menu_key_sources); i++) {
+		if (keys_get_state(menu_key_sources[i].code))
+			return true;
+	}
+
+	return false;
+}
+
 void keys_detect_init()
 {
-	/* Waiting for all keys are released */
-	while(1) {
-		if(!keys[VOLUME_UP].keys_pressed_func() &&
-			!keys[VOLUME_DOWN].keys_pressed_func() &&
-			!keys[POWER_KEY].keys_pressed_func()) {
-			break;
-		}
-		thread_sleep(KEY_DETECT_FREQUENCY);
+	static bool sources_registered = false;
+	struct key_event ev;
+	uint32_t i;
+
+	if (!sources_registered) {
+		for (i = 0; i < ARRAY_SIZE(menu_key_sources); i++)
+			keys_register_source(&menu_key_sources[i],
+				menu_key_sources[i].code, menu_key_sources[i].read, false);
+		sources_registered = true;
 	}
 
+	/* Waiting for all keys are released */
+	while (menu_keys_pressed())
+		keys_wait_event(&ev, KEY_DETECT_FREQUENCY);
+
+	/* drop anything posted at boot or while the keys were held */
+	keys_flush_events();
 	before_time = current_time();
 }
 
 int select_msg_keys_detect(void *param) {
 	struct select_msg_info *msg_info = (struct select_msg_info*)param;
+	struct key_event ev;
+	time_t timeout;
+	time_t elapsed;
 
 	msg_lock_init();
 	keys_detect_init();
 	while(1) {
-		/* 1: update select option's index, default it is the total option number
-		 *  volume up: index decrease, the option will scroll up from
-		 * 	the bottom to top if the key is pressed firstly.
-		 *	eg: 5->4->3->2->1->0
-		 *  volume down: index increase, the option will scroll down from
-		 * 	the bottom to top if the key is pressed firstly.
-		 *	eg: 5->0
-		 * 2: update device's status via select option's index
-		 */
-		if (is_key_pressed(VOLUME_UP)) {
-			mutex_acquire(&msg_info->msg_lock);
-			menu_pages_action[msg_info->info.msg_type].up_action_func(msg_info);
-			mutex_release(&msg_info->msg_lock);
-		} else if (is_key_pressed(VOLUME_DOWN)) {
-			mutex_acquire(&msg_info->msg_lock);
-			menu_pages_action[msg_info->info.msg_type].down_action_func(msg_info);
-			mutex_release(&msg_info->msg_lock);
-		} else if (is_key_pressed(POWER_KEY)) {
-			mutex_acquire(&msg_info->msg_lock);
-			menu_pages_action[msg_info->info.msg_type].enter_action_func(msg_info);
-			mutex_release(&msg_info->msg_lock);
-		}
-
 		mutex_acquire(&msg_info->msg_lock);
 		/* Never time out if the timeout_time is 0 */
+		timeout = INFINITE_TIME;
 		if(msg_info->info.timeout_time) {
-			if ((current_time() - before_time) > msg_info->info.timeout_time)
+			elapsed = current_time() - before_time;
+			if (elapsed > msg_info->info.timeout_time)
 				msg_info->info.is_exit = true;
+			else
+				timeout = msg_info->info.timeout_time - elapsed + 1;
 		}
 
 		if (msg_info->info.is_exit) {
 			msg_info->info.rel_exit = true;
 			mutex_release(&msg_info->msg_lock);
+			event_signal(&msg_info->exit_event, true);
 			break;
 		}
 		mutex_release(&msg_info->msg_lock);
-		thread_sleep(KEY_DETECT_FREQUENCY);
+
+		/* sleep until a key goes down, the menu times out or
+		 * exit_menu_keys_detection() wakes us up
+		 */
+		if (keys_wait_event(&ev, timeout) != NO_ERROR || !ev.value)
+			continue;
+
+		/* 1: update select option's index, default it is the total option number
+		 *  volume up: index decrease, the option will scroll up from
+		 * 	the bottom to top if the key is pressed firstly.
+		 *	eg: 5->4->3->2->1->0
+		 *  volume down: index increase, the option will scroll down from
+		 * 	the bottom to top if the key is pressed firstly.
+		 *	eg: 5->0
+		 * 2: update device's status via select option's index
+		 */
+		mutex_acquire(&msg_info->msg_lock);
+		switch (ev.code) {
+			case KEY_VOLUMEUP:
+				menu_pages_action[msg_info->info.msg_type].up_action_func(msg_info);
+				break;
+			case KEY_VOLUMEDOWN:
+				menu_pages_action[msg_info->info.msg_type].down_action_func(msg_info);
+				break;
+			case KEY_POWER:
+				menu_pages_action[msg_info->info.msg_type].enter_action_func(msg_info);
+				break;
+		}
+		mutex_release(&msg_info->msg_lock);
 	}
 
 	return 0;
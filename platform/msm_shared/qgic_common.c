@@ -31,6 +31,7 @@
 #include <bits.h>
 #include <arch/arm.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <platform/irqs.h>
 #include <platform/iomap.h>
 #include <qgic.h>
@@ -86,7 +87,9 @@ enum handler_return gic_platform_irq(struct arm_iframe *frame)
 	if (num >= NR_IRQS)
 		return 0;
 
+	KTRACE(KTRACE_IRQ_ENTER, num, 0);
 	ret = handler[num].func(handler[num].arg);
+	KTRACE(KTRACE_IRQ_EXIT, num, ret);
 
 	/* End of interrupt */
 	qgic_write_eoi(num);
@@ -30,6 +30,7 @@
 #include <reg.h>
 #include <compiler.h>
 #include <qtimer.h>
+#include <platform.h>
 #include <kernel/thread.h>
 
 static uint32_t ticks_per_sec;
@@ -46,10 +47,47 @@ status_t platform_set_periodic_timer(platform_timer_callback callback,
 	return 0;
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* longest shot, well inside the signed 32 bit TVAL range */
+#define QTMR_MAX_ONESHOT_US	(60 * 1000000ULL)
+
+status_t platform_set_oneshot_timer(platform_timer_callback callback,
+	void *arg, bigtime_t interval)
+{
+	uint64_t ticks;
+
+	/* the kernel reprograms on an early expiry, so clamping is safe */
+	if (interval > QTMR_MAX_ONESHOT_US)
+		interval = QTMR_MAX_ONESHOT_US;
+
+	ticks = (interval * ticks_per_sec) / 1000000;
+	if (!ticks)
+		ticks = 1;
+
+	enter_critical_section();
+
+	qtimer_set_oneshot_timer((uint32_t)ticks, callback, arg);
+
+	exit_critical_section();
+	return 0;
+}
+
+void platform_stop_timer(void)
+{
+	qtimer_disable();
+}
+
+/* No periodic tick to count, so derive ms from the counter */
+time_t current_time(void)
+{
+	return qtimer_counter_time();
+}
+#else
 time_t current_time(void)
 {
 	return qtimer_current_time();
 }
+#endif
 
 void qtimer_uninit()
 {
@@ -112,10 +150,24 @@ void udelay(unsigned usecs)
 	delay(ticks);
 }
 
+/* Return current time in ms, read from the counter */
+time_t qtimer_counter_time(void)
+{
+	return current_time_hires() / 1000;
+}
+
 /* Return current time in micro seconds */
 bigtime_t current_time_hires(void)
 {
-	return qtimer_current_time() * 1000000ULL;
+	uint64_t cnt;
+
+	if (!ticks_per_sec)
+		return qtimer_current_time() * 1000ULL;
+
+	/* Split the conversion so cnt * 10^6 cannot overflow */
+	cnt = qtimer_get_phy_timer_cnt();
+	return (cnt / ticks_per_sec) * 1000000ULL +
+		((cnt % ticks_per_sec) * 1000000ULL) / ticks_per_sec;
 }
 
 void qtimer_init()
@@ -40,12 +40,19 @@ static time_t timer_interval;
 /* time in ms from start of LK. */
 static volatile uint32_t current_time;
 static uint32_t tick_count;
+/* interrupt fires once per qtimer_set_oneshot_timer() call */
+static bool oneshot;
 
 extern void isb();
 static void qtimer_enable();
 
 static enum handler_return qtimer_irq(void *arg)
 {
+	if (oneshot) {
+		qtimer_disable();
+		return timer_callback(timer_arg, qtimer_counter_time());
+	}
+
 	current_time += timer_interval;
 
 	/* Program the down counter again to get
@@ -67,6 +74,7 @@ void qtimer_set_physical_timer(time_t msecs_interval,
 	void *tmr_arg)
 {
 	/* Save the timer interval and call back data*/
+	oneshot = false;
 	tick_count = msecs_interval * qtimer_tick_rate() / 1000;;
 	timer_interval = msecs_interval;
 	timer_arg = tmr_arg;
@@ -86,6 +94,23 @@ void qtimer_set_physical_timer(time_t msecs_interval,
 	return;
 
 }
+/* Programs the timer to expire once, ticks counter ticks from now. */
+void qtimer_set_oneshot_timer(uint32_t ticks,
+	platform_timer_callback tmr_callback,
+	void *tmr_arg)
+{
+	oneshot = true;
+	timer_arg = tmr_arg;
+	timer_callback = tmr_callback;
+
+	__asm__ volatile("mcr p15, 0, %0, c14, c2, 0" : :"r" (ticks));
+	isb();
+
+	qtimer_enable();
+
+	register_int_handler(INT_QTMR_NON_SECURE_PHY_TIMER_EXP, qtimer_irq, 0);
+	unmask_interrupt(INT_QTMR_NON_SECURE_PHY_TIMER_EXP);
+}
 
 static void qtimer_enable()
 {
@@ -42,11 +42,18 @@ static time_t timer_interval;
 /* time in ms from start of LK. */
 static volatile uint32_t current_time;
 static uint32_t tick_count;
+/* interrupt fires once per qtimer_set_oneshot_timer() call */
+static bool oneshot;
 
 static void qtimer_enable(void);
 
 static enum handler_return qtimer_irq(void *arg)
 {
+	if (oneshot) {
+		qtimer_disable();
+		return timer_callback(timer_arg, qtimer_counter_time());
+	}
+
 	current_time += timer_interval;
 
 	/* Program the down counter again to get
@@ -69,6 +76,7 @@ void qtimer_set_physical_timer(time_t msecs_interval,
 	qtimer_disable();
 
 	/* Save the timer interval and call back data*/
+	oneshot = false;
 	tick_count = msecs_interval * qtimer_tick_rate() / 1000;;
 	timer_interval = msecs_interval;
 	timer_arg = tmr_arg;
@@ -85,6 +93,30 @@ void qtimer_set_physical_timer(time_t msecs_interval,
 	qtimer_enable();
 }
 
+/* Programs the timer to expire once, ticks counter ticks from now. */
+void qtimer_set_oneshot_timer(uint32_t ticks,
+							  platform_timer_callback tmr_callback,
+							  void *tmr_arg)
+{
+	static bool registered;
+
+	qtimer_disable();
+
+	oneshot = true;
+	timer_arg = tmr_arg;
+	timer_callback = tmr_callback;
+
+	writel(ticks, QTMR_V1_CNTP_TVAL);
+	dsb();
+
+	if (!registered) {
+		register_int_handler(INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP, qtimer_irq, 0);
+		unmask_interrupt(INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP);
+		registered = true;
+	}
+
+	qtimer_enable();
+}
 
 /* Function to return the frequency of the timer */
 uint32_t qtimer_get_frequency(void)
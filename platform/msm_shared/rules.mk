@@ -23,6 +23,16 @@ OBJS += \
 	$(LOCAL_DIR)/qgic_common.o \
 	$(LOCAL_DIR)/crc32.o
 
+# aboot and fbcon copy through dma_memcpy(). Its engine is the ADM on
+# targets whose mmc driver leaves the ADM channel free, otherwise every
+# copy stays on the cpu.
+MODULES += lib/dma_memcpy
+
+ifeq ($(ENABLE_ADM_MEMCPY),1)
+DEFINES += DMA_MEMCPY_ADM=1
+OBJS += $(LOCAL_DIR)/adm_memcpy.o
+endif
+
 ifeq ($(ENABLE_SECAPP_LOADER), 1)
 OBJS += $(LOCAL_DIR)/secapp_loader.o
 endif
@@ -51,7 +61,8 @@ endif
 
 ifeq ($(VERIFIED_BOOT),1)
 OBJS += \
-	$(LOCAL_DIR)/boot_verifier.o
+	$(LOCAL_DIR)/boot_verifier.o \
+	$(LOCAL_DIR)/verity.o
 endif
 
 ifeq ($(ENABLE_FBCON_DISPLAY_MSG),1)
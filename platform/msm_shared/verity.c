@@ -0,0 +1,492 @@
+/*
+ * dm-verity hash tree verification
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <scm.h>
+#include <arch/defines.h>
+#include <openssl/sha.h>
+#include <mmc.h>
+#include <partition_parser.h>
+#include <boot_verifier.h>
+#include <verity.h>
+
+/*
+ * The whole tree is read first and checked from the root down, a level
+ * at a time, with SHA256_multi(). The data is then read and hashed a
+ * chunk at a time, each chunk being compared against the leaf level.
+ */
+#define VERITY_CHUNK_SIZE	(1024 * 1024)
+#define VERITY_HASH_BATCH	16
+
+#define EXT4_SB_OFFSET		1024
+#define EXT4_SB_MAGIC		0xef53
+#define EXT4_INCOMPAT_64BIT	0x80
+
+/* metadata header: magic, version, signature, table length, table */
+#define VERITY_TABLE_OFFSET	(8 + VERITY_SIGNATURE_SIZE + 4)
+
+struct verity_slot {
+	struct verity *v;
+	unsigned char *buf;
+	unsigned char *md;
+	uint64_t block;
+	uint32_t count;
+};
+
+static uint32_t verity_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int verity_parse_u64(const char *s, uint64_t *val)
+{
+	uint64_t n = 0;
+
+	if (!*s)
+		return -1;
+	for (; *s; s++) {
+		if (*s < '0' || *s > '9' || n > (~0ULL - 9) / 10)
+			return -1;
+		n = n * 10 + (*s - '0');
+	}
+	*val = n;
+	return 0;
+}
+
+static int verity_hex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* returns the number of bytes, or -1 */
+static int verity_parse_hex(const char *s, unsigned char *out, size_t max)
+{
+	size_t len = strlen(s), i;
+	int hi, lo;
+
+	if (len % 2 || len / 2 > max)
+		return -1;
+	for (i = 0; i < len / 2; i++) {
+		hi = verity_hex(s[2 * i]);
+		lo = verity_hex(s[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return -1;
+		out[i] = (hi << 4) | lo;
+	}
+	return len / 2;
+}
+
+/*
+ * <version> <data dev> <hash dev> <data block size> <hash block size>
+ * <data blocks> <hash start block> <algorithm> <root digest> <salt> [...]
+ */
+static int verity_parse_table(struct verity *v, char *table)
+{
+	char *field[10];
+	unsigned int n = 0;
+	uint64_t data_bs, hash_bs;
+	int len;
+
+	while (n < countof(field)) {
+		while (*table == ' ' || *table == '\n')
+			table++;
+		if (!*table)
+			break;
+		field[n++] = table;
+		while (*table && *table != ' ' && *table != '\n')
+			table++;
+		if (*table)
+			*table++ = 0;
+	}
+
+	if (n < countof(field) || strcmp(field[0], "1") ||
+	    strcmp(field[7], "sha256") ||
+	    verity_parse_u64(field[3], &data_bs) ||
+	    verity_parse_u64(field[4], &hash_bs) ||
+	    verity_parse_u64(field[5], &v->data_blocks) ||
+	    verity_parse_u64(field[6], &v->hash_start))
+		return VERITY_ERR_FORMAT;
+
+	if (data_bs != hash_bs || data_bs < 512 || data_bs > 4096 ||
+	    (data_bs & (data_bs - 1)))
+		return VERITY_ERR_FORMAT;
+	v->block_size = data_bs;
+
+	if (verity_parse_hex(field[8], v->root, sizeof(v->root)) != sizeof(v->root))
+		return VERITY_ERR_FORMAT;
+
+	/* dm-verity takes "-" for no salt */
+	if (!strcmp(field[9], "-"))
+		len = 0;
+	else
+		len = verity_parse_hex(field[9], v->salt, sizeof(v->salt));
+	if (len < 0)
+		return VERITY_ERR_FORMAT;
+	v->salt_len = len;
+
+	return VERITY_OK;
+}
+
+static int verity_geometry(struct verity *v)
+{
+	uint32_t per_block = v->block_size / SHA256_DIGEST_LENGTH;
+	uint64_t n = v->data_blocks, start = 0;
+	uint64_t dev_blocks = v->size / v->block_size;
+	unsigned int i;
+
+	if (n == 0 || n > v->hash_start)
+		return VERITY_ERR_FORMAT;
+
+	v->levels = 0;
+	do {
+		if (v->levels == VERITY_LEVELS_MAX)
+			return VERITY_ERR_FORMAT;
+		n = (n + per_block - 1) / per_block;
+		v->level_blocks[v->levels++] = n;
+	} while (n > 1);
+
+	/* the top level comes first on disk */
+	for (i = v->levels; i-- > 0; ) {
+		v->level_start[i] = start;
+		start += v->level_blocks[i];
+	}
+	v->tree_blocks = start;
+
+	if (v->hash_start > dev_blocks || v->tree_blocks > dev_blocks - v->hash_start)
+		return VERITY_ERR_FORMAT;
+
+	return VERITY_OK;
+}
+
+/* size of the filesystem from its ext4 superblock */
+static int verity_fs_size(struct verity *v, unsigned char *buf, uint64_t *size)
+{
+	const unsigned char *sb = buf + EXT4_SB_OFFSET;
+	uint64_t blocks;
+	uint32_t log_bs;
+
+	if (v->read(v, 0, buf, 4096))
+		return VERITY_ERR_IO;
+
+	if ((sb[0x38] | (sb[0x39] << 8)) != EXT4_SB_MAGIC)
+		return VERITY_ERR_FORMAT;
+
+	blocks = verity_le32(sb + 0x04);
+	if (verity_le32(sb + 0x60) & EXT4_INCOMPAT_64BIT)
+		blocks |= (uint64_t)verity_le32(sb + 0x150) << 32;
+	log_bs = verity_le32(sb + 0x18);
+	if (log_bs > 6)
+		return VERITY_ERR_FORMAT;
+
+	*size = blocks << (10 + log_bs);
+	return VERITY_OK;
+}
+
+int verity_init(struct verity *v, verity_read_fn read, void *arg,
+		uint64_t base, uint64_t size, RSA *key)
+{
+	unsigned char *meta;
+	uint64_t fs_size;
+	uint32_t magic, table_len;
+	int ret;
+
+	memset(v, 0, sizeof(*v));
+	v->read = read;
+	v->arg = arg;
+	v->base = base;
+	v->size = size;
+
+	meta = memalign(CACHE_LINE, VERITY_METADATA_SIZE);
+	if (meta == NULL)
+		return VERITY_ERR_NOMEM;
+
+	ret = verity_fs_size(v, meta, &fs_size);
+	if (ret)
+		goto out;
+
+	if (fs_size > size || VERITY_METADATA_SIZE > size - fs_size) {
+		ret = VERITY_ERR_FORMAT;
+		goto out;
+	}
+
+	if (v->read(v, fs_size, meta, VERITY_METADATA_SIZE)) {
+		ret = VERITY_ERR_IO;
+		goto out;
+	}
+
+	magic = verity_le32(meta);
+	table_len = verity_le32(meta + 8 + VERITY_SIGNATURE_SIZE);
+	if (magic == VERITY_METADATA_MAGIC_DISABLE) {
+		ret = VERITY_ERR_DISABLED;
+		goto out;
+	}
+	if (magic != VERITY_METADATA_MAGIC || verity_le32(meta + 4) != 0 ||
+	    table_len == 0 || table_len > VERITY_TABLE_MAX) {
+		ret = VERITY_ERR_FORMAT;
+		goto out;
+	}
+
+	if (key != NULL) {
+		if (!boot_verify_compare_sha256(meta + VERITY_TABLE_OFFSET,
+				table_len, meta + 8, key)) {
+			ret = VERITY_ERR_SIGNATURE;
+			goto out;
+		}
+		v->signature_checked = true;
+	}
+
+	meta[VERITY_TABLE_OFFSET + table_len] = 0;
+	ret = verity_parse_table(v, (char *)meta + VERITY_TABLE_OFFSET);
+	if (ret == VERITY_OK)
+		ret = verity_geometry(v);
+
+out:
+	free(meta);
+	return ret;
+}
+
+static int verity_mmc_read(struct verity *v, uint64_t offset, void *buf,
+		uint32_t len)
+{
+	return mmc_read(v->base + offset, buf, len) ? VERITY_ERR_IO : VERITY_OK;
+}
+
+int verity_init_partition(struct verity *v, const char *name, RSA *key)
+{
+	int index = partition_get_index(name);
+	uint64_t ptn;
+
+	if (index == INVALID_PTN)
+		return VERITY_ERR_IO;
+
+	ptn = partition_get_offset(index);
+	if (ptn == 0)
+		return VERITY_ERR_IO;
+
+	return verity_init(v, verity_mmc_read, NULL, ptn,
+			partition_get_size(index), key);
+}
+
+/* md gets the salted hash of each of count consecutive blocks */
+static void verity_hash_blocks(const struct verity *v,
+		const unsigned char *blocks, uint64_t count, unsigned char *md)
+{
+	const unsigned char *in[VERITY_HASH_BATCH];
+	uint32_t i, n;
+
+	while (count) {
+		n = MIN(count, VERITY_HASH_BATCH);
+		for (i = 0; i < n; i++)
+			in[i] = blocks + i * v->block_size;
+		SHA256_multi(v->salt, v->salt_len, in, v->block_size, md, n);
+		blocks += n * v->block_size;
+		md += n * SHA256_DIGEST_LENGTH;
+		count -= n;
+	}
+}
+
+/* compare every block of a level against the hashes in the level above */
+static int verity_check_level(const struct verity *v, const unsigned char *tree,
+		unsigned int level)
+{
+	unsigned char md[VERITY_HASH_BATCH * SHA256_DIGEST_LENGTH];
+	const unsigned char *blocks = tree + v->level_start[level] * v->block_size;
+	const unsigned char *parent = tree + v->level_start[level + 1] * v->block_size;
+	uint64_t i, n;
+
+	for (i = 0; i < v->level_blocks[level]; i += n) {
+		n = MIN(v->level_blocks[level] - i, VERITY_HASH_BATCH);
+		verity_hash_blocks(v, blocks + i * v->block_size, n, md);
+		if (memcmp(md, parent + i * SHA256_DIGEST_LENGTH,
+				n * SHA256_DIGEST_LENGTH)) {
+			dprintf(CRITICAL, "verity: hash tree level %u is corrupt near block %llu\n",
+				level, i);
+			return VERITY_ERR_HASH;
+		}
+	}
+
+	return VERITY_OK;
+}
+
+/* hash the chunk read into the slot and compare it */
+static int verity_check_slot(struct verity_slot *slot, const unsigned char *leaves)
+{
+	const unsigned char *expect;
+	uint32_t i;
+
+	verity_hash_blocks(slot->v, slot->buf, slot->count, slot->md);
+
+	expect = leaves + slot->block * SHA256_DIGEST_LENGTH;
+	if (!memcmp(slot->md, expect, slot->count * SHA256_DIGEST_LENGTH))
+		return VERITY_OK;
+
+	for (i = 0; i < slot->count; i++)
+		if (memcmp(slot->md + i * SHA256_DIGEST_LENGTH,
+				expect + i * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH))
+			break;
+	dprintf(CRITICAL, "verity: data block %llu does not match the hash tree\n",
+		slot->block + i);
+	return VERITY_ERR_HASH;
+}
+
+static uint32_t verity_chunk_blocks(const struct verity *v)
+{
+	return VERITY_CHUNK_SIZE / v->block_size;
+}
+
+uint64_t verity_buf_size(const struct verity *v)
+{
+	uint64_t chunk = verity_chunk_blocks(v);
+
+	return v->tree_blocks * v->block_size +
+		chunk * v->block_size + chunk * SHA256_DIGEST_LENGTH;
+}
+
+/*
+ * The chunks a sampled check looks at must not be predictable, or data
+ * could be changed only where it is never read. rand() starts from the
+ * same seed on every boot, so each verify takes a fresh seed from the TZ
+ * PRNG instead. Without one every chunk is checked.
+ */
+static bool verity_sample_seed(uint32_t *seed)
+{
+	STACKBUF_DMA_ALIGN(rbuf, sizeof(uint32_t));
+
+	if (scm_random((uint32_t *)rbuf, sizeof(uint32_t))) {
+		dprintf(CRITICAL, "verity: no random seed, checking every block\n");
+		return false;
+	}
+	*seed = *(uint32_t *)rbuf;
+	/* xorshift never leaves zero */
+	if (*seed == 0)
+		*seed = 1;
+	return true;
+}
+
+/* true for about one call in sample */
+static bool verity_sample_pick(uint32_t *x, uint32_t sample)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+	return *x % sample == 0;
+}
+
+int verity_verify(struct verity *v, uint32_t sample, void *buf, size_t buf_size)
+{
+	struct verity_slot slot;
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned char *tree = buf, *p;
+	const unsigned char *leaves;
+	uint32_t bs = v->block_size;
+	uint32_t chunk = verity_chunk_blocks(v);
+	unsigned int i;
+	uint64_t block, checked = 0;
+	uint32_t seed = 0;
+	int ret;
+
+	if (buf_size < verity_buf_size(v))
+		return VERITY_ERR_NOMEM;
+
+	/* the tree as it is on disk, top level first */
+	if (v->read(v, v->hash_start * bs, tree, v->tree_blocks * bs))
+		return VERITY_ERR_IO;
+
+	verity_hash_blocks(v, tree + v->level_start[v->levels - 1] * bs, 1, md);
+	if (memcmp(md, v->root, SHA256_DIGEST_LENGTH)) {
+		dprintf(CRITICAL, "verity: root digest does not match the table\n");
+		return VERITY_ERR_HASH;
+	}
+
+	for (i = v->levels - 1; i-- > 0; ) {
+		ret = verity_check_level(v, tree, i);
+		if (ret)
+			return ret;
+	}
+
+	leaves = tree + v->level_start[0] * bs;
+	p = tree + v->tree_blocks * bs;
+	slot.v = v;
+	slot.buf = p;
+	slot.md = p + chunk * bs;
+
+	if (sample == 0 || (sample > 1 && !verity_sample_seed(&seed)))
+		sample = 1;
+
+	ret = VERITY_OK;
+	for (block = 0; block < v->data_blocks; block += chunk) {
+		if (sample > 1 && !verity_sample_pick(&seed, sample))
+			continue;
+
+		slot.block = block;
+		slot.count = MIN(v->data_blocks - block, chunk);
+		if (v->read(v, block * bs, slot.buf, slot.count * bs)) {
+			ret = VERITY_ERR_IO;
+			break;
+		}
+		checked += slot.count;
+
+		ret = verity_check_slot(&slot, leaves);
+		if (ret)
+			break;
+	}
+
+	dprintf(INFO, "verity: checked %llu of %llu data blocks\n",
+		checked, v->data_blocks);
+
+	if (ret == VERITY_OK && !v->signature_checked)
+		ret = VERITY_ERR_UNSIGNED;
+
+	return ret;
+}
+
+const char *verity_strerror(int err)
+{
+	switch (err) {
+	case VERITY_OK:
+		return "verified";
+	case VERITY_ERR_IO:
+		return "read error";
+	case VERITY_ERR_FORMAT:
+		return "no valid verity metadata";
+	case VERITY_ERR_SIGNATURE:
+		return "table signature mismatch";
+	case VERITY_ERR_HASH:
+		return "hash mismatch";
+	case VERITY_ERR_NOMEM:
+		return "out of memory";
+	case VERITY_ERR_DISABLED:
+		return "verity disabled";
+	case VERITY_ERR_UNSIGNED:
+		return "not verified, no key for the table signature";
+	default:
+		return "unknown error";
+	}
+}
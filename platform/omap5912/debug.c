@@ -152,6 +152,6 @@ void debug_set_trace_level(int trace_type, int level)
 
 void platform_init_debug(void)
 {
-	cbuf_initialize(&debug_buf, 512);
+	cbuf_initialize_etc(&debug_buf, 512, CBUF_FLAG_SPSC);
 	timer_set_periodic(&debug_timer, 10, &debug_timer_callback, NULL);
 }
@@ -313,7 +313,7 @@ void platform_init_keyboard(void)
 {
 	uint8_t ctr;
 	
-	cbuf_initialize(&key_buf, 32);
+	cbuf_initialize_etc(&key_buf, 32, CBUF_FLAG_SPSC);
 
 	i8042_flush();
 	
@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+#
+# Convert the output of the lk "trace dump" console command into the
+# Chrome trace event format (load it in chrome://tracing or Perfetto).
+#
+# usage: ktrace2json.py [console.log] > trace.json
+#
+# Anything in the log outside the "ktrace:" header and trailer is ignored,
+# so a raw serial capture can be fed in directly.
+#
+
+import json
+import sys
+
+CTXSW, WAIT_BLOCK, WAIT_WAKE, TIMER_FIRE, TIMER_DONE, \
+	IRQ_ENTER, IRQ_EXIT, DPC_RUN, DPC_DONE = range(1, 10)
+
+PID = 1
+IRQ_TID = 0
+
+
+def parse(lines):
+	threads = {}
+	records = []
+	inside = False
+
+	for line in lines:
+		line = line.strip()
+		if line.startswith("ktrace:"):
+			inside = not line.endswith("end")
+			continue
+		if not inside or not line:
+			continue
+
+		fields = line.split()
+		if fields[0] == "T" and len(fields) >= 2:
+			threads[int(fields[1], 16)] = " ".join(fields[2:]) or fields[1]
+		elif fields[0] == "E" and len(fields) == 5:
+			records.append((int(fields[1]), int(fields[2]),
+					int(fields[3], 16), int(fields[4], 16)))
+
+	return threads, records
+
+
+def convert(threads, records):
+	events = []
+	current = None
+	base = None
+	last = 0
+	wraps = 0
+
+	def thread_name(t):
+		return threads.get(t, "thread 0x%x" % t)
+
+	for raw_ts, event, a, b in records:
+		# timestamps are the low 32 bits of a microsecond clock
+		if raw_ts < last:
+			wraps += 1
+		last = raw_ts
+		ts = raw_ts + (wraps << 32)
+		if base is None:
+			base = ts
+		ts -= base
+
+		if event == CTXSW:
+			events.append({"ph": "E", "pid": PID, "tid": a, "ts": ts})
+			events.append({"ph": "B", "pid": PID, "tid": b, "ts": ts,
+				       "name": thread_name(b)})
+			current = b
+		elif event == WAIT_BLOCK:
+			events.append({"ph": "i", "s": "t", "pid": PID,
+				       "tid": current or 0, "ts": ts,
+				       "name": "block", "args": {"wait": hex(a),
+								 "timeout": b}})
+		elif event == WAIT_WAKE:
+			events.append({"ph": "i", "s": "t", "pid": PID,
+				       "tid": current or 0, "ts": ts,
+				       "name": "wake " + thread_name(b),
+				       "args": {"wait": hex(a)}})
+		elif event == IRQ_ENTER:
+			events.append({"ph": "B", "pid": PID, "tid": IRQ_TID, "ts": ts,
+				       "name": "irq %d" % a})
+		elif event == IRQ_EXIT:
+			events.append({"ph": "E", "pid": PID, "tid": IRQ_TID, "ts": ts,
+				       "args": {"reschedule": b}})
+		elif event == TIMER_FIRE:
+			events.append({"ph": "B", "pid": PID, "tid": IRQ_TID, "ts": ts,
+				       "name": "timer 0x%x" % a,
+				       "args": {"callback": hex(b)}})
+		elif event == TIMER_DONE:
+			events.append({"ph": "E", "pid": PID, "tid": IRQ_TID, "ts": ts})
+		elif event == DPC_RUN:
+			events.append({"ph": "B", "pid": PID, "tid": current or 0,
+				       "ts": ts, "name": "dpc 0x%x" % a,
+				       "args": {"arg": hex(b)}})
+		elif event == DPC_DONE:
+			events.append({"ph": "E", "pid": PID, "tid": current or 0,
+				       "ts": ts})
+
+	meta = [{"ph": "M", "pid": PID, "tid": IRQ_TID, "name": "thread_name",
+		 "args": {"name": "interrupts"}}]
+	for t, name in threads.items():
+		meta.append({"ph": "M", "pid": PID, "tid": t, "name": "thread_name",
+			     "args": {"name": name}})
+
+	return meta + events
+
+
+def main():
+	if len(sys.argv) > 1:
+		with open(sys.argv[1]) as f:
+			lines = f.readlines()
+	else:
+		lines = sys.stdin.readlines()
+
+	threads, records = parse(lines)
+	json.dump({"traceEvents": convert(threads, records),
+		   "displayTimeUnit": "ms"}, sys.stdout, indent=1)
+	sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+	main()